@@ -23,6 +23,8 @@
 #ifndef IMEDIALIBRARY_H
 #define IMEDIALIBRARY_H
 
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -52,6 +54,131 @@ struct SearchAggregate
     std::vector<PlaylistPtr> playlists;
 };
 
+/**
+ * @brief IMediaSearchSession allows searching for media as the user types
+ *
+ * When a pattern refines the previous one, ie. when each previous word is a
+ * prefix of the word at the same position, and words were only appended, the
+ * previous results are filtered instead of looking up the whole index again.
+ * A session is not thread safe, and keeps the previous results alive.
+ */
+class IMediaSearchSession
+{
+public:
+    virtual ~IMediaSearchSession() = default;
+    virtual MediaSearchAggregate searchMedia( const std::string& pattern ) = 0;
+};
+
+/**
+ * @brief Page represents a slice of a sorted listing.
+ *
+ * To fetch the following page, \a next must be provided as the "after" parameter
+ * of the same listing function, with the same sorting parameters.
+ * \a next is an opaque key, and will be empty when the end of the listing has
+ * been reached.
+ */
+template <typename T>
+struct Page
+{
+    std::vector<std::shared_ptr<T>> items;
+    std::string next;
+};
+
+/**
+ * @brief QueryStats holds the execution statistics of a single SQL request.
+ *
+ * Durations are expressed in microseconds. The execution time only accounts for
+ * the time spent by sqlite to run the request and produce its rows, while the
+ * lock wait time is the time spent waiting for other threads to release the
+ * database before the request could run.
+ */
+struct QueryStats
+{
+    static constexpr size_t NbLatencyBuckets = 24;
+
+    std::string request;
+    uint64_t nbExecutions;
+    uint64_t nbRows;
+    uint64_t totalDuration;
+    uint64_t maxDuration;
+    uint64_t lockWaitDuration;
+    /*
+     * Log-scaled latency histogram: latencies[i] is the number of executions
+     * which lasted between 2^i and 2^(i+1) µs. The first bucket also accounts
+     * for faster executions, and the last one for slower executions.
+     */
+    std::array<uint64_t, NbLatencyBuckets> latencies;
+};
+
+/**
+ * @brief ParserServiceStats holds the statistics of a single parser service.
+ *
+ * Durations are expressed in microseconds. The counters account for the tasks
+ * processed since the media library was initialized, or since the last call to
+ * resetParserStats(), while the number of queued & running tasks reflects the
+ * current state of the service.
+ */
+struct ParserServiceStats
+{
+    static constexpr size_t NbLatencyBuckets = 24;
+
+    std::string name;
+    uint32_t nbQueuedTasks;
+    /*
+     * The number of jobs being run, each of them running a task, or a batch
+     * of tasks for the services which batch their database changes.
+     */
+    uint32_t nbRunningJobs;
+    /* The maximum number of jobs this service runs concurrently */
+    uint32_t maxRunningJobs;
+    uint64_t nbCompleted;
+    /* Tasks which didn't need to be run, since their step was already done */
+    uint64_t nbSkipped;
+    uint64_t nbFailed;
+    /* Tasks whose media was temporarily unavailable, ie. on a network share */
+    uint64_t nbUnavailable;
+    /* Tasks which were run again after their batch failed to be committed */
+    uint64_t nbRetried;
+    uint64_t totalDuration;
+    uint64_t maxDuration;
+    /*
+     * Log-scaled run time histogram: latencies[i] is the number of runs which
+     * lasted between 2^i and 2^(i+1) µs, as in QueryStats.
+     */
+    std::array<uint64_t, NbLatencyBuckets> latencies;
+};
+
+/**
+ * @brief ParserThreadStats holds the time a parser thread spent running tasks,
+ * and waiting for tasks to run, in microseconds.
+ */
+struct ParserThreadStats
+{
+    uint64_t busyDuration;
+    uint64_t idleDuration;
+};
+
+/**
+ * @brief ParserStats holds the statistics of the parser pipeline.
+ */
+struct ParserStats
+{
+    /* The services statistics, in the order in which they process a task */
+    std::vector<ParserServiceStats> services;
+    /* The statistics of the threads shared by all the services */
+    std::vector<ParserThreadStats> threads;
+    /* The number of files being parsed, or waiting to be parsed */
+    uint32_t nbPendingTasks;
+    /* The duration covered by the statistics, in microseconds */
+    uint64_t elapsed;
+    /*
+     * Estimated remaining duration, in microseconds, based on the throughput
+     * observed during the covered duration. 0 if there's nothing left to do,
+     * or if no task was completed yet.
+     */
+    uint64_t eta;
+};
+
 enum class SortingCriteria
 {
     /*
@@ -240,11 +367,33 @@ class IMediaLibrary
         virtual bool deleteLabel( LabelPtr label ) = 0;
         virtual MediaPtr media( int64_t mediaId ) const = 0;
         virtual MediaPtr media( const std::string& mrl ) const = 0;
+        /**
+         * @brief media Returns the media with the provided IDs, in the same
+         * order. Unknown IDs are ignored.
+         *
+         * This is much cheaper than fetching each media individually.
+         */
+        virtual std::vector<MediaPtr> media( const std::vector<int64_t>& mediaIds ) const = 0;
         virtual MediaPtr addMedia( const std::string& mrl ) = 0;
         virtual std::vector<MediaPtr> audioFiles( SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
         virtual std::vector<MediaPtr> videoFiles( SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
+        /**
+         * @brief audioFiles/videoFiles Paginated versions of the listing functions
+         * @param nbItems The maximum number of items to return
+         * @param after An empty string to fetch the first page, or the Page::next
+         *              value returned by the previous call.
+         *
+         * Only the returned entities are loaded, meaning that each call runs in
+         * a time proportional to the page size, not to the library size.
+         */
+        virtual Page<IMedia> audioFiles( uint32_t nbItems, const std::string& after,
+                                         SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
+        virtual Page<IMedia> videoFiles( uint32_t nbItems, const std::string& after,
+                                         SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
         virtual AlbumPtr album( int64_t id ) const = 0;
         virtual std::vector<AlbumPtr> albums( SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
+        virtual Page<IAlbum> albums( uint32_t nbItems, const std::string& after,
+                                     SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
         virtual ShowPtr show( const std::string& name ) const = 0;
         virtual MoviePtr movie( const std::string& title ) const = 0;
         virtual ArtistPtr artist( int64_t id ) const = 0;
@@ -256,18 +405,24 @@ class IMediaLibrary
          * @param desc If true, the provided sorting criteria will be reversed.
          */
         virtual std::vector<ArtistPtr> artists( SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
+        virtual Page<IArtist> artists( uint32_t nbItems, const std::string& after,
+                                       SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
         /**
          * @brief genres Return the list of music genres
          * @param sort A sorting criteria. So far, this is ignored, and artists are sorted by lexial order
          * @param desc If true, the provided sorting criteria will be reversed.
          */
         virtual std::vector<GenrePtr> genres( SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
+        virtual Page<IGenre> genres( uint32_t nbItems, const std::string& after,
+                                     SortingCriteria sort = SortingCriteria::Default, bool desc = false ) const = 0;
         virtual GenrePtr genre( int64_t id ) const = 0;
         /***
          *  Playlists
          */
         virtual PlaylistPtr createPlaylist( const std::string& name ) = 0;
         virtual std::vector<PlaylistPtr> playlists( SortingCriteria sort = SortingCriteria::Default, bool desc = false ) = 0;
+        virtual Page<IPlaylist> playlists( uint32_t nbItems, const std::string& after,
+                                           SortingCriteria sort = SortingCriteria::Default, bool desc = false ) = 0;
         virtual PlaylistPtr playlist( int64_t id ) const = 0;
         virtual bool deletePlaylist( int64_t playlistId ) = 0;
 
@@ -296,6 +451,34 @@ class IMediaLibrary
         virtual std::vector<GenrePtr> searchGenre( const std::string& genre ) const = 0;
         virtual std::vector<ArtistPtr> searchArtists( const std::string& name ) const = 0;
         virtual SearchAggregate search( const std::string& pattern ) const = 0;
+        /**
+         * @brief search Searches all categories at once
+         * @param pattern The pattern to search for
+         * @param nbResults The maximum number of results in each category
+         *                  (albums, artists, ..., media tracks, media movies, ...)
+         *                  or 0 for no limit.
+         *
+         * Each category is sorted by relevance, best match first.
+         */
+        virtual SearchAggregate search( const std::string& pattern, uint32_t nbResults ) const = 0;
+        /**
+         * @brief fuzzySearch Searches the media titles, the album titles & the
+         *                    artist names, tolerating typos.
+         * @param pattern The pattern to search for. Unlike the other search
+         *                functions, any non empty pattern is accepted.
+         * @param nbResults The maximum number of results in each category,
+         *                  or 0 for no limit.
+         *
+         * Each category is sorted by similarity, best match first.
+         * Genres & playlists are not searched.
+         */
+        virtual SearchAggregate fuzzySearch( const std::string& pattern, uint32_t nbResults ) const = 0;
+        /**
+         * @brief createMediaSearchSession Returns a new search session
+         *
+         * The session must not outlive the media library.
+         */
+        virtual std::unique_ptr<IMediaSearchSession> createMediaSearchSession() const = 0;
 
         /**
          * @brief discover Launch a discovery on the provided entry point.
@@ -368,6 +551,99 @@ class IMediaLibrary
          * as invalid the moment this method returns.
          */
         virtual void forceRescan() = 0;
+
+        /**
+         * @brief queryStats Returns the execution statistics of all the SQL
+         * requests run since the media library was initialized, or since the
+         * last call to resetQueryStats()
+         *
+         * The statistics are always collected, and are meant to help with
+         * diagnosing performance issues on real world databases.
+         */
+        virtual std::vector<QueryStats> queryStats() const = 0;
+        /**
+         * @brief resetQueryStats Resets all the SQL requests statistics
+         */
+        virtual void resetQueryStats() = 0;
+        /**
+         * @brief parserStats Returns the statistics of the parser pipeline
+         *
+         * They are meant to help with sizing the parser concurrency, and with
+         * finding which service is the bottleneck on a given device.
+         */
+        virtual ParserStats parserStats() const = 0;
+        /**
+         * @brief resetParserStats Resets the parser counters & durations
+         */
+        virtual void resetParserStats() = 0;
+
+        /**
+         * @brief setMaxCachedEntities Sets the number of media, files, albums,
+         * artists, tracks, movies & episodes the media library keeps in memory,
+         * for each of those entity types.
+         *
+         * The least recently used entities are released once this number is
+         * reached. Entities held by the application aren't affected, and will
+         * keep being returned by the media library until they are released.
+         * Defaults to 10000. Since the entities are cached in multiple
+         * partitions, each of them getting an equal share, this is an
+         * approximation.
+         */
+        virtual void setMaxCachedEntities( uint32_t nbEntities ) = 0;
+
+        /**
+         * @brief setMetadataExtractionConcurrency Sets the number of media
+         * whose metadata are extracted at once.
+         *
+         * Slow or network media won't stall the extraction of the others,
+         * as long as fewer media than this number are stalled.
+         * This must be called before initialize(). 0, the default, uses the
+         * number of cores, with a minimum of 2. The value is capped to 8.
+         */
+        virtual void setMetadataExtractionConcurrency( uint8_t nbMedia ) = 0;
+
+        /**
+         * @brief setThumbnailerConcurrency Sets the number of thumbnails
+         * generated at once.
+         *
+         * Each of them uses its own media player, which is reused for the
+         * following thumbnails.
+         * This must be called before initialize(). 0, the default, uses half
+         * the number of cores, with a minimum of 1 and a maximum of 4.
+         */
+        virtual void setThumbnailerConcurrency( uint8_t nbThumbnails ) = 0;
+
+        /**
+         * @brief prioritize Parses the provided media before the other pending
+         * media.
+         *
+         * This is meant for media the user is currently looking at. Media
+         * fetched through media( int64_t ) or media( const std::string& ) are
+         * prioritized automatically.
+         * The priorities are reset once the parser becomes idle.
+         */
+        virtual void prioritize( int64_t mediaId ) = 0;
+        /**
+         * @brief prioritize Parses the media with the provided mrl, or located
+         * in the folder with the provided mrl, before the other pending media.
+         *
+         * This includes the media of this folder which haven't been discovered
+         * yet.
+         */
+        virtual void prioritize( const std::string& mrl ) = 0;
+
+        /**
+         * @brief setMaxParserBacklog Sets the number of files waiting to be
+         * parsed above which the discoverer stops looking for new files.
+         *
+         * Once this number is reached, the discoverer waits for the parser to
+         * process half of its backlog before queuing more files. This bounds
+         * the memory used by the pending tasks during a large first scan.
+         * Since the files of a folder are queued at once, the backlog can
+         * exceed this number by the size of a folder.
+         * 0, the default, doesn't limit the backlog.
+         */
+        virtual void setMaxParserBacklog( uint32_t nbFiles ) = 0;
 };
 
 }
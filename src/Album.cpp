@@ -358,9 +358,11 @@ void Album::createTable( sqlite::Connection* dbConnection )
                     + policy::ArtistTable::PrimaryKeyColumn + ") ON DELETE CASCADE"
             ")";
     const std::string vtableReq = "CREATE VIRTUAL TABLE IF NOT EXISTS "
-                + policy::AlbumTable::Name + "Fts USING FTS3("
+                + policy::AlbumTable::Name + "Fts USING FTS5("
                 "title,"
-                "artist"
+                "artist,"
+                "prefix = '2 3',"
+                "tokenize = 'unicode61 remove_diacritics 1'"
             ")";
     const std::string indexReq = "CREATE INDEX IF NOT EXISTS album_artist_id_idx ON " +
             policy::AlbumTable::Name + "(artist_id)";
@@ -446,9 +448,9 @@ std::vector<AlbumPtr> Album::search( MediaLibraryPtr ml, const std::string& patt
 {
     static const std::string req = "SELECT * FROM " + policy::AlbumTable::Name + " WHERE id_album IN "
             "(SELECT rowid FROM " + policy::AlbumTable::Name + "Fts WHERE " +
-            policy::AlbumTable::Name + "Fts MATCH '*' || ? || '*')"
+            policy::AlbumTable::Name + "Fts MATCH ?)"
             "AND is_present != 0";
-    return fetchAll<IAlbum>( ml, req, pattern );
+    return fetchAll<IAlbum>( ml, req, sqlite::Tools::sanitizePattern( pattern ) );
 }
 
 std::vector<AlbumPtr> Album::fromArtist( MediaLibraryPtr ml, int64_t artistId, SortingCriteria sort, bool desc )
@@ -485,6 +487,53 @@ std::vector<AlbumPtr> Album::fromGenre( MediaLibraryPtr ml, int64_t genreId, Sor
     return fetchAll<IAlbum>( ml, req, genreId );
 }
 
+Page<IAlbum> Album::listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                              uint32_t nbItems, const std::string& after )
+{
+    static const std::string title = "IFNULL(alb.title, '') COLLATE NOCASE";
+    std::vector<sqlite::Keyset::Term> terms;
+    if ( sort == SortingCriteria::Artist )
+    {
+        terms.emplace_back( "IFNULL(art.name, '') COLLATE NOCASE", false, desc );
+        terms.emplace_back( title, false, false );
+        sqlite::Keyset keyset( sort, desc, std::move( terms ), "alb.id_album", sqlite::Keyset::Filter::And );
+        auto req = "SELECT alb.*" + keyset.columns() + " FROM " + policy::AlbumTable::Name + " alb "
+                "INNER JOIN " + policy::ArtistTable::Name + " art ON alb.artist_id = art.id_artist "
+                "WHERE alb.is_present != 0";
+        return fetchPage<IAlbum>( ml, keyset, nbItems, after, req );
+    }
+    if ( sort == SortingCriteria::PlayCount )
+    {
+        // Most played first by default
+        terms.emplace_back( "IFNULL(SUM(m.play_count), 0)", true, !desc );
+        terms.emplace_back( title, false, false );
+        sqlite::Keyset keyset( sort, desc, std::move( terms ), "alb.id_album", sqlite::Keyset::Filter::Having );
+        auto req = "SELECT alb.*" + keyset.columns() + " FROM " + policy::AlbumTable::Name + " alb "
+                 "INNER JOIN " + policy::AlbumTrackTable::Name + " t ON alb.id_album = t.album_id "
+                 "INNER JOIN " + policy::MediaTable::Name + " m ON t.media_id = m.id_media "
+                 "WHERE alb.is_present != 0 "
+                 "GROUP BY id_album";
+        return fetchPage<IAlbum>( ml, keyset, nbItems, after, req );
+    }
+    switch ( sort )
+    {
+    case SortingCriteria::ReleaseDate:
+        terms.emplace_back( "IFNULL(alb.release_year, 0)", true, desc );
+        terms.emplace_back( title, false, false );
+        break;
+    case SortingCriteria::Duration:
+        terms.emplace_back( "alb.duration", true, desc );
+        break;
+    default:
+        terms.emplace_back( title, false, desc );
+        break;
+    }
+    sqlite::Keyset keyset( sort, desc, std::move( terms ), "alb.id_album", sqlite::Keyset::Filter::And );
+    auto req = "SELECT alb.*" + keyset.columns() + " FROM " + policy::AlbumTable::Name + " alb"
+            " WHERE alb.is_present != 0";
+    return fetchPage<IAlbum>( ml, keyset, nbItems, after, req );
+}
+
 std::vector<AlbumPtr> Album::listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc )
 {
     if ( sort == SortingCriteria::Artist )
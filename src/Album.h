@@ -50,7 +50,7 @@ struct AlbumTable
 };
 }
 
-class Album : public IAlbum, public DatabaseHelpers<Album, policy::AlbumTable>
+class Album : public IAlbum, public DatabaseHelpers<Album, policy::AlbumTable, cachepolicy::Bounded<Album>>
 {
     public:
         Album( MediaLibraryPtr ml, sqlite::Row& row );
@@ -111,6 +111,8 @@ class Album : public IAlbum, public DatabaseHelpers<Album, policy::AlbumTable>
         static std::vector<AlbumPtr> fromArtist( MediaLibraryPtr ml, int64_t artistId, SortingCriteria sort, bool desc );
         static std::vector<AlbumPtr> fromGenre( MediaLibraryPtr ml, int64_t genreId, SortingCriteria sort, bool desc );
         static std::vector<AlbumPtr> listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc );
+        static Page<IAlbum> listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                                      uint32_t nbItems, const std::string& after );
 
     private:
         static std::string orderTracksBy( SortingCriteria sort, bool desc );
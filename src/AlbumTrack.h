@@ -51,7 +51,7 @@ struct AlbumTrackTable
 };
 }
 
-class AlbumTrack : public IAlbumTrack, public DatabaseHelpers<AlbumTrack, policy::AlbumTrackTable>
+class AlbumTrack : public IAlbumTrack, public DatabaseHelpers<AlbumTrack, policy::AlbumTrackTable, cachepolicy::Bounded<AlbumTrack>>
 {
     public:
         AlbumTrack( MediaLibraryPtr ml, sqlite::Row& row );
@@ -212,8 +212,10 @@ void Artist::createTable( sqlite::Connection* dbConnection )
                     + policy::ArtistTable::PrimaryKeyColumn + ") ON DELETE CASCADE"
             ")";
     const std::string reqFts = "CREATE VIRTUAL TABLE IF NOT EXISTS " +
-                policy::ArtistTable::Name + "Fts USING FTS3("
-                "name"
+                policy::ArtistTable::Name + "Fts USING FTS5("
+                "name,"
+                "prefix = '2 3',"
+                "tokenize = 'unicode61 remove_diacritics 1'"
             ")";
     sqlite::Tools::executeRequest( dbConnection, req );
     sqlite::Tools::executeRequest( dbConnection, reqRel );
@@ -290,9 +292,10 @@ std::shared_ptr<Artist> Artist::create( MediaLibraryPtr ml, const std::string& n
 std::vector<ArtistPtr> Artist::search( MediaLibraryPtr ml, const std::string& name )
 {
     static const std::string req = "SELECT * FROM " + policy::ArtistTable::Name + " WHERE id_artist IN "
-            "(SELECT rowid FROM " + policy::ArtistTable::Name + "Fts WHERE name MATCH '*' || ? || '*')"
+            "(SELECT rowid FROM " + policy::ArtistTable::Name + "Fts WHERE " +
+            policy::ArtistTable::Name + "Fts MATCH ?)"
             "AND is_present != 0";
-    return fetchAll<IArtist>( ml, req, name );
+    return fetchAll<IArtist>( ml, req, sqlite::Tools::sanitizePattern( name ) );
 }
 
 std::vector<ArtistPtr> Artist::listAll(MediaLibraryPtr ml, SortingCriteria sort, bool desc)
@@ -309,4 +312,15 @@ std::vector<ArtistPtr> Artist::listAll(MediaLibraryPtr ml, SortingCriteria sort,
     return fetchAll<IArtist>( ml, req );
 }
 
+Page<IArtist> Artist::listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                                uint32_t nbItems, const std::string& after )
+{
+    std::vector<sqlite::Keyset::Term> terms;
+    terms.emplace_back( "IFNULL(name, '') COLLATE NOCASE", false, desc );
+    sqlite::Keyset keyset( sort, desc, std::move( terms ), "id_artist", sqlite::Keyset::Filter::And );
+    auto req = "SELECT *" + keyset.columns() + " FROM " + policy::ArtistTable::Name +
+            " WHERE nb_albums > 0 AND is_present != 0";
+    return fetchPage<IArtist>( ml, keyset, nbItems, after, req );
+}
+
 }
@@ -43,7 +43,7 @@ struct ArtistTable
 };
 }
 
-class Artist : public IArtist, public DatabaseHelpers<Artist, policy::ArtistTable>
+class Artist : public IArtist, public DatabaseHelpers<Artist, policy::ArtistTable, cachepolicy::Bounded<Artist>>
 {
 public:
     Artist( MediaLibraryPtr ml, sqlite::Row& row );
@@ -69,6 +69,8 @@ public:
     static std::shared_ptr<Artist> create( MediaLibraryPtr ml, const std::string& name );
     static std::vector<ArtistPtr> search( MediaLibraryPtr ml, const std::string& name );
     static std::vector<ArtistPtr> listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc );
+    static Page<IArtist> listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                                   uint32_t nbItems, const std::string& after );
 
 private:
     MediaLibraryPtr m_ml;
@@ -42,7 +42,7 @@ struct AudioTrackTable
 };
 }
 
-class AudioTrack : public IAudioTrack, public DatabaseHelpers<AudioTrack, policy::AudioTrackTable>
+class AudioTrack : public IAudioTrack, public DatabaseHelpers<AudioTrack, policy::AudioTrackTable, cachepolicy::Bounded<AudioTrack>>
 {
     public:
         AudioTrack(MediaLibraryPtr ml, sqlite::Row& row );
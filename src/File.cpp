@@ -265,6 +265,34 @@ std::shared_ptr<File> File::createFromMedia( MediaLibraryPtr ml, int64_t mediaId
     return self;
 }
 
+std::vector<std::shared_ptr<File>> File::createBatch( MediaLibraryPtr ml,
+                                        const std::vector<int64_t>& mediaIds, Type type,
+                                        const std::vector<std::shared_ptr<fs::IFile>>& filesFs,
+                                        int64_t folderId, bool isRemovable )
+{
+    assert( mediaIds.size() == filesFs.size() );
+    std::vector<std::shared_ptr<File>> files;
+    files.reserve( filesFs.size() );
+    for ( auto i = 0u; i < filesFs.size(); ++i )
+    {
+        assert( mediaIds[i] > 0 );
+        files.push_back( std::make_shared<File>( ml, mediaIds[i], 0, type, *filesFs[i],
+                                                 folderId, isRemovable ) );
+    }
+    static const std::string req = "INSERT INTO " + policy::FileTable::Name +
+            "(media_id, mrl, type, folder_id, last_modification_date, size, is_removable, is_external) VALUES";
+
+    if ( insertBatch( ml, files, req, "(?, ?, ?, ?, ?, ?, ?, 0)", 7,
+                      [type, folderId, isRemovable]( sqlite::Statement& s, const File& f ) {
+            s.bind( f.m_mediaId, f.m_mrl, type, sqlite::ForeignKey( folderId ),
+                    f.m_lastModificationDate, f.m_size, isRemovable );
+        }) == false )
+        return {};
+    for ( auto i = 0u; i < files.size(); ++i )
+        files[i]->m_fullPath = filesFs[i]->mrl();
+    return files;
+}
+
 std::shared_ptr<File> File::createFromPlaylist( MediaLibraryPtr ml, int64_t playlistId, const fs::IFile& fileFs,
                                                 int64_t folderId, bool isRemovable )
 {
@@ -316,11 +344,48 @@ std::shared_ptr<File> File::fromExternalMrl( MediaLibraryPtr ml, const std::stri
     return file;
 }
 
-std::vector<std::shared_ptr<File>> File::fetchUnparsed( MediaLibraryPtr ml )
+std::vector<std::shared_ptr<File>> File::fetchUnparsed( MediaLibraryPtr ml, int64_t afterId,
+                                                        int64_t lastId, uint32_t nbFiles )
 {
     static const std::string req = "SELECT * FROM " + policy::FileTable::Name
+            + " WHERE parser_step != ? AND is_present != 0 AND folder_id IS NOT NULL AND parser_retries < 3"
+            " AND id_file > ? AND id_file <= ? ORDER BY id_file LIMIT ?";
+    return File::fetchAll<File>( ml, req, parser::Task::ParserStep::Completed, afterId,
+                                 lastId, nbFiles );
+}
+
+int64_t File::lastUnparsedId( MediaLibraryPtr ml )
+{
+    static const std::string req = "SELECT MAX(id_file) FROM " + policy::FileTable::Name
             + " WHERE parser_step != ? AND is_present != 0 AND folder_id IS NOT NULL AND parser_retries < 3";
-    return File::fetchAll<File>( ml, req, parser::Task::ParserStep::Completed );
+    auto dbConn = ml->getConn();
+    sqlite::Connection::ReadContext ctx;
+    if ( sqlite::Transaction::transactionInProgress() == false )
+        ctx = dbConn->acquireReadContext();
+    sqlite::Statement stmt( dbConn, req );
+    stmt.execute( parser::Task::ParserStep::Completed );
+    auto row = stmt.row();
+    // MAX() yields NULL, hence 0, when there's no unparsed file
+    if ( row == nullptr )
+        return 0;
+    return row.load<int64_t>( 0 );
+}
+
+uint32_t File::countUnparsed( MediaLibraryPtr ml, int64_t lastId )
+{
+    static const std::string req = "SELECT COUNT(id_file) FROM " + policy::FileTable::Name
+            + " WHERE parser_step != ? AND is_present != 0 AND folder_id IS NOT NULL AND parser_retries < 3"
+            " AND id_file <= ?";
+    auto dbConn = ml->getConn();
+    sqlite::Connection::ReadContext ctx;
+    if ( sqlite::Transaction::transactionInProgress() == false )
+        ctx = dbConn->acquireReadContext();
+    sqlite::Statement stmt( dbConn, req );
+    stmt.execute( parser::Task::ParserStep::Completed, lastId );
+    auto row = stmt.row();
+    if ( row == nullptr )
+        return 0;
+    return row.load<uint32_t>( 0 );
 }
 
 void File::resetRetryCount( MediaLibraryPtr ml )
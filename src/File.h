@@ -45,7 +45,7 @@ struct FileTable
 };
 }
 
-class File : public IFile, public DatabaseHelpers<File, policy::FileTable>
+class File : public IFile, public DatabaseHelpers<File, policy::FileTable, cachepolicy::Bounded<File>>
 {
 public:
 
@@ -82,6 +82,20 @@ public:
                                                   const fs::IFile& file, int64_t folderId, bool isRemovable );
     static std::shared_ptr<File> createFromMedia( MediaLibraryPtr ml, int64_t mediaId, Type type,
                                                   const std::string& mrl );
+    /**
+     * @brief createBatch Creates the files for the provided media using
+     *        multi-row insertions.
+     *
+     * mediaIds & files must have the same size, each file being attached to
+     * the media with the same index. All the files must belong to the same
+     * folder.
+     * @return The created files, in the same order, or an empty vector in case
+     *         of failure.
+     */
+    static std::vector<std::shared_ptr<File>> createBatch( MediaLibraryPtr ml,
+                                            const std::vector<int64_t>& mediaIds, Type type,
+                                            const std::vector<std::shared_ptr<fs::IFile>>& files,
+                                            int64_t folderId, bool isRemovable );
 
     static std::shared_ptr<File> createFromPlaylist( MediaLibraryPtr ml, int64_t playlistId, const fs::IFile& file,
                                                      int64_t folderId, bool isRemovable );
@@ -110,7 +124,22 @@ public:
      */
     static std::shared_ptr<File> fromExternalMrl( MediaLibraryPtr ml, const std::string& mrl );
 
-    static std::vector<std::shared_ptr<File>> fetchUnparsed( MediaLibraryPtr ml );
+    /**
+     * @brief fetchUnparsed Returns at most nbFiles unparsed files, ordered by
+     * id, whose id is greater than afterId and not greater than lastId
+     */
+    static std::vector<std::shared_ptr<File>> fetchUnparsed( MediaLibraryPtr ml, int64_t afterId,
+                                                             int64_t lastId, uint32_t nbFiles );
+    /**
+     * @brief lastUnparsedId Returns the greatest id of the unparsed files, or
+     * 0 if all files are parsed
+     */
+    static int64_t lastUnparsedId( MediaLibraryPtr ml );
+    /**
+     * @brief countUnparsed Returns the number of unparsed files whose id is
+     * not greater than lastId
+     */
+    static uint32_t countUnparsed( MediaLibraryPtr ml, int64_t lastId );
     static void resetRetryCount( MediaLibraryPtr ml );
     static void resetParsing( MediaLibraryPtr ml );
 
@@ -0,0 +1,228 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "FuzzyIndex.h"
+
+#include "Album.h"
+#include "Artist.h"
+#include "Media.h"
+#include "database/SqliteTools.h"
+#include "logging/Logger.h"
+
+namespace medialibrary
+{
+
+namespace
+{
+
+// The minimal fraction of the pattern trigrams a value must contain
+const float MinSimilarity = 0.4f;
+
+// Lists the indexed value of each record
+const std::string& loadRequest( FuzzyIndex::Category category )
+{
+    static const std::string reqs[] = {
+        "SELECT id_media, title FROM " + policy::MediaTable::Name +
+            " WHERE is_present != 0",
+        "SELECT id_album, title FROM " + policy::AlbumTable::Name +
+            " WHERE is_present != 0 AND title IS NOT NULL",
+        "SELECT id_artist, name FROM " + policy::ArtistTable::Name +
+            " WHERE is_present != 0 AND name IS NOT NULL",
+    };
+    return reqs[static_cast<size_t>( category )];
+}
+
+const std::string& refreshRequest( FuzzyIndex::Category category )
+{
+    static const std::string reqs[] = {
+        loadRequest( FuzzyIndex::Category::Media ) + " AND id_media IN",
+        loadRequest( FuzzyIndex::Category::Album ) + " AND id_album IN",
+        loadRequest( FuzzyIndex::Category::Artist ) + " AND id_artist IN",
+    };
+    return reqs[static_cast<size_t>( category )];
+}
+
+}
+
+FuzzyIndex::FuzzyIndex( MediaLibraryPtr ml )
+    : m_ml( ml )
+    , m_loaded( false )
+{
+}
+
+void FuzzyIndex::invalidate( Category category, int64_t id )
+{
+    std::lock_guard<compat::Mutex> lock( m_pendingLock );
+    // Nothing to keep up to date until the indexes get loaded
+    if ( m_loaded == false )
+        return;
+    m_pending[static_cast<size_t>( category )].insert( id );
+}
+
+void FuzzyIndex::clear()
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    {
+        std::lock_guard<compat::Mutex> pendingLock( m_pendingLock );
+        m_loaded = false;
+        for ( auto& p : m_pending )
+            p.clear();
+    }
+    for ( auto& idx : m_indexes )
+        idx.clear();
+}
+
+SearchAggregate FuzzyIndex::search( const std::string& pattern, uint32_t nbResults )
+{
+    std::vector<int64_t> ids[NbCategories];
+    {
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        try
+        {
+            bool loaded;
+            {
+                std::lock_guard<compat::Mutex> pendingLock( m_pendingLock );
+                loaded = m_loaded;
+                // Flag the indexes as loaded before reading the records, so
+                // that concurrent modifications get recorded
+                m_loaded = true;
+            }
+            if ( loaded == false )
+                load();
+            else
+                refresh();
+        }
+        catch ( const sqlite::errors::GenericExecution& ex )
+        {
+            if ( sqlite::errors::isInnocuous( ex ) == false )
+                throw;
+            LOG_WARN( "Ignoring innocuous error: ", ex.what() );
+            // Some modifications might have been lost: start over next time
+            std::lock_guard<compat::Mutex> pendingLock( m_pendingLock );
+            m_loaded = false;
+            return {};
+        }
+        for ( auto i = 0u; i < NbCategories; ++i )
+        {
+            for ( const auto& m : m_indexes[i].search( pattern, MinSimilarity, nbResults ) )
+                ids[i].push_back( m.id );
+        }
+    }
+    SearchAggregate res;
+    res.albums = Album::fetchMany<IAlbum>( m_ml, ids[static_cast<size_t>( Category::Album )] );
+    res.artists = Artist::fetchMany<IArtist>( m_ml, ids[static_cast<size_t>( Category::Artist )] );
+    for ( auto& m : Media::fetchMany<IMedia>( m_ml, ids[static_cast<size_t>( Category::Media )] ) )
+    {
+        switch ( m->subType() )
+        {
+        case IMedia::SubType::AlbumTrack:
+            res.media.tracks.push_back( std::move( m ) );
+            break;
+        case IMedia::SubType::Movie:
+            res.media.movies.push_back( std::move( m ) );
+            break;
+        case IMedia::SubType::ShowEpisode:
+            res.media.episodes.push_back( std::move( m ) );
+            break;
+        default:
+            res.media.others.push_back( std::move( m ) );
+            break;
+        }
+    }
+    return res;
+}
+
+void FuzzyIndex::load()
+{
+    auto dbConn = m_ml->getConn();
+    sqlite::Connection::ReadContext ctx;
+    if ( sqlite::Transaction::transactionInProgress() == false )
+    {
+        // A write in progress might have modified some records before the
+        // indexes were flagged as loaded, and they wouldn't be flagged again
+        // once committed, so let it complete first. The later writes are
+        // recorded as pending.
+        if ( dbConn->isCacheable( dbConn->cacheGeneration() ) == false )
+        {
+            auto writeCtx = dbConn->acquireWriteContext();
+        }
+        ctx = dbConn->acquireReadContext();
+    }
+    for ( auto i = 0u; i < NbCategories; ++i )
+    {
+        auto& idx = m_indexes[i];
+        idx.clear();
+        sqlite::Statement stmt( dbConn, loadRequest( static_cast<Category>( i ) ) );
+        stmt.execute();
+        sqlite::Row row;
+        while ( ( row = stmt.row() ) != nullptr )
+        {
+            int64_t id;
+            std::string value;
+            row >> id >> value;
+            idx.insert( id, value );
+        }
+        idx.compact();
+    }
+}
+
+void FuzzyIndex::refresh()
+{
+    std::array<std::unordered_set<int64_t>, NbCategories> pending;
+    {
+        std::lock_guard<compat::Mutex> lock( m_pendingLock );
+        std::swap( pending, m_pending );
+    }
+    auto dbConn = m_ml->getConn();
+    auto generation = dbConn->cacheGeneration();
+    for ( auto i = 0u; i < NbCategories; ++i )
+    {
+        if ( pending[i].empty() == true )
+            continue;
+        auto& idx = m_indexes[i];
+        std::vector<int64_t> ids{ begin( pending[i] ), end( pending[i] ) };
+        // Records which are gone or don't match anymore won't be returned
+        for ( auto id : ids )
+            idx.remove( id );
+        sqlite::Tools::forEachRowIn( m_ml, refreshRequest( static_cast<Category>( i ) ), ids,
+                                     [&idx]( sqlite::Row& row ) {
+            int64_t id;
+            std::string value;
+            row >> id >> value;
+            idx.insert( id, value );
+        });
+    }
+    // The records might have been read before the write which flagged them
+    // got committed, so read them once again during the next search
+    if ( dbConn->isCacheable( generation ) == false )
+    {
+        std::lock_guard<compat::Mutex> lock( m_pendingLock );
+        for ( auto i = 0u; i < NbCategories; ++i )
+            m_pending[i].insert( begin( pending[i] ), end( pending[i] ) );
+    }
+}
+
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <unordered_set>
+
+#include "compat/Mutex.h"
+#include "medialibrary/IMediaLibrary.h"
+#include "Types.h"
+#include "utils/TrigramIndex.h"
+
+namespace medialibrary
+{
+
+/**
+ * @brief FuzzyIndex provides a typo tolerant search over the media titles,
+ *        the album titles & the artist names.
+ *
+ * The trigram indexes are loaded upon the first search. They are then kept
+ * up to date from the sqlite update hooks, which only flag the modified
+ * records, since no request can be run from a hook. The flagged records are
+ * read back before the next search.
+ */
+class FuzzyIndex
+{
+public:
+    enum class Category : uint8_t
+    {
+        Media,
+        Album,
+        Artist,
+    };
+
+    explicit FuzzyIndex( MediaLibraryPtr ml );
+
+    /**
+     * @brief invalidate Flags a record as inserted, modified or removed
+     * This is meant to be called from an sqlite update hook.
+     */
+    void invalidate( Category category, int64_t id );
+    /**
+     * @brief clear Drops the indexes, which will be loaded again upon the
+     *              next search.
+     */
+    void clear();
+    /**
+     * @brief search Returns the albums, artists & media matching the pattern
+     * @param nbResults The maximum number of results per category, 0 for no limit
+     */
+    SearchAggregate search( const std::string& pattern, uint32_t nbResults );
+
+private:
+    void load();
+    void refresh();
+
+private:
+    static const size_t NbCategories = 3;
+
+    MediaLibraryPtr m_ml;
+    // Protects the indexes
+    compat::Mutex m_lock;
+    std::array<TrigramIndex, NbCategories> m_indexes;
+    // Protects the pending records & the loaded flag, which are accessed from
+    // the update hooks
+    compat::Mutex m_pendingLock;
+    std::array<std::unordered_set<int64_t>, NbCategories> m_pending;
+    bool m_loaded;
+};
+
+}
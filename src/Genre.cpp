@@ -106,8 +106,10 @@ void Genre::createTable( sqlite::Connection* dbConn )
             "nb_tracks INTEGER NOT NULL DEFAULT 0"
         ")";
     const std::string vtableReq = "CREATE VIRTUAL TABLE IF NOT EXISTS "
-                + policy::GenreTable::Name + "Fts USING FTS3("
-                "name"
+                + policy::GenreTable::Name + "Fts USING FTS5("
+                "name,"
+                "prefix = '2 3',"
+                "tokenize = 'unicode61 remove_diacritics 1'"
             ")";
 
     const std::string vtableInsertTrigger = "CREATE TRIGGER IF NOT EXISTS insert_genre_fts"
@@ -173,8 +175,9 @@ std::shared_ptr<Genre> Genre::fromName( MediaLibraryPtr ml, const std::string& n
 std::vector<GenrePtr> Genre::search( MediaLibraryPtr ml, const std::string& name )
 {
     static const std::string req = "SELECT * FROM " + policy::GenreTable::Name + " WHERE id_genre IN "
-            "(SELECT rowid FROM " + policy::GenreTable::Name + "Fts WHERE name MATCH '*' || ? || '*')";
-    return fetchAll<IGenre>( ml, req, name );
+            "(SELECT rowid FROM " + policy::GenreTable::Name + "Fts WHERE " +
+            policy::GenreTable::Name + "Fts MATCH ?)";
+    return fetchAll<IGenre>( ml, req, sqlite::Tools::sanitizePattern( name ) );
 }
 
 std::vector<GenrePtr> Genre::listAll( MediaLibraryPtr ml, SortingCriteria, bool desc )
@@ -185,4 +188,14 @@ std::vector<GenrePtr> Genre::listAll( MediaLibraryPtr ml, SortingCriteria, bool
     return fetchAll<IGenre>( ml, req );
 }
 
+Page<IGenre> Genre::listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                              uint32_t nbItems, const std::string& after )
+{
+    std::vector<sqlite::Keyset::Term> terms;
+    terms.emplace_back( "IFNULL(name, '') COLLATE NOCASE", false, desc );
+    sqlite::Keyset keyset( sort, desc, std::move( terms ), "id_genre", sqlite::Keyset::Filter::Where );
+    auto req = "SELECT *" + keyset.columns() + " FROM " + policy::GenreTable::Name;
+    return fetchPage<IGenre>( ml, keyset, nbItems, after, req );
+}
+
 }
@@ -60,6 +60,8 @@ public:
     static std::shared_ptr<Genre> fromName( MediaLibraryPtr ml, const std::string& name );
     static std::vector<GenrePtr> search( MediaLibraryPtr ml, const std::string& name );
     static std::vector<GenrePtr> listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc );
+    static Page<IGenre> listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                                  uint32_t nbItems, const std::string& after );
 
 private:
     MediaLibraryPtr m_ml;
@@ -96,7 +96,7 @@ void Label::createTable( sqlite::Connection* dbConnection )
             "BEFORE DELETE ON " + policy::LabelTable::Name +
             " BEGIN"
             " UPDATE " + policy::MediaTable::Name + "Fts SET labels = TRIM(REPLACE(labels, old.name, ''))"
-            " WHERE labels MATCH old.name;"
+            " WHERE labels MATCH '\"' || REPLACE(old.name, '\"', '\"\"') || '\"';"
             " END";
     sqlite::Tools::executeRequest( dbConnection, req );
     sqlite::Tools::executeRequest( dbConnection, relReq );
@@ -106,6 +106,24 @@ std::shared_ptr<Media> Media::create( MediaLibraryPtr ml, Type type, const std::
     return self;
 }
 
+std::vector<std::shared_ptr<Media>> Media::createBatch( MediaLibraryPtr ml, Type type,
+                                                       const std::vector<std::string>& fileNames )
+{
+    std::vector<std::shared_ptr<Media>> media;
+    media.reserve( fileNames.size() );
+    for ( const auto& fileName : fileNames )
+        media.push_back( std::make_shared<Media>( ml, fileName, type ) );
+    static const std::string req = "INSERT INTO " + policy::MediaTable::Name +
+            "(type, insertion_date, title, filename) VALUES";
+
+    if ( insertBatch( ml, media, req, "(?, ?, ?, ?)", 4,
+                      []( sqlite::Statement& s, const Media& m ) {
+            s.bind( m.m_type, m.m_insertionDate, m.m_title, m.m_filename );
+        }) == false )
+        return {};
+    return media;
+}
+
 AlbumTrackPtr Media::albumTrack() const
 {
     if ( m_subType != SubType::AlbumTrack )
@@ -287,7 +305,7 @@ const IMediaMetadata& Media::metadata( IMedia::MetadataType type ) const
                 " WHERE id_media = ?";
         auto conn = m_ml->getConn();
         auto ctx = conn->acquireReadContext();
-        sqlite::Statement stmt( conn->handle(), req );
+        sqlite::Statement stmt( conn, req );
         stmt.execute( m_id );
         for ( sqlite::Row row = stmt.row(); row != nullptr; row = stmt.row() )
         {
@@ -428,9 +446,9 @@ std::vector<MediaPtr> Media::listAll( MediaLibraryPtr ml, IMedia::Type type, Sor
                 " WHERE m.type = ?"
                 " AND f.type = ?";
         if ( sort == SortingCriteria::LastModificationDate )
-            req += " ORDER BY f.last_modification_date";
+            req += " ORDER BY IFNULL(f.last_modification_date, 0)";
         else
-            req += " ORDER BY f.size";
+            req += " ORDER BY IFNULL(f.size, 0)";
         if ( desc == true )
             req += " DESC";
         return fetchAll<IMedia>( ml, req, type, File::Type::Main );
@@ -462,6 +480,48 @@ std::vector<MediaPtr> Media::listAll( MediaLibraryPtr ml, IMedia::Type type, Sor
     return fetchAll<IMedia>( ml, req, type );
 }
 
+Page<IMedia> Media::listPage( MediaLibraryPtr ml, IMedia::Type type, SortingCriteria sort, bool desc,
+                              uint32_t nbItems, const std::string& after )
+{
+    std::vector<sqlite::Keyset::Term> terms;
+    if ( sort == SortingCriteria::LastModificationDate || sort == SortingCriteria::FileSize )
+    {
+        if ( sort == SortingCriteria::LastModificationDate )
+            terms.emplace_back( "IFNULL(f.last_modification_date, 0)", true, desc );
+        else
+            terms.emplace_back( "IFNULL(f.size, 0)", true, desc );
+        sqlite::Keyset keyset( sort, desc, std::move( terms ), "m.id_media", sqlite::Keyset::Filter::And );
+        auto req = "SELECT m.*" + keyset.columns() + " FROM " + policy::MediaTable::Name + " m INNER JOIN "
+                + policy::FileTable::Name + " f ON m.id_media = f.media_id"
+                " WHERE m.type = ?"
+                " AND f.type = ?";
+        return fetchPage<IMedia>( ml, keyset, nbItems, after, req, type, File::Type::Main );
+    }
+    switch ( sort )
+    {
+    case SortingCriteria::Duration:
+        terms.emplace_back( "m.duration", true, desc );
+        break;
+    case SortingCriteria::InsertionDate:
+        terms.emplace_back( "m.insertion_date", true, desc );
+        break;
+    case SortingCriteria::ReleaseDate:
+        terms.emplace_back( "IFNULL(m.release_date, 0)", true, desc );
+        break;
+    case SortingCriteria::PlayCount:
+        // Make decreasing order default for play count sorting
+        terms.emplace_back( "IFNULL(m.play_count, 0)", true, !desc );
+        break;
+    default:
+        terms.emplace_back( "IFNULL(m.title, '') COLLATE NOCASE", false, desc );
+        break;
+    }
+    sqlite::Keyset keyset( sort, desc, std::move( terms ), "m.id_media", sqlite::Keyset::Filter::And );
+    auto req = "SELECT m.*" + keyset.columns() + " FROM " + policy::MediaTable::Name + " m"
+            " WHERE m.type = ? AND m.is_present != 0";
+    return fetchPage<IMedia>( ml, keyset, nbItems, after, req, type );
+}
+
 int64_t Media::id() const
 {
     return m_id;
@@ -538,9 +598,11 @@ void Media::createTable( sqlite::Connection* connection )
     const std::string indexReq = "CREATE INDEX IF NOT EXISTS index_last_played_date ON "
             + policy::MediaTable::Name + "(last_played_date DESC)";
     const std::string vtableReq = "CREATE VIRTUAL TABLE IF NOT EXISTS "
-                + policy::MediaTable::Name + "Fts USING FTS3("
+                + policy::MediaTable::Name + "Fts USING FTS5("
                 "title,"
-                "labels"
+                "labels,"
+                "prefix = '2 3',"
+                "tokenize = 'unicode61 remove_diacritics 1'"
             ")";
     const std::string metadataReq = "CREATE TABLE IF NOT EXISTS " + policy::MediaMetadataTable::Name + "("
             "id_media INTEGER,"
@@ -661,9 +723,21 @@ std::vector<MediaPtr> Media::search( MediaLibraryPtr ml, const std::string& titl
 {
     static const std::string req = "SELECT * FROM " + policy::MediaTable::Name + " WHERE"
             " id_media IN (SELECT rowid FROM " + policy::MediaTable::Name + "Fts"
-            " WHERE " + policy::MediaTable::Name + "Fts MATCH '*' || ? || '*')"
+            " WHERE " + policy::MediaTable::Name + "Fts MATCH ?)"
             "AND is_present = 1";
-    return Media::fetchAll<IMedia>( ml, req, title );
+    return Media::fetchAll<IMedia>( ml, req, sqlite::Tools::sanitizePattern( title ) );
+}
+
+std::vector<int64_t> Media::searchIn( MediaLibraryPtr ml, const std::string& ftsPattern,
+                                      const std::vector<int64_t>& ids )
+{
+    static const std::string req = "SELECT m.id_media FROM " + policy::MediaTable::Name + "Fts"
+            " INNER JOIN " + policy::MediaTable::Name + " m ON m.id_media = " +
+            policy::MediaTable::Name + "Fts.rowid"
+            " WHERE " + policy::MediaTable::Name + "Fts MATCH ?"
+            " AND m.is_present = 1"
+            " AND " + policy::MediaTable::Name + "Fts.rowid IN";
+    return sqlite::Tools::fetchIdsIn( ml, req, ids, ftsPattern );
 }
 
 std::vector<MediaPtr> Media::fetchHistory( MediaLibraryPtr ml )
@@ -55,7 +55,7 @@ struct MediaMetadataTable
 };
 }
 
-class Media : public IMedia, public DatabaseHelpers<Media, policy::MediaTable>
+class Media : public IMedia, public DatabaseHelpers<Media, policy::MediaTable, cachepolicy::Bounded<Media>>
 {
     class MediaMetadata : public IMediaMetadata
     {
@@ -85,6 +85,14 @@ class Media : public IMedia, public DatabaseHelpers<Media, policy::MediaTable>
         Media( MediaLibraryPtr ml, const std::string& title, Type type);
 
         static std::shared_ptr<Media> create( MediaLibraryPtr ml, Type type, const std::string& fileName );
+        ///
+        /// \brief createBatch Creates a media for each of the provided file names
+        /// using multi-row insertions.
+        /// \return The created media, in the same order as the file names, or
+        ///         an empty vector in case of failure.
+        ///
+        static std::vector<std::shared_ptr<Media>> createBatch( MediaLibraryPtr ml, Type type,
+                                                                const std::vector<std::string>& fileNames );
         static void createTable( sqlite::Connection* connection );
         static void createTriggers( sqlite::Connection* connection );
 
@@ -140,7 +148,15 @@ class Media : public IMedia, public DatabaseHelpers<Media, policy::MediaTable>
         void removeFile( File& file );
 
         static std::vector<MediaPtr> listAll(MediaLibraryPtr ml, Type type , SortingCriteria sort, bool desc);
+        static Page<IMedia> listPage( MediaLibraryPtr ml, Type type, SortingCriteria sort, bool desc,
+                                      uint32_t nbItems, const std::string& after );
         static std::vector<MediaPtr> search( MediaLibraryPtr ml, const std::string& title );
+        ///
+        /// \brief searchIn Returns the ids of the provided media which match
+        ///                 the provided, already sanitized, FTS pattern
+        ///
+        static std::vector<int64_t> searchIn( MediaLibraryPtr ml, const std::string& ftsPattern,
+                                              const std::vector<int64_t>& ids );
         static std::vector<MediaPtr> fetchHistory( MediaLibraryPtr ml );
         static void clearHistory( MediaLibraryPtr ml );
 
@@ -40,10 +40,13 @@
 #include "Device.h"
 #include "File.h"
 #include "Folder.h"
+#include "FuzzyIndex.h"
+#include "metadata_services/ResolutionCache.h"
 #include "Genre.h"
 #include "History.h"
 #include "Media.h"
 #include "MediaLibrary.h"
+#include "MediaSearchSession.h"
 #include "Label.h"
 #include "logging/Logger.h"
 #include "Movie.h"
@@ -60,6 +63,7 @@
 #include "discoverer/FsDiscoverer.h"
 
 // Metadata services:
+#include "metadata_services/native/NativeTagService.h"
 #include "metadata_services/vlc/VLCMetadataService.h"
 #include "metadata_services/vlc/VLCThumbnailer.h"
 #include "metadata_services/MetadataParser.h"
@@ -92,7 +96,12 @@ const size_t MediaLibrary::NbSupportedExtensions = sizeof(supportedExtensions) /
 
 MediaLibrary::MediaLibrary()
     : m_callback( nullptr )
+    , m_fuzzyIndex( new FuzzyIndex( this ) )
+    , m_resolutionCache( new ResolutionCache )
     , m_verbosity( LogLevel::Error )
+    , m_metadataExtractionConcurrency( 0 )
+    , m_thumbnailerConcurrency( 0 )
+    , m_maxParserBacklog( 0 )
     , m_settings( this )
     , m_initialized( false )
     , m_discovererIdle( true )
@@ -104,6 +113,9 @@ MediaLibrary::MediaLibrary()
 MediaLibrary::~MediaLibrary()
 {
     // Explicitely stop the discoverer, to avoid it writting while tearing down.
+    // It might be waiting for the parser to catch up, so release it first
+    if ( m_parser != nullptr )
+        m_parser->setMaxBacklog( 0 );
     if ( m_discovererWorker != nullptr )
         m_discovererWorker->stop();
     if ( m_parser != nullptr )
@@ -113,6 +125,8 @@ MediaLibrary::~MediaLibrary()
 
 void MediaLibrary::clearCache()
 {
+    m_fuzzyIndex->clear();
+    m_resolutionCache->clear();
     Media::clear();
     Folder::clear();
     Label::clear();
@@ -180,6 +194,7 @@ void MediaLibrary::registerEntityHooks()
 
     m_dbConnection->registerUpdateHook( policy::MediaTable::Name,
                                         [this]( sqlite::Connection::HookReason reason, int64_t rowId ) {
+        m_fuzzyIndex->invalidate( FuzzyIndex::Category::Media, rowId );
         if ( reason != sqlite::Connection::HookReason::Delete )
             return;
         Media::removeFromCache( rowId );
@@ -187,15 +202,21 @@ void MediaLibrary::registerEntityHooks()
     });
     m_dbConnection->registerUpdateHook( policy::ArtistTable::Name,
                                         [this]( sqlite::Connection::HookReason reason, int64_t rowId ) {
+        m_fuzzyIndex->invalidate( FuzzyIndex::Category::Artist, rowId );
         if ( reason != sqlite::Connection::HookReason::Delete )
             return;
+        m_resolutionCache->onArtistDeleted( rowId );
         Artist::removeFromCache( rowId );
         m_modificationNotifier->notifyArtistRemoval( rowId );
     });
     m_dbConnection->registerUpdateHook( policy::AlbumTable::Name,
                                         [this]( sqlite::Connection::HookReason reason, int64_t rowId ) {
+        m_fuzzyIndex->invalidate( FuzzyIndex::Category::Album, rowId );
+        if ( reason == sqlite::Connection::HookReason::Insert )
+            m_resolutionCache->onAlbumInserted();
         if ( reason != sqlite::Connection::HookReason::Delete )
             return;
+        m_resolutionCache->onAlbumDeleted( rowId );
         Album::removeFromCache( rowId );
         m_modificationNotifier->notifyAlbumRemoval( rowId );
     });
@@ -216,7 +237,13 @@ void MediaLibrary::registerEntityHooks()
     m_dbConnection->registerUpdateHook( policy::DeviceTable::Name, &propagateDeletionToCache<Device> );
     m_dbConnection->registerUpdateHook( policy::FileTable::Name, &propagateDeletionToCache<File> );
     m_dbConnection->registerUpdateHook( policy::FolderTable::Name, &propagateDeletionToCache<Folder> );
-    m_dbConnection->registerUpdateHook( policy::GenreTable::Name, &propagateDeletionToCache<Genre> );
+    m_dbConnection->registerUpdateHook( policy::GenreTable::Name,
+                                        [this]( sqlite::Connection::HookReason reason, int64_t rowId ) {
+        if ( reason != sqlite::Connection::HookReason::Delete )
+            return;
+        m_resolutionCache->onGenreDeleted( rowId );
+        Genre::removeFromCache( rowId );
+    });
     m_dbConnection->registerUpdateHook( policy::LabelTable::Name, &propagateDeletionToCache<Label> );
     m_dbConnection->registerUpdateHook( policy::MovieTable::Name, &propagateDeletionToCache<Movie> );
     m_dbConnection->registerUpdateHook( policy::ShowTable::Name, &propagateDeletionToCache<Show> );
@@ -227,7 +254,11 @@ void MediaLibrary::registerEntityHooks()
 
 bool MediaLibrary::validateSearchPattern( const std::string& pattern )
 {
-    return pattern.size() >= 3;
+    // A blank pattern would result in an empty, and invalid, MATCH expression
+    auto words = sqlite::Tools::patternWords( pattern );
+    return std::any_of( begin( words ), end( words ), []( const std::string& w ) {
+        return w.size() >= 3;
+    });
 }
 
 InitializeResult MediaLibrary::initialize( const std::string& dbPath,
@@ -321,7 +352,15 @@ void MediaLibrary::setVerbosity( LogLevel v )
 
 MediaPtr MediaLibrary::media( int64_t mediaId ) const
 {
-    return Media::fetch( this, mediaId );
+    auto m = Media::fetch( this, mediaId );
+    if ( m != nullptr )
+        prioritizeRequested( mediaId );
+    return m;
+}
+
+std::vector<MediaPtr> MediaLibrary::media( const std::vector<int64_t>& mediaIds ) const
+{
+    return Media::fetchMany<IMedia>( this, mediaIds );
 }
 
 MediaPtr MediaLibrary::media( const std::string& mrl ) const
@@ -368,7 +407,30 @@ MediaPtr MediaLibrary::media( const std::string& mrl ) const
                   device->isRemovable() ? "NOT" : "", "removable)");
         return nullptr;
     }
-    return file->media();
+    auto m = file->media();
+    if ( m != nullptr )
+        prioritizeRequested( m->id() );
+    return m;
+}
+
+void MediaLibrary::prioritize( int64_t mediaId )
+{
+    if ( m_parser != nullptr )
+        m_parser->prioritize( mediaId );
+}
+
+void MediaLibrary::prioritize( const std::string& mrl )
+{
+    if ( m_parser != nullptr )
+        m_parser->prioritize( mrl );
+}
+
+void MediaLibrary::prioritizeRequested( int64_t mediaId ) const
+{
+    // The application is likely to display this media now, so make sure it
+    // doesn't wait behind a large import
+    if ( m_parser != nullptr && m_parserIdle == false )
+        m_parser->prioritizeIfPending( mediaId );
 }
 
 MediaPtr MediaLibrary::addMedia( const std::string& mrl )
@@ -403,6 +465,18 @@ std::vector<MediaPtr> MediaLibrary::videoFiles( SortingCriteria sort, bool desc
     return Media::listAll( this, IMedia::Type::Video, sort, desc );
 }
 
+Page<IMedia> MediaLibrary::audioFiles( uint32_t nbItems, const std::string& after,
+                                       SortingCriteria sort, bool desc ) const
+{
+    return Media::listPage( this, IMedia::Type::Audio, sort, desc, nbItems, after );
+}
+
+Page<IMedia> MediaLibrary::videoFiles( uint32_t nbItems, const std::string& after,
+                                       SortingCriteria sort, bool desc ) const
+{
+    return Media::listPage( this, IMedia::Type::Video, sort, desc, nbItems, after );
+}
+
 bool MediaLibrary::isExtensionSupported( const char* ext )
 {
     return std::binary_search( std::begin( supportedExtensions ),
@@ -446,6 +520,12 @@ void MediaLibrary::addDiscoveredFile( std::shared_ptr<fs::IFile> fileFs,
                          std::move( parentFolderFs ), std::move( parentPlaylist ) );
 }
 
+void MediaLibrary::waitForParserBacklog()
+{
+    if ( m_parser != nullptr )
+        m_parser->waitForBacklog();
+}
+
 bool MediaLibrary::deleteFolder( const Folder& folder )
 {
     LOG_INFO( "deleting folder ", folder.mrl() );
@@ -496,11 +576,23 @@ std::vector<AlbumPtr> MediaLibrary::albums( SortingCriteria sort, bool desc ) co
     return Album::listAll( this, sort, desc );
 }
 
+Page<IAlbum> MediaLibrary::albums( uint32_t nbItems, const std::string& after,
+                                   SortingCriteria sort, bool desc ) const
+{
+    return Album::listPage( this, sort, desc, nbItems, after );
+}
+
 std::vector<GenrePtr> MediaLibrary::genres( SortingCriteria sort, bool desc ) const
 {
     return Genre::listAll( this, sort, desc );
 }
 
+Page<IGenre> MediaLibrary::genres( uint32_t nbItems, const std::string& after,
+                                   SortingCriteria sort, bool desc ) const
+{
+    return Genre::listPage( this, sort, desc, nbItems, after );
+}
+
 GenrePtr MediaLibrary::genre( int64_t id ) const
 {
     return Genre::fetch( this, id );
@@ -563,6 +655,12 @@ std::vector<ArtistPtr> MediaLibrary::artists( SortingCriteria sort, bool desc )
     return Artist::listAll( this, sort, desc );
 }
 
+Page<IArtist> MediaLibrary::artists( uint32_t nbItems, const std::string& after,
+                                     SortingCriteria sort, bool desc ) const
+{
+    return Artist::listPage( this, sort, desc, nbItems, after );
+}
+
 PlaylistPtr MediaLibrary::createPlaylist( const std::string& name )
 {
     try
@@ -581,6 +679,12 @@ std::vector<PlaylistPtr> MediaLibrary::playlists( SortingCriteria sort, bool des
     return Playlist::listAll( this, sort, desc );
 }
 
+Page<IPlaylist> MediaLibrary::playlists( uint32_t nbItems, const std::string& after,
+                                         SortingCriteria sort, bool desc )
+{
+    return Playlist::listPage( this, sort, desc, nbItems, after );
+}
+
 PlaylistPtr MediaLibrary::playlist( int64_t id ) const
 {
     return Playlist::fetch( this, id );
@@ -643,29 +747,8 @@ bool MediaLibrary::clearHistory()
 
 MediaSearchAggregate MediaLibrary::searchMedia( const std::string& title ) const
 {
-    if ( validateSearchPattern( title ) == false )
-        return {};
-    auto tmp = Media::search( this, title );
-    MediaSearchAggregate res;
-    for ( auto& m : tmp )
-    {
-        switch ( m->subType() )
-        {
-        case IMedia::SubType::AlbumTrack:
-            res.tracks.emplace_back( std::move( m ) );
-            break;
-        case IMedia::SubType::Movie:
-            res.movies.emplace_back( std::move( m ) );
-            break;
-        case IMedia::SubType::ShowEpisode:
-            res.episodes.emplace_back( std::move( m ) );
-            break;
-        default:
-            res.others.emplace_back( std::move( m ) );
-            break;
-        }
-    }
-    return res;
+    MediaSearchSession session( this );
+    return session.searchMedia( title );
 }
 
 std::vector<PlaylistPtr> MediaLibrary::searchPlaylists( const std::string& name ) const
@@ -696,14 +779,129 @@ std::vector<ArtistPtr> MediaLibrary::searchArtists(const std::string& name ) con
     return Artist::search( this, name );
 }
 
+SearchAggregate MediaLibrary::fuzzySearch( const std::string& pattern, uint32_t nbResults ) const
+{
+    return m_fuzzyIndex->search( pattern, nbResults );
+}
+
+std::unique_ptr<IMediaSearchSession> MediaLibrary::createMediaSearchSession() const
+{
+    return std::unique_ptr<IMediaSearchSession>( new MediaSearchSession( this ) );
+}
+
 SearchAggregate MediaLibrary::search( const std::string& pattern ) const
 {
+    return search( pattern, 0 );
+}
+
+namespace
+{
+
+enum class SearchCategory : uint8_t
+{
+    Album,
+    Artist,
+    Genre,
+    Playlist,
+    Episode,
+    Movie,
+    Other,
+    Track,
+};
+
+// Selects the ids of the best matching entities of a single category, ranked
+// by their bm25 relevance. ?1 is the MATCH expression, ?2 the maximum number
+// of results, or -1 for no limit.
+std::string rankedIds( SearchCategory category, const std::string& table,
+                       const std::string& pkColumn, const std::string& filter )
+{
+    const auto fts = table + "Fts";
+    return "SELECT " + std::to_string( static_cast<int>( category ) ) + ", id FROM "
+            "(SELECT t." + pkColumn + " AS id FROM " + fts +
+            " INNER JOIN " + table + " t ON t." + pkColumn + " = " + fts + ".rowid"
+            " WHERE " + fts + " MATCH ?1" + filter +
+            " ORDER BY " + fts + ".rank LIMIT ?2)";
+}
+
+// Freshly inserted media don't have a subtype yet, which means Unknown
+std::string rankedMediaIds( SearchCategory category, IMedia::SubType subType )
+{
+    return rankedIds( category, policy::MediaTable::Name,
+                      policy::MediaTable::PrimaryKeyColumn,
+                      " AND t.is_present = 1 AND IFNULL(t.subtype, 0) = " +
+                      std::to_string( static_cast<int>( subType ) ) );
+}
+
+}
+
+SearchAggregate MediaLibrary::search( const std::string& pattern, uint32_t nbResults ) const
+{
+    if ( validateSearchPattern( pattern ) == false )
+        return {};
+    // Rank & truncate all categories in a single request, and only hydrate
+    // the entities which made it to the results.
+    static const std::string req =
+            rankedIds( SearchCategory::Album, policy::AlbumTable::Name,
+                       policy::AlbumTable::PrimaryKeyColumn, " AND t.is_present != 0" ) +
+            " UNION ALL " +
+            rankedIds( SearchCategory::Artist, policy::ArtistTable::Name,
+                       policy::ArtistTable::PrimaryKeyColumn, " AND t.is_present != 0" ) +
+            " UNION ALL " +
+            rankedIds( SearchCategory::Genre, policy::GenreTable::Name,
+                       policy::GenreTable::PrimaryKeyColumn, "" ) +
+            " UNION ALL " +
+            rankedIds( SearchCategory::Playlist, policy::PlaylistTable::Name,
+                       policy::PlaylistTable::PrimaryKeyColumn, "" ) +
+            " UNION ALL " +
+            rankedMediaIds( SearchCategory::Episode, IMedia::SubType::ShowEpisode ) +
+            " UNION ALL " +
+            rankedMediaIds( SearchCategory::Movie, IMedia::SubType::Movie ) +
+            " UNION ALL " +
+            rankedMediaIds( SearchCategory::Other, IMedia::SubType::Unknown ) +
+            " UNION ALL " +
+            rankedMediaIds( SearchCategory::Track, IMedia::SubType::AlbumTrack );
+
+    std::vector<int64_t> ids[static_cast<int>( SearchCategory::Track ) + 1];
+    try
+    {
+        auto dbConn = getConn();
+        sqlite::Connection::ReadContext ctx;
+        if ( sqlite::Transaction::transactionInProgress() == false )
+            ctx = dbConn->acquireReadContext();
+        // The pattern is bound statically, so it must outlive the rows fetching
+        auto sanitizedPattern = sqlite::Tools::sanitizePattern( pattern );
+        sqlite::Statement stmt( dbConn, req );
+        stmt.execute( sanitizedPattern,
+                      nbResults != 0 ? static_cast<int64_t>( nbResults ) : -1 );
+        sqlite::Row row;
+        while ( ( row = stmt.row() ) != nullptr )
+        {
+            uint8_t category;
+            int64_t id;
+            row >> category >> id;
+            ids[category].push_back( id );
+        }
+    }
+    catch ( const sqlite::errors::GenericExecution& ex )
+    {
+        if ( sqlite::errors::isInnocuous( ex ) == false )
+            throw;
+        LOG_WARN( "Ignoring innocuous error: ", ex.what() );
+        return {};
+    }
+
+    auto idsOf = [&ids]( SearchCategory c ) -> const std::vector<int64_t>& {
+        return ids[static_cast<int>( c )];
+    };
     SearchAggregate res;
-    res.albums = searchAlbums( pattern );
-    res.artists = searchArtists( pattern );
-    res.genres = searchGenre( pattern );
-    res.media = searchMedia( pattern );
-    res.playlists = searchPlaylists( pattern );
+    res.albums = Album::fetchMany<IAlbum>( this, idsOf( SearchCategory::Album ) );
+    res.artists = Artist::fetchMany<IArtist>( this, idsOf( SearchCategory::Artist ) );
+    res.genres = Genre::fetchMany<IGenre>( this, idsOf( SearchCategory::Genre ) );
+    res.playlists = Playlist::fetchMany<IPlaylist>( this, idsOf( SearchCategory::Playlist ) );
+    res.media.episodes = Media::fetchMany<IMedia>( this, idsOf( SearchCategory::Episode ) );
+    res.media.movies = Media::fetchMany<IMedia>( this, idsOf( SearchCategory::Movie ) );
+    res.media.others = Media::fetchMany<IMedia>( this, idsOf( SearchCategory::Other ) );
+    res.media.tracks = Media::fetchMany<IMedia>( this, idsOf( SearchCategory::Track ) );
     return res;
 }
 
@@ -711,12 +909,17 @@ void MediaLibrary::startParser()
 {
     m_parser.reset( new Parser( this ) );
 
-    auto vlcService = std::unique_ptr<VLCMetadataService>( new VLCMetadataService );
+    auto nativeService = std::unique_ptr<NativeTagService>( new NativeTagService );
+    auto vlcService = std::unique_ptr<VLCMetadataService>(
+                new VLCMetadataService( m_metadataExtractionConcurrency ) );
     auto metadataService = std::unique_ptr<MetadataParser>( new MetadataParser );
-    auto thumbnailerService = std::unique_ptr<VLCThumbnailer>( new VLCThumbnailer );
+    auto thumbnailerService = std::unique_ptr<VLCThumbnailer>(
+                new VLCThumbnailer( m_thumbnailerConcurrency ) );
+    m_parser->addService( std::move( nativeService ) );
     m_parser->addService( std::move( vlcService ) );
     m_parser->addService( std::move( metadataService ) );
     m_parser->addService( std::move( thumbnailerService ) );
+    m_parser->setMaxBacklog( m_maxParserBacklog );
     m_parser->start();
 }
 
@@ -799,6 +1002,12 @@ InitializeResult MediaLibrary::updateDatabaseModel( unsigned int previousVersion
                     throw std::logic_error( "Failed to migrate from 7 to 8" );
                 previousVersion = 8;
             }
+            if ( previousVersion == 8 )
+            {
+                if ( migrateModel8to9() == false )
+                    throw std::logic_error( "Failed to migrate from 8 to 9" );
+                previousVersion = 9;
+            }
             // To be continued in the future!
 
             // Safety check: ensure we didn't forget a migration along the way
@@ -895,6 +1104,26 @@ bool MediaLibrary::migrateModel6to7()
     return true;
 }
 
+bool MediaLibrary::migrateModel8to9()
+{
+    // Replace the FTS3 search tables by FTS5 ones, which support prefix
+    // indexes. The triggers keeping them up to date only refer to the tables by
+    // name, so they don't need to be recreated, except for the label deletion
+    // one, which now quotes the label name.
+    auto t = getConn()->newTransaction();
+    using namespace policy;
+    std::string reqs[] = {
+#               include "database/migrations/migration8-9.sql"
+        "DROP TRIGGER IF EXISTS delete_label_fts",
+    };
+
+    for ( const auto& req : reqs )
+        sqlite::Tools::executeRequest( getConn(), req );
+    Label::createTable( getConn() );
+    t->commit();
+    return true;
+}
+
 void MediaLibrary::reload()
 {
     if ( m_discovererWorker != nullptr )
@@ -946,6 +1175,9 @@ void MediaLibrary::onDiscovererIdleChanged( bool idle )
             LOG_INFO( "Setting background idle state to ",
                       idle ? "true" : "false" );
             m_callback->onBackgroundTasksIdleChanged( idle );
+            // Now is a good time to flush the WAL, as no one should be writing
+            if ( idle == true )
+                m_dbConnection->checkpoint();
         }
     }
 }
@@ -961,6 +1193,9 @@ void MediaLibrary::onParserIdleChanged( bool idle )
             LOG_INFO( "Setting background idle state to ",
                       idle ? "true" : "false" );
             m_callback->onBackgroundTasksIdleChanged( idle );
+            // Now is a good time to flush the WAL, as no one should be writing
+            if ( idle == true )
+                m_dbConnection->checkpoint();
         }
     }
 }
@@ -980,6 +1215,11 @@ std::shared_ptr<ModificationNotifier> MediaLibrary::getNotifier() const
     return m_modificationNotifier;
 }
 
+ResolutionCache& MediaLibrary::getResolutionCache() const
+{
+    return *m_resolutionCache;
+}
+
 IDeviceListerCb* MediaLibrary::setDeviceLister( DeviceListerPtr lister )
 {
     assert( m_initialized == false );
@@ -1109,6 +1349,63 @@ void MediaLibrary::forceRescan()
     }
 }
 
+std::vector<QueryStats> MediaLibrary::queryStats() const
+{
+    if ( m_dbConnection == nullptr )
+        return {};
+    return m_dbConnection->profiler().stats();
+}
+
+void MediaLibrary::resetQueryStats()
+{
+    if ( m_dbConnection == nullptr )
+        return;
+    m_dbConnection->profiler().reset();
+}
+
+ParserStats MediaLibrary::parserStats() const
+{
+    if ( m_parser == nullptr )
+        return {};
+    return m_parser->stats();
+}
+
+void MediaLibrary::resetParserStats()
+{
+    if ( m_parser != nullptr )
+        m_parser->resetStats();
+}
+
+void MediaLibrary::setMaxCachedEntities( uint32_t nbEntities )
+{
+    cachepolicy::Bounded<Media>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<File>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<Album>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<AlbumTrack>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<Artist>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<AudioTrack>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<VideoTrack>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<Movie>::setMaxSize( nbEntities );
+    cachepolicy::Bounded<ShowEpisode>::setMaxSize( nbEntities );
+}
+
+void MediaLibrary::setMetadataExtractionConcurrency( uint8_t nbMedia )
+{
+    m_metadataExtractionConcurrency = nbMedia;
+}
+
+void MediaLibrary::setThumbnailerConcurrency( uint8_t nbThumbnails )
+{
+    m_thumbnailerConcurrency = nbThumbnails;
+}
+
+void MediaLibrary::setMaxParserBacklog( uint32_t nbFiles )
+{
+    m_maxParserBacklog = nbFiles;
+    if ( m_parser != nullptr )
+        m_parser->setMaxBacklog( nbFiles );
+}
+
 bool MediaLibrary::onDevicePlugged( const std::string& uuid, const std::string& mountpoint )
 {
     auto currentDevice = Device::fromUuid( this, uuid );
@@ -33,6 +33,8 @@ namespace medialibrary
 {
 
 class ModificationNotifier;
+class FuzzyIndex;
+class ResolutionCache;
 class DiscovererWorker;
 class Parser;
 class ParserService;
@@ -70,9 +72,14 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
 
         virtual MediaPtr media( int64_t mediaId ) const override;
         virtual MediaPtr media( const std::string& path ) const override;
+        virtual std::vector<MediaPtr> media( const std::vector<int64_t>& mediaIds ) const override;
         virtual MediaPtr addMedia( const std::string& mrl ) override;
         virtual std::vector<MediaPtr> audioFiles( SortingCriteria sort, bool desc) const override;
         virtual std::vector<MediaPtr> videoFiles( SortingCriteria sort, bool desc) const override;
+        virtual Page<IMedia> audioFiles( uint32_t nbItems, const std::string& after,
+                                         SortingCriteria sort, bool desc ) const override;
+        virtual Page<IMedia> videoFiles( uint32_t nbItems, const std::string& after,
+                                         SortingCriteria sort, bool desc ) const override;
 
         std::shared_ptr<Media> addFile( std::shared_ptr<fs::IFile> fileFs,
                                         std::shared_ptr<Folder> parentFolder,
@@ -82,6 +89,8 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
                                         std::shared_ptr<Folder> parentFolder,
                                         std::shared_ptr<fs::IDirectory> parentFolderFs,
                                         std::pair<std::shared_ptr<Playlist>, unsigned int> parentPlaylist );
+        // Blocks the discoverer while the parser backlog is too large
+        void waitForParserBacklog();
 
         bool deleteFolder(const Folder& folder );
 
@@ -91,8 +100,12 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         virtual AlbumPtr album( int64_t id ) const override;
         std::shared_ptr<Album> createAlbum( const std::string& title, const std::string& artworkMrl );
         virtual std::vector<AlbumPtr> albums(SortingCriteria sort, bool desc) const override;
+        virtual Page<IAlbum> albums( uint32_t nbItems, const std::string& after,
+                                     SortingCriteria sort, bool desc ) const override;
 
         virtual std::vector<GenrePtr> genres( SortingCriteria sort, bool desc ) const override;
+        virtual Page<IGenre> genres( uint32_t nbItems, const std::string& after,
+                                     SortingCriteria sort, bool desc ) const override;
         virtual GenrePtr genre( int64_t id ) const override;
 
         virtual ShowPtr show( const std::string& name ) const override;
@@ -105,9 +118,13 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         ArtistPtr artist( const std::string& name );
         std::shared_ptr<Artist> createArtist( const std::string& name );
         virtual std::vector<ArtistPtr> artists( SortingCriteria sort, bool desc ) const override;
+        virtual Page<IArtist> artists( uint32_t nbItems, const std::string& after,
+                                       SortingCriteria sort, bool desc ) const override;
 
         virtual PlaylistPtr createPlaylist( const std::string& name ) override;
         virtual std::vector<PlaylistPtr> playlists( SortingCriteria sort, bool desc ) override;
+        virtual Page<IPlaylist> playlists( uint32_t nbItems, const std::string& after,
+                                           SortingCriteria sort, bool desc ) override;
         virtual PlaylistPtr playlist( int64_t id ) const override;
         virtual bool deletePlaylist( int64_t playlistId ) override;
 
@@ -122,6 +139,10 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         virtual std::vector<GenrePtr> searchGenre( const std::string& genre ) const override;
         virtual std::vector<ArtistPtr> searchArtists( const std::string& name ) const override;
         virtual SearchAggregate search( const std::string& pattern ) const override;
+        virtual SearchAggregate search( const std::string& pattern, uint32_t nbResults ) const override;
+        virtual SearchAggregate fuzzySearch( const std::string& pattern, uint32_t nbResults ) const override;
+        virtual std::unique_ptr<IMediaSearchSession> createMediaSearchSession() const override;
+        static bool validateSearchPattern( const std::string& pattern );
 
         virtual void discover( const std::string& entryPoint ) override;
         virtual void setDiscoverNetworkEnabled( bool enabled ) override;
@@ -145,6 +166,7 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         sqlite::Connection* getConn() const;
         IMediaLibraryCb* getCb() const;
         std::shared_ptr<ModificationNotifier> getNotifier() const;
+        ResolutionCache& getResolutionCache() const;
 
         virtual IDeviceListerCb* setDeviceLister( DeviceListerPtr lister ) override;
         std::shared_ptr<factory::IFileSystem> fsFactoryForMrl( const std::string& path ) const;
@@ -153,6 +175,17 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
 
         virtual void forceRescan() override;
 
+        virtual std::vector<QueryStats> queryStats() const override;
+        virtual void resetQueryStats() override;
+        virtual ParserStats parserStats() const override;
+        virtual void resetParserStats() override;
+        virtual void setMaxCachedEntities( uint32_t nbEntities ) override;
+        virtual void setMetadataExtractionConcurrency( uint8_t nbMedia ) override;
+        virtual void setThumbnailerConcurrency( uint8_t nbThumbnails ) override;
+        virtual void prioritize( int64_t mediaId ) override;
+        virtual void prioritize( const std::string& mrl ) override;
+        virtual void setMaxParserBacklog( uint32_t nbFiles ) override;
+
         static bool isExtensionSupported( const char* ext );
 
     protected:
@@ -170,9 +203,10 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         bool migrateModel3to5();
         bool migrateModel5to6();
         bool migrateModel6to7();
+        bool migrateModel8to9();
         void createAllTables();
         void registerEntityHooks();
-        static bool validateSearchPattern( const std::string& pattern );
+        void prioritizeRequested( int64_t mediaId ) const;
         // Returns true if the device actually changed
         bool onDeviceChanged( factory::IFileSystem& fsFactory, Device& device );
 
@@ -192,6 +226,8 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         std::string m_thumbnailPath;
         IMediaLibraryCb* m_callback;
         DeviceListerPtr m_deviceLister;
+        std::unique_ptr<FuzzyIndex> m_fuzzyIndex;
+        std::unique_ptr<ResolutionCache> m_resolutionCache;
 
         // Keep the parser as last field.
         // The parser holds a (raw) pointer to the media library. When MediaLibrary's destructor gets called
@@ -204,6 +240,9 @@ class MediaLibrary : public IMediaLibrary, public IDeviceListerCb
         std::unique_ptr<DiscovererWorker> m_discovererWorker;
         std::shared_ptr<ModificationNotifier> m_modificationNotifier;
         LogLevel m_verbosity;
+        uint8_t m_metadataExtractionConcurrency;
+        uint8_t m_thumbnailerConcurrency;
+        uint32_t m_maxParserBacklog;
         Settings m_settings;
         bool m_initialized;
         std::atomic_bool m_discovererIdle;
@@ -0,0 +1,106 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "MediaSearchSession.h"
+
+#include "Media.h"
+#include "MediaLibrary.h"
+#include "database/SqliteTools.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace medialibrary
+{
+
+MediaSearchSession::MediaSearchSession( MediaLibraryPtr ml )
+    : m_ml( ml )
+{
+}
+
+MediaSearchAggregate MediaSearchSession::searchMedia( const std::string& pattern )
+{
+    if ( MediaLibrary::validateSearchPattern( pattern ) == false )
+    {
+        m_words.clear();
+        m_results.clear();
+        return {};
+    }
+    auto words = sqlite::Tools::patternWords( pattern );
+    if ( refines( words ) == true )
+    {
+        // The new results are a subset of the previous ones: only check
+        // those against the index, and reuse the already loaded instances
+        std::vector<int64_t> ids;
+        ids.reserve( m_results.size() );
+        for ( const auto& m : m_results )
+            ids.push_back( m->id() );
+        auto matchingIds = Media::searchIn( m_ml, sqlite::Tools::sanitizePattern( words ), ids );
+        std::unordered_set<int64_t> matching( begin( matchingIds ), end( matchingIds ) );
+        m_results.erase( std::remove_if( begin( m_results ), end( m_results ),
+                                         [&matching]( const MediaPtr& m ) {
+            return matching.count( m->id() ) == 0;
+        }), end( m_results ) );
+    }
+    else
+        m_results = Media::search( m_ml, pattern );
+    m_words = std::move( words );
+
+    MediaSearchAggregate res;
+    for ( const auto& m : m_results )
+    {
+        switch ( m->subType() )
+        {
+        case IMedia::SubType::AlbumTrack:
+            res.tracks.push_back( m );
+            break;
+        case IMedia::SubType::Movie:
+            res.movies.push_back( m );
+            break;
+        case IMedia::SubType::ShowEpisode:
+            res.episodes.push_back( m );
+            break;
+        default:
+            res.others.push_back( m );
+            break;
+        }
+    }
+    return res;
+}
+
+bool MediaSearchSession::refines( const std::vector<std::string>& words ) const
+{
+    if ( m_words.empty() == true || words.size() < m_words.size() )
+        return false;
+    for ( auto i = 0u; i < m_words.size(); ++i )
+    {
+        if ( words[i].compare( 0, m_words[i].size(), m_words[i] ) != 0 )
+            return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,48 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include "medialibrary/IMediaLibrary.h"
+#include "Types.h"
+
+namespace medialibrary
+{
+
+class MediaSearchSession : public IMediaSearchSession
+{
+public:
+    explicit MediaSearchSession( MediaLibraryPtr ml );
+    virtual MediaSearchAggregate searchMedia( const std::string& pattern ) override;
+
+private:
+    bool refines( const std::vector<std::string>& words ) const;
+
+private:
+    MediaLibraryPtr m_ml;
+    // The words of the previous pattern, or an empty vector if the next
+    // search can't reuse the previous results
+    std::vector<std::string> m_words;
+    std::vector<MediaPtr> m_results;
+};
+
+}
@@ -42,7 +42,7 @@ struct MovieTable
 };
 }
 
-class Movie : public IMovie, public DatabaseHelpers<Movie, policy::MovieTable>
+class Movie : public IMovie, public DatabaseHelpers<Movie, policy::MovieTable, cachepolicy::Bounded<Movie>>
 {
     public:
         Movie( MediaLibraryPtr ml, sqlite::Row& row );
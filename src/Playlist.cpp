@@ -200,8 +200,10 @@ void Playlist::createTable( sqlite::Connection* dbConn )
                 + policy::PlaylistTable::PrimaryKeyColumn + ") ON DELETE CASCADE"
         ")";
     const std::string vtableReq = "CREATE VIRTUAL TABLE IF NOT EXISTS "
-                + policy::PlaylistTable::Name + "Fts USING FTS3("
-                "name"
+                + policy::PlaylistTable::Name + "Fts USING FTS5("
+                "name,"
+                "prefix = '2 3',"
+                "tokenize = 'unicode61 remove_diacritics 1'"
             ")";
     //FIXME Enforce (playlist_id,position) uniqueness
     sqlite::Tools::executeRequest( dbConn, req );
@@ -263,8 +265,9 @@ void Playlist::createTriggers( sqlite::Connection* dbConn )
 std::vector<PlaylistPtr> Playlist::search( MediaLibraryPtr ml, const std::string& name )
 {
     static const std::string req = "SELECT * FROM " + policy::PlaylistTable::Name + " WHERE id_playlist IN "
-            "(SELECT rowid FROM " + policy::PlaylistTable::Name + "Fts WHERE name MATCH '*' || ? || '*')";
-    return fetchAll<IPlaylist>( ml, req, name );
+            "(SELECT rowid FROM " + policy::PlaylistTable::Name + "Fts WHERE " +
+            policy::PlaylistTable::Name + "Fts MATCH ?)";
+    return fetchAll<IPlaylist>( ml, req, sqlite::Tools::sanitizePattern( name ) );
 }
 
 std::vector<PlaylistPtr> Playlist::listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc )
@@ -284,4 +287,22 @@ std::vector<PlaylistPtr> Playlist::listAll( MediaLibraryPtr ml, SortingCriteria
     return fetchAll<IPlaylist>( ml, req );
 }
 
+Page<IPlaylist> Playlist::listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                                    uint32_t nbItems, const std::string& after )
+{
+    std::vector<sqlite::Keyset::Term> terms;
+    switch ( sort )
+    {
+    case SortingCriteria::InsertionDate:
+        terms.emplace_back( "creation_date", true, desc );
+        break;
+    default:
+        terms.emplace_back( "IFNULL(name, '')", false, desc );
+        break;
+    }
+    sqlite::Keyset keyset( sort, desc, std::move( terms ), "id_playlist", sqlite::Keyset::Filter::Where );
+    auto req = "SELECT *" + keyset.columns() + " FROM " + policy::PlaylistTable::Name;
+    return fetchPage<IPlaylist>( ml, keyset, nbItems, after, req );
+}
+
 }
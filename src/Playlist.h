@@ -71,6 +71,8 @@ public:
     static void createTriggers( sqlite::Connection* dbConn );
     static std::vector<PlaylistPtr> search( MediaLibraryPtr ml, const std::string& name );
     static std::vector<PlaylistPtr> listAll( MediaLibraryPtr ml, SortingCriteria sort, bool desc );
+    static Page<IPlaylist> listPage( MediaLibraryPtr ml, SortingCriteria sort, bool desc,
+                                     uint32_t nbItems, const std::string& after );
 
 private:
     MediaLibraryPtr m_ml;
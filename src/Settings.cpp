@@ -32,7 +32,7 @@
 namespace medialibrary
 {
 
-const uint32_t Settings::DbModelVersion = 8u;
+const uint32_t Settings::DbModelVersion = 9u;
 
 Settings::Settings( MediaLibrary* ml )
     : m_ml( ml )
@@ -43,7 +43,7 @@ Settings::Settings( MediaLibrary* ml )
 
 bool Settings::load()
 {
-    sqlite::Statement s( m_ml->getConn()->handle(), "SELECT * FROM Settings" );
+    sqlite::Statement s( m_ml->getConn(), "SELECT * FROM Settings" );
     auto row = s.row();
     // First launch: no settings
     if ( row == nullptr )
@@ -46,7 +46,7 @@ struct ShowEpisodeTable
 };
 }
 
-class ShowEpisode : public IShowEpisode, public DatabaseHelpers<ShowEpisode, policy::ShowEpisodeTable>
+class ShowEpisode : public IShowEpisode, public DatabaseHelpers<ShowEpisode, policy::ShowEpisodeTable, cachepolicy::Bounded<ShowEpisode>>
 {
     public:
         ShowEpisode( MediaLibraryPtr ml, sqlite::Row& row );
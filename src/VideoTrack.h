@@ -43,7 +43,7 @@ struct VideoTrackTable
 };
 }
 
-class VideoTrack : public IVideoTrack, public DatabaseHelpers<VideoTrack, policy::VideoTrackTable>
+class VideoTrack : public IVideoTrack, public DatabaseHelpers<VideoTrack, policy::VideoTrackTable, cachepolicy::Bounded<VideoTrack>>
 {
     public:
         VideoTrack( MediaLibraryPtr, sqlite::Row& row );
@@ -22,6 +22,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <list>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -36,27 +40,44 @@ namespace medialibrary
 namespace cachepolicy
 {
 
+/*
+ * The caches are split in stripes, each of them being protected by its own
+ * mutex, so that threads hydrating different records don't wait for each
+ * other. Since primary keys are mostly sequential, records are evenly spread
+ * across the stripes by using the key modulo the number of stripes.
+ */
+static constexpr size_t NbStripes = 16;
+
+inline size_t stripeIndex( int64_t key )
+{
+    return static_cast<uint64_t>( key ) % NbStripes;
+}
+
 template <typename T>
 struct Cached
 {
 private:
     using Lock = std::unique_lock<compat::Mutex>;
-    static std::unordered_map<int64_t, std::shared_ptr<T>> Store;
-    static compat::Mutex Mutex;
+    struct Stripe
+    {
+        std::unordered_map<int64_t, std::shared_ptr<T>> store;
+        compat::Mutex mutex;
+    };
+    static std::array<Stripe, NbStripes> Stripes;
 
 public:
-    static Lock lock()
+    static Lock lock( int64_t key )
     {
-        return Lock{ Mutex };
+        return Lock{ Stripes[stripeIndex( key )].mutex };
     }
 
     static void insert( int64_t key, std::shared_ptr<T> value )
     {
-        assert( Store.find( key ) == end( Store ) );
+        assert( load( key ) == nullptr );
         if ( sqlite::Transaction::transactionInProgress() == true )
         {
             sqlite::Transaction::onCurrentTransactionFailure( [key](){
-                auto l = lock();
+                auto l = lock( key );
                 auto removed = remove( key );
                 assert( removed != nullptr );
             });
@@ -66,41 +87,226 @@ public:
 
     static void save( int64_t key, std::shared_ptr<T> value )
     {
-        Store[key] = std::move( value );
+        Stripes[stripeIndex( key )].store[key] = std::move( value );
     }
 
     static std::shared_ptr<T> remove( int64_t key )
     {
-        auto it = Store.find( key );
-        if ( it != end( Store ) )
+        auto& store = Stripes[stripeIndex( key )].store;
+        auto it = store.find( key );
+        if ( it != end( store ) )
         {
             auto value = std::move( it->second );
-            Store.erase( it );
+            store.erase( it );
             return value;
         }
         return nullptr;
     }
 
+    /*
+     * Unlike the other functions, this locks the stripes by itself
+     */
     static void clear()
     {
-        Store.clear();
+        for ( auto& s : Stripes )
+        {
+            Lock l{ s.mutex };
+            s.store.clear();
+        }
     }
 
     static std::shared_ptr<T> load( int64_t key )
     {
-        auto it = Store.find( key );
-        if ( it == Store.end() )
+        auto& store = Stripes[stripeIndex( key )].store;
+        auto it = store.find( key );
+        if ( it == store.end() )
             return nullptr;
         return it->second;
     }
 };
 
 template <typename T>
-std::unordered_map<int64_t, std::shared_ptr<T>>
-Cached<T>::Store;
+std::array<typename Cached<T>::Stripe, NbStripes> Cached<T>::Stripes;
+
+/*
+ * Keeps at most MaxSize entities alive, and evicts the least recently used
+ * ones. Evicted entities are still referenced weakly, so that an entity which
+ * is still held by the application keeps being returned, instead of having a
+ * second instance loaded for the same record.
+ * Each stripe has its own recently used list, and gets an equal share of the
+ * budget.
+ */
+template <typename T>
+struct Bounded
+{
+private:
+    using Lock = std::unique_lock<compat::Mutex>;
+    // Most recently used entities first
+    using LRU = std::list<std::pair<int64_t, std::shared_ptr<T>>>;
+    struct Entry
+    {
+        Entry() : isRecent( false ) {}
+
+        std::weak_ptr<T> value;
+        typename LRU::iterator recentIt;
+        bool isRecent;
+    };
+    struct Stripe
+    {
+        Stripe() : nextSweep( DefaultMaxSize / NbStripes ) {}
+
+        std::unordered_map<int64_t, Entry> store;
+        LRU recent;
+        size_t nextSweep;
+        compat::Mutex mutex;
+    };
+    static std::array<Stripe, NbStripes> Stripes;
+    static std::atomic<size_t> MaxSize;
+
+public:
+    static constexpr size_t DefaultMaxSize = 10000;
+
+    static Lock lock( int64_t key )
+    {
+        return Lock{ Stripes[stripeIndex( key )].mutex };
+    }
+
+    static void setMaxSize( size_t maxSize )
+    {
+        MaxSize = maxSize;
+        for ( auto& s : Stripes )
+        {
+            Lock l{ s.mutex };
+            evict( s );
+        }
+    }
+
+    static void insert( int64_t key, std::shared_ptr<T> value )
+    {
+        assert( load( key ) == nullptr );
+        if ( sqlite::Transaction::transactionInProgress() == true )
+        {
+            // The entity might have been evicted already, so don't assume we
+            // will find it
+            sqlite::Transaction::onCurrentTransactionFailure( [key](){
+                auto l = lock( key );
+                remove( key );
+            });
+        }
+        save( key, std::move( value ) );
+    }
+
+    static void save( int64_t key, std::shared_ptr<T> value )
+    {
+        auto& s = Stripes[stripeIndex( key )];
+        auto& entry = s.store[key];
+        if ( entry.isRecent == true )
+        {
+            s.recent.erase( entry.recentIt );
+            entry.isRecent = false;
+        }
+        entry.value = value;
+        touch( s, key, entry, std::move( value ) );
+        if ( s.store.size() >= s.nextSweep )
+            sweep( s );
+    }
+
+    static std::shared_ptr<T> remove( int64_t key )
+    {
+        auto& s = Stripes[stripeIndex( key )];
+        auto it = s.store.find( key );
+        if ( it == end( s.store ) )
+            return nullptr;
+        auto value = it->second.value.lock();
+        if ( it->second.isRecent == true )
+            s.recent.erase( it->second.recentIt );
+        s.store.erase( it );
+        return value;
+    }
+
+    /*
+     * Unlike the other functions, this locks the stripes by itself
+     */
+    static void clear()
+    {
+        for ( auto& s : Stripes )
+        {
+            Lock l{ s.mutex };
+            s.recent.clear();
+            s.store.clear();
+            s.nextSweep = DefaultMaxSize / NbStripes;
+        }
+    }
+
+    static std::shared_ptr<T> load( int64_t key )
+    {
+        auto& s = Stripes[stripeIndex( key )];
+        auto it = s.store.find( key );
+        if ( it == end( s.store ) )
+            return nullptr;
+        auto value = it->second.value.lock();
+        if ( value == nullptr )
+        {
+            // Evicted, and released by the application as well
+            s.store.erase( it );
+            return nullptr;
+        }
+        touch( s, key, it->second, value );
+        return value;
+    }
+
+private:
+    static void touch( Stripe& s, int64_t key, Entry& entry, std::shared_ptr<T> value )
+    {
+        if ( entry.isRecent == true )
+        {
+            s.recent.splice( begin( s.recent ), s.recent, entry.recentIt );
+            return;
+        }
+        s.recent.emplace_front( key, std::move( value ) );
+        entry.recentIt = begin( s.recent );
+        entry.isRecent = true;
+        evict( s );
+    }
+
+    static void evict( Stripe& s )
+    {
+        auto maxSize = ( MaxSize.load( std::memory_order_relaxed ) + NbStripes - 1 ) / NbStripes;
+        while ( s.recent.size() > maxSize )
+        {
+            auto it = s.store.find( s.recent.back().first );
+            assert( it != end( s.store ) );
+            it->second.isRecent = false;
+            s.recent.pop_back();
+        }
+    }
+
+    /*
+     * Drops the entries of the evicted entities that were released by the
+     * application. This is only done once the stripe doubled in size since the
+     * last sweep, so that its cost is amortized over the insertions.
+     */
+    static void sweep( Stripe& s )
+    {
+        for ( auto it = begin( s.store ); it != end( s.store ); )
+        {
+            if ( it->second.isRecent == false && it->second.value.expired() == true )
+                it = s.store.erase( it );
+            else
+                ++it;
+        }
+        s.nextSweep = std::max( s.store.size() * 2, DefaultMaxSize / NbStripes );
+    }
+};
+
+template <typename T>
+std::array<typename Bounded<T>::Stripe, NbStripes> Bounded<T>::Stripes;
 
 template <typename T>
-compat::Mutex Cached<T>::Mutex;
+constexpr size_t Bounded<T>::DefaultMaxSize;
+
+template <typename T>
+std::atomic<size_t> Bounded<T>::MaxSize{ Bounded<T>::DefaultMaxSize };
 
 template <typename T>
 struct Uncached
@@ -113,7 +319,7 @@ private:
     };
 
 public:
-    static FakeLock lock() { return FakeLock{}; }
+    static FakeLock lock( int64_t ) { return FakeLock{}; }
     static void insert( int64_t, std::shared_ptr<T> ) {}
     static void save( int64_t, std::shared_ptr<T> ) {}
     static std::shared_ptr<T> remove( int64_t ) { return nullptr; }
@@ -159,6 +365,59 @@ class DatabaseHelpers
             return {};
         }
 
+        /*
+         * Fetches the elements with the provided primary keys, in the same
+         * order. Elements that are already cached are returned without
+         * querying the database, and the others are fetched in a single request.
+         * Unknown keys are ignored.
+         */
+        template <typename INTF = IMPL>
+        static std::vector<std::shared_ptr<INTF>> fetchMany( MediaLibraryPtr ml,
+                                                             const std::vector<int64_t>& pkValues )
+        {
+            static const std::string req = "SELECT * FROM " + TABLEPOLICY::Name + " WHERE " +
+                    TABLEPOLICY::PrimaryKeyColumn + " IN";
+            std::unordered_map<int64_t, std::shared_ptr<IMPL>> entities;
+            entities.reserve( pkValues.size() );
+            std::vector<int64_t> misses;
+            for ( auto pk : pkValues )
+            {
+                auto it = entities.emplace( pk, nullptr );
+                if ( it.second == false )
+                    continue;
+                {
+                    auto l = CACHEPOLICY::lock( pk );
+                    it.first->second = CACHEPOLICY::load( pk );
+                }
+                if ( it.first->second == nullptr )
+                    misses.push_back( pk );
+            }
+            try
+            {
+                for ( auto& e : sqlite::Tools::fetchAllIn<IMPL, IMPL>( ml, req, misses ) )
+                {
+                    auto pk = e.get()->*TABLEPOLICY::PrimaryKey;
+                    entities[pk] = std::move( e );
+                }
+            }
+            catch ( const sqlite::errors::GenericExecution& ex )
+            {
+                if ( sqlite::errors::isInnocuous( ex ) == false )
+                    throw;
+                LOG_WARN( "Ignoring innocuous error: ", ex.what() );
+                return {};
+            }
+            std::vector<std::shared_ptr<INTF>> res;
+            res.reserve( pkValues.size() );
+            for ( auto pk : pkValues )
+            {
+                auto& e = entities[pk];
+                if ( e != nullptr )
+                    res.push_back( e );
+            }
+            return res;
+        }
+
         /*
          * Will fetch all elements from the database & cache them.
          */
@@ -195,16 +454,55 @@ class DatabaseHelpers
             return {};
         }
 
-        static std::shared_ptr<IMPL> load( MediaLibraryPtr ml, sqlite::Row& row )
+        /*
+         * Returns a cursor that will fetch & cache the elements while it's
+         * being iterated over.
+         */
+        template <typename INTF, typename... Args>
+        static sqlite::Cursor<IMPL, INTF> fetchCursor( MediaLibraryPtr ml, const std::string& req, Args&&... args )
         {
-            auto l = CACHEPOLICY::lock();
+            return sqlite::Tools::fetchCursor<IMPL, INTF>( ml, req, std::forward<Args>( args )... );
+        }
+
+        template <typename INTF, typename... Args>
+        static Page<INTF> fetchPage( MediaLibraryPtr ml, const sqlite::Keyset& keyset, uint32_t nbItems,
+                                     const std::string& after, const std::string& req, Args&&... args )
+        {
+            try
+            {
+                return sqlite::Tools::fetchPage<IMPL, INTF>( ml, keyset, nbItems, after, req,
+                                                             std::forward<Args>( args )... );
+            }
+            catch ( const sqlite::errors::GenericExecution& ex )
+            {
+                if ( sqlite::errors::isInnocuous( ex ) == false )
+                    throw;
+                LOG_WARN( "Ignoring innocuous error: ", ex.what() );
+            }
+            return {};
+        }
 
+        static std::shared_ptr<IMPL> load( MediaLibraryPtr ml, sqlite::Row& row )
+        {
             auto key = row.load<int64_t>( 0 );
-            auto res = CACHEPOLICY::load( key );
-            if ( res != nullptr )
-                return res;
-            res = std::make_shared<IMPL>( ml, row );
-            CACHEPOLICY::save( key, res );
+            {
+                auto l = CACHEPOLICY::lock( key );
+                auto res = CACHEPOLICY::load( key );
+                if ( res != nullptr )
+                    return res;
+            }
+            // Don't hold the stripe while hydrating
+            auto res = std::make_shared<IMPL>( ml, row );
+            auto l = CACHEPOLICY::lock( key );
+            // Another thread might have loaded the same record in the meantime
+            auto cached = CACHEPOLICY::load( key );
+            if ( cached != nullptr )
+                return cached;
+            // The record might have been read from a snapshot older than a
+            // change which evicted it already. It is then only returned to
+            // the caller, and will be loaded again next time.
+            if ( ml->getConn()->isCacheable( row.cacheGeneration() ) == true )
+                CACHEPOLICY::save( key, res );
             return res;
         }
 
@@ -222,11 +520,12 @@ class DatabaseHelpers
         }
 
         /**
-         * @warning removeFromCache is only meant to be called from an SQLite hook
+         * @warning removeFromCache is only meant to be called from an SQLite hook,
+         *          or to evict an instance holding changes that were rolled back
          */
         static void removeFromCache( int64_t pkValue )
         {
-            auto l = CACHEPOLICY::lock();
+            auto l = CACHEPOLICY::lock( pkValue );
 
             auto removed = CACHEPOLICY::remove( pkValue );
             if ( removed != nullptr )
@@ -235,8 +534,6 @@ class DatabaseHelpers
 
         static void clear()
         {
-            auto l = CACHEPOLICY::lock();
-
             CACHEPOLICY::clear();
         }
 
@@ -251,11 +548,41 @@ class DatabaseHelpers
             if ( pKey == 0 )
                 return false;
             (self.get())->*TABLEPOLICY::PrimaryKey = pKey;
-            auto l = CACHEPOLICY::lock();
+            auto l = CACHEPOLICY::lock( pKey );
             CACHEPOLICY::insert( pKey, self );
             return true;
         }
 
+        /*
+         * Create multiple instances of the cache class at once, using multi-row
+         * insertions.
+         * bindRow is invoked with the statement and each instance, and must
+         * bind its values using sqlite::Statement::bind
+         */
+        template <typename Binder>
+        static bool insertBatch( MediaLibraryPtr ml, const std::vector<std::shared_ptr<IMPL>>& selves,
+                                 const std::string& req, const std::string& rowPlaceholders,
+                                 unsigned int nbParams, Binder bindRow )
+        {
+            if ( selves.empty() == true )
+                return true;
+            auto t = ml->getConn()->newTransaction();
+            auto keys = sqlite::Tools::executeInsertBatch( ml->getConn(), req, rowPlaceholders,
+                    nbParams, selves.size(), [&selves, &bindRow]( sqlite::Statement& s, size_t i ) {
+                bindRow( s, *selves[i] );
+            });
+            if ( keys.size() != selves.size() )
+                return false;
+            t->commit();
+            for ( auto i = 0u; i < selves.size(); ++i )
+            {
+                (selves[i].get())->*TABLEPOLICY::PrimaryKey = keys[i];
+                auto l = CACHEPOLICY::lock( keys[i] );
+                CACHEPOLICY::insert( keys[i], selves[i] );
+            }
+            return true;
+        }
+
 
     protected:
         DatabaseHelpers() : m_deleted( false ) {}
@@ -33,10 +33,35 @@ namespace medialibrary
 namespace sqlite
 {
 
+namespace
+{
+// The context last used by the current thread. Most threads only ever use a
+// single connection, which spares the connections map lookup & its lock.
+struct CachedThreadContext
+{
+    uint64_t connId;
+    Connection::ThreadContext* ctx;
+};
+
+thread_local CachedThreadContext CurrentContext = { 0, nullptr };
+}
+
+std::atomic<uint64_t> Connection::NextId( 1 );
+constexpr uint64_t Connection::AlwaysCacheable;
+
+Connection::ThreadContext::ThreadContext( Handle h )
+    : handle( h, &sqlite3_close )
+    , pendingLockWait( QueryProfiler::Clock::duration::zero() )
+{
+}
+
 Connection::Connection( const std::string& dbPath )
     : m_dbPath( dbPath )
+    , m_id( NextId.fetch_add( 1 ) )
     , m_readLock( m_contextLock )
-    , m_writeLock( m_contextLock )
+    , m_writeLock( *this )
+    , m_walEnabled( false )
+    , m_cacheGeneration( 0 )
 {
     if ( sqlite3_threadsafe() == 0 )
         throw std::runtime_error( "SQLite isn't built with threadsafe mode" );
@@ -44,12 +69,14 @@ Connection::Connection( const std::string& dbPath )
         throw std::runtime_error( "Failed to enable sqlite multithreaded mode" );
 }
 
-Connection::~Connection()
+Connection::~Connection() = default;
+
+Connection::Handle Connection::handle()
 {
-    sqlite::Statement::FlushStatementCache();
+    return threadContext().handle.get();
 }
 
-Connection::Handle Connection::handle()
+Connection::ThreadContext& Connection::threadContext()
 {
     /**
      * We need to have a single sqlite connection per thread, but we also need
@@ -66,35 +93,52 @@ Connection::Handle Connection::handle()
      * order to know when a thread gets terminated, we store a thread_local
      * object to signal back when a thread returns, and to remove the now
      * unusable connection.
-     * Also note that we need to flush any potentially cached compiled statement
-     * when a thread gets terminated, as it would become unusable as well.
+     * Each connection comes with its own compiled statements cache, which is
+     * destroyed along with it.
+     * Since this is called for each request, the last used context is also
+     * stored in a thread_local variable, keyed by the connection unique ID, so
+     * that the lock is only taken when a thread uses a connection for the first
+     * time, or alternates between multiple connections.
      *
      * \sa sqlite::Connection::ThreadSpecificConnection::~ThreadSpecificConnection
-     * \sa sqlite::Statement::StatementsCache
+     * \sa sqlite::Connection::ThreadContext
      */
+    if ( CurrentContext.connId == m_id )
+        return *CurrentContext.ctx;
     std::unique_lock<compat::Mutex> lock( m_connMutex );
-    sqlite3* dbConnection;
+    ThreadContext* ctx;
     auto it = m_conns.find( compat::this_thread::get_id() );
     if ( it == end( m_conns ) )
-    {
-        auto res = sqlite3_open( m_dbPath.c_str(), &dbConnection );
-        ConnPtr dbConn( dbConnection, &sqlite3_close );
-        if ( res != SQLITE_OK )
-            throw sqlite::errors::Generic( std::string( "Failed to connect to database: " )
-                                           + sqlite3_errstr( res ) );
-        sqlite3_extended_result_codes( dbConnection, 1 );
-        sqlite3_busy_timeout( dbConnection, 500 );
-        // Don't use public wrapper, they need to be able to call getConn, which
-        // would result from a recursive call and a deadlock from here.
-        setPragmaEnabled( dbConnection, "foreign_keys", true );
-        setPragmaEnabled( dbConnection, "recursive_triggers", true );
-
-        m_conns.emplace( compat::this_thread::get_id(), std::move( dbConn ) );
-        sqlite3_update_hook( dbConnection, &updateHook, this );
-        static thread_local ThreadSpecificConnection tsc( shared_from_this() );
-        return dbConnection;
-    }
-    return it->second.get();
+        ctx = &createThreadContext();
+    else
+        ctx = it->second.get();
+    CurrentContext = { m_id, ctx };
+    return *ctx;
+}
+
+Connection::ThreadContext& Connection::createThreadContext()
+{
+    sqlite3* dbConnection;
+    auto res = sqlite3_open( m_dbPath.c_str(), &dbConnection );
+    std::unique_ptr<ThreadContext> ctx( new ThreadContext( dbConnection ) );
+    if ( res != SQLITE_OK )
+        throw sqlite::errors::Generic( std::string( "Failed to connect to database: " )
+                                       + sqlite3_errstr( res ) );
+    sqlite3_extended_result_codes( dbConnection, 1 );
+    sqlite3_busy_timeout( dbConnection, 500 );
+    // Don't use public wrapper, they need to be able to call getConn, which
+    // would result from a recursive call and a deadlock from here.
+    setPragmaEnabled( dbConnection, "foreign_keys", true );
+    setPragmaEnabled( dbConnection, "recursive_triggers", true );
+    // The journal mode is persistent, so it only needs to be set once
+    if ( m_conns.empty() == true )
+        setWalEnabled( dbConnection );
+
+    auto& threadCtx = *ctx;
+    m_conns.emplace( compat::this_thread::get_id(), std::move( ctx ) );
+    sqlite3_update_hook( dbConnection, &updateHook, this );
+    static thread_local ThreadSpecificConnection tsc( shared_from_this() );
+    return threadCtx;
 }
 
 std::unique_ptr<sqlite::Transaction> Connection::newTransaction()
@@ -104,12 +148,22 @@ std::unique_ptr<sqlite::Transaction> Connection::newTransaction()
 
 Connection::ReadContext Connection::acquireReadContext()
 {
-    return ReadContext{ m_readLock };
+    if ( m_walEnabled == true )
+        return ReadContext{};
+    auto& ctx = threadContext();
+    auto start = QueryProfiler::Clock::now();
+    ReadContext res{ m_readLock };
+    ctx.pendingLockWait += QueryProfiler::Clock::now() - start;
+    return res;
 }
 
 Connection::WriteContext Connection::acquireWriteContext()
 {
-    return WriteContext{ m_writeLock };
+    auto& ctx = threadContext();
+    auto start = QueryProfiler::Clock::now();
+    WriteContext res{ m_writeLock };
+    ctx.pendingLockWait += QueryProfiler::Clock::now() - start;
+    return res;
 }
 
 void Connection::setPragmaEnabled( Handle conn,
@@ -133,6 +187,70 @@ void Connection::setPragmaEnabled( Handle conn,
         throw std::runtime_error( "PRAGMA " + pragmaName + " value mismatch" );
 }
 
+void Connection::setWalEnabled( Handle conn )
+{
+    // Enabling WAL can fail if another process uses the database, or if the
+    // filesystem doesn't support shared memory. We then fallback to the
+    // default rollback journal, which requires readers to wait for writers.
+    try
+    {
+        sqlite::Statement stmt( conn, "PRAGMA journal_mode = WAL" );
+        stmt.execute();
+        auto row = stmt.row();
+        std::string mode;
+        row >> mode;
+        m_walEnabled = mode == "wal";
+    }
+    catch ( const sqlite::errors::Generic& ex )
+    {
+        LOG_WARN( "Failed to enable WAL journal mode: ", ex.what() );
+    }
+    if ( m_walEnabled == false )
+        LOG_WARN( "WAL journal mode is not available, readers will wait for writers" );
+}
+
+bool Connection::isWalEnabled() const
+{
+    return m_walEnabled;
+}
+
+void Connection::checkpoint()
+{
+    if ( m_walEnabled == false )
+        return;
+    // Use a passive checkpoint, which never waits for readers or writers: this
+    // is invoked from the background workers, which mustn't be stalled. Frames
+    // which can't be checkpointed now will be by the next checkpoint.
+    int nbFrames;
+    int nbCheckpointed;
+    auto res = sqlite3_wal_checkpoint_v2( handle(), nullptr, SQLITE_CHECKPOINT_PASSIVE,
+                                          &nbFrames, &nbCheckpointed );
+    if ( res != SQLITE_OK )
+        LOG_WARN( "Failed to checkpoint the database: ", sqlite3_errstr( res ) );
+    else
+        LOG_DEBUG( "Checkpointed ", nbCheckpointed, '/', nbFrames, " WAL frames" );
+}
+
+uint64_t Connection::cacheGeneration() const
+{
+    return m_cacheGeneration.load( std::memory_order_acquire );
+}
+
+bool Connection::isCacheable( uint64_t readGeneration ) const
+{
+    if ( readGeneration == AlwaysCacheable )
+        return true;
+    // The generation is checked while holding the cache stripe lock, which
+    // the hooks take after bumping it, so either the evicting write is
+    // noticed here, or the record gets inserted before being evicted
+    return readGeneration % 2 == 0 && readGeneration == cacheGeneration();
+}
+
+QueryProfiler& Connection::profiler()
+{
+    return m_profiler;
+}
+
 void Connection::setForeignKeyEnabled( bool value )
 {
     // Ensure no transaction will be started during the pragma change
@@ -154,10 +272,10 @@ void Connection::setRecursiveTriggersEnabled( bool value )
     // using the legacy sqlite3_prepare() interface may fail with an
     // SQLITE_SCHEMA error after the recursive_triggers setting is changed.
     // https://sqlite.org/pragma.html#pragma_recursive_triggers
-    auto h = handle();
-    sqlite::Statement::FlushConnectionStatementCache( h );
+    auto& threadCtx = threadContext();
+    threadCtx.statements.clear();
 
-    setPragmaEnabled( h, "recursive_triggers", value );
+    setPragmaEnabled( threadCtx.handle.get(), "recursive_triggers", value );
 }
 
 void Connection::registerUpdateHook( const std::string& table, Connection::UpdateHookCb cb )
@@ -182,6 +300,12 @@ void Connection::updateHook( void* data, int reason, const char*,
     auto it = self->m_hooks.find( table );
     if ( it == end( self->m_hooks ) )
         return;
+    // The hooks run from the writer, which holds the write context. Insertions
+    // are accounted for as well, since the records they flag (ie. in the
+    // fuzzy index) can't be read back by the readers until they are committed
+    auto gen = self->m_cacheGeneration.load( std::memory_order_relaxed );
+    if ( gen % 2 == 0 )
+        self->m_cacheGeneration.store( gen + 1, std::memory_order_release );
     switch ( reason )
     {
     case SQLITE_INSERT:
@@ -196,6 +320,27 @@ void Connection::updateHook( void* data, int reason, const char*,
     }
 }
 
+Connection::WriteLocker::WriteLocker( Connection& conn )
+    : m_conn( conn )
+    , m_lock( conn.m_contextLock )
+{
+}
+
+void Connection::WriteLocker::lock()
+{
+    m_lock.lock();
+}
+
+void Connection::WriteLocker::unlock()
+{
+    // The changes which evicted cached records are now either committed or
+    // rolled back, so the records can be cached again
+    auto gen = m_conn.m_cacheGeneration.load( std::memory_order_relaxed );
+    if ( gen % 2 != 0 )
+        m_conn.m_cacheGeneration.store( gen + 1, std::memory_order_release );
+    m_lock.unlock();
+}
+
 Connection::WeakDbContext::WeakDbContext( Connection* conn )
     : m_conn( conn )
 {
@@ -221,11 +366,11 @@ Connection::ThreadSpecificConnection::~ThreadSpecificConnection()
     auto it = m_conn->m_conns.find( compat::this_thread::get_id() );
     if ( it != end( m_conn->m_conns ) )
     {
-        // Ensure those cached statements will not be used if another connection
-        // with the same pointer gets created
-        sqlite::Statement::FlushConnectionStatementCache( it->second.get() );
-        // And ensure we won't use the same connection if a thread with the same
-        // ID gets used in the future.
+        if ( CurrentContext.ctx == it->second.get() )
+            CurrentContext = { 0, nullptr };
+        // Ensure we won't use the same connection if a thread with the same
+        // ID gets used in the future. This also finalizes the statements
+        // compiled for this connection, before closing it.
         m_conn->m_conns.erase( it );
     }
 }
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <sqlite3.h>
@@ -29,6 +31,7 @@
 #include <unordered_map>
 #include <string>
 
+#include "database/SqliteQueryProfiler.h"
 #include "utils/SWMRLock.h"
 #include "compat/Mutex.h"
 #include "compat/Thread.h"
@@ -44,8 +47,24 @@ class Transaction;
 class Connection : public std::enable_shared_from_this<Connection>
 {
 public:
+    /**
+     * @brief The WriteLocker class serializes the writers, and lets the
+     *        readers know once a write which evicted cached records is over.
+     */
+    class WriteLocker
+    {
+    public:
+        WriteLocker( Connection& conn );
+        void lock();
+        void unlock();
+
+    private:
+        Connection& m_conn;
+        utils::WriteLocker m_lock;
+    };
+
     using ReadContext = std::unique_lock<utils::ReadLocker>;
-    using WriteContext = std::unique_lock<utils::WriteLocker>;
+    using WriteContext = std::unique_lock<WriteLocker>;
     using Handle = sqlite3*;
     enum class HookReason
     {
@@ -66,13 +85,89 @@ public:
     };
 
     using UpdateHookCb = std::function<void(HookReason, int64_t)>;
+    using CachedStmtPtr = std::unique_ptr<sqlite3_stmt, int(*)(sqlite3_stmt*)>;
+
+    /**
+     * @brief The ThreadContext struct holds the sqlite connection of a given
+     *        thread, along with the statements compiled for it.
+     *
+     * A context is only ever accessed from the thread that created it, so it
+     * doesn't require any locking. The statements are declared after the
+     * handle, so they are finalized before the connection gets closed.
+     */
+    struct ThreadContext
+    {
+        ThreadContext( Handle h );
+
+        struct CachedStatement
+        {
+            CachedStmtPtr stmt;
+            QueryProfiler::Entry* stats;
+        };
+
+        using ConnPtr = std::unique_ptr<sqlite3, int(*)(sqlite3*)>;
+        ConnPtr handle;
+        std::unordered_map<std::string, CachedStatement> statements;
+        // Time spent waiting for the last acquired context, which is accounted
+        // to the next statement executed on this thread
+        QueryProfiler::Clock::duration pendingLockWait;
+    };
 
     // Returns the current thread's connection
     // This will initiate a connection if required
     Handle handle();
+    // Returns the current thread's context. Same as handle(), this will
+    // initiate a connection if required
+    ThreadContext& threadContext();
     std::unique_ptr<sqlite::Transaction> newTransaction();
+    /**
+     * @brief acquireReadContext Returns a context to run read requests in.
+     *
+     * When the database uses WAL journaling, readers run against a snapshot of
+     * the database and aren't blocked by writers, so the returned context
+     * doesn't hold any lock. Otherwise, this will wait for any pending write
+     * operation (including transactions) to complete.
+     */
     ReadContext acquireReadContext();
     WriteContext acquireWriteContext();
+    /**
+     * @brief isWalEnabled Returns true if the database uses WAL journaling
+     */
+    bool isWalEnabled() const;
+    /**
+     * @brief cacheGeneration Returns the generation to record before reading
+     *        records, in order to check if they can be cached afterward.
+     *
+     * With WAL journaling, a reader can load a record from a snapshot older
+     * than a change that already evicted it from the caches. The generation
+     * is bumped when a write starts modifying the tables with an update hook,
+     * and once again when it is over, so it is odd while such a write is in
+     * progress.
+     */
+    uint64_t cacheGeneration() const;
+    /**
+     * @brief isCacheable Returns true if the records read since the provided
+     *        generation can be inserted in the caches.
+     */
+    bool isCacheable( uint64_t readGeneration ) const;
+    /// A generation for the reads which always see the latest changes, ie.
+    /// the ones performed by the writer, from within its transaction.
+    static constexpr uint64_t AlwaysCacheable = UINT64_MAX;
+    /**
+     * @brief checkpoint Transfers the WAL content back to the database
+     *
+     * This is meant to be invoked when no background operation is running, so
+     * that the WAL doesn't have to be checkpointed while writing. The
+     * checkpoint doesn't wait for active readers, and will be partial if some
+     * readers are still using older frames. This is a no-op when WAL isn't
+     * enabled.
+     */
+    void checkpoint();
+    /**
+     * @brief profiler Returns the statistics collector for the requests run
+     *        on this connection, from any thread.
+     */
+    QueryProfiler& profiler();
     /**
      * @brief setForeignKeyEnabled Enables/disables foreign key for the sqlite
      *        connection for the current thread.
@@ -102,7 +197,9 @@ private:
     Connection& operator=( const Connection& ) = delete;
     Connection& operator=( Connection&& ) = delete;
 
+    ThreadContext& createThreadContext();
     void setPragmaEnabled( Handle conn, const std::string& pragmaName, bool value );
+    void setWalEnabled( Handle conn );
     static void updateHook( void* data, int reason, const char* database,
                             const char* table, sqlite_int64 rowId );
 
@@ -116,14 +213,21 @@ private:
         std::shared_ptr<Connection> m_conn;
     };
 
-    using ConnPtr = std::unique_ptr<sqlite3, int(*)(sqlite3*)>;
     const std::string m_dbPath;
+    // Unique for the whole process lifetime, unlike the instance address
+    const uint64_t m_id;
     compat::Mutex m_connMutex;
-    std::unordered_map<compat::Thread::id, ConnPtr> m_conns;
+    std::unordered_map<compat::Thread::id, std::unique_ptr<ThreadContext>> m_conns;
     utils::SWMRLock m_contextLock;
     utils::ReadLocker m_readLock;
-    utils::WriteLocker m_writeLock;
+    WriteLocker m_writeLock;
+    std::atomic_bool m_walEnabled;
+    // Only modified by the writer, see cacheGeneration()
+    std::atomic<uint64_t> m_cacheGeneration;
+    QueryProfiler m_profiler;
     std::unordered_map<std::string, UpdateHookCb> m_hooks;
+
+    static std::atomic<uint64_t> NextId;
 };
 
 }
@@ -0,0 +1,161 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "SqliteKeyset.h"
+
+#include <cassert>
+#include <cstdlib>
+
+#include "SqliteTools.h"
+
+namespace medialibrary
+{
+
+namespace sqlite
+{
+
+namespace
+{
+
+void appendField( std::string& res, const std::string& field )
+{
+    res += std::to_string( field.length() );
+    res += ':';
+    res += field;
+}
+
+bool readField( const std::string& str, size_t& offset, std::string& field )
+{
+    auto sep = str.find( ':', offset );
+    if ( sep == std::string::npos || sep == offset )
+        return false;
+    char* end;
+    auto length = strtoul( str.c_str() + offset, &end, 10 );
+    if ( end != str.c_str() + sep || sep + 1 + length > str.length() )
+        return false;
+    field = str.substr( sep + 1, length );
+    offset = sep + 1 + length;
+    return true;
+}
+
+}
+
+Keyset::Keyset( SortingCriteria sort, bool desc, std::vector<Term> terms,
+                std::string primaryKey, Filter filter )
+    : m_tag( std::to_string( static_cast<int>( sort ) ) + ( desc ? 'd' : 'a' ) )
+    , m_terms( std::move( terms ) )
+    , m_nbTerms( m_terms.size() )
+    , m_primaryKey( std::move( primaryKey ) )
+    , m_filter( filter )
+{
+    assert( m_terms.empty() == false && m_terms.size() <= 2 );
+    // Always use 2 terms so that the number of bound parameters doesn't depend
+    // on the sorting criteria. A constant term never discriminates any row.
+    if ( m_terms.size() == 1 )
+        m_terms.emplace_back( "0", true, false );
+}
+
+std::string Keyset::columns() const
+{
+    return ", " + m_terms[0].expr + ", " + m_terms[1].expr;
+}
+
+std::string Keyset::clause( bool hasKey ) const
+{
+    std::string req;
+    if ( hasKey == true )
+    {
+        switch ( m_filter )
+        {
+        case Filter::Where:
+            req += " WHERE ";
+            break;
+        case Filter::And:
+            req += " AND ";
+            break;
+        case Filter::Having:
+            req += " HAVING ";
+            break;
+        }
+        const auto& t1 = m_terms[0];
+        const auto& t2 = m_terms[1];
+        const auto v1 = t1.numeric ? std::string{ "CAST(:k1 AS INTEGER)" } : std::string{ ":k1" };
+        const auto v2 = t2.numeric ? std::string{ "CAST(:k2 AS INTEGER)" } : std::string{ ":k2" };
+        const auto op1 = t1.desc ? " < " : " > ";
+        const auto op2 = t2.desc ? " < " : " > ";
+        // (t1, t2, pk) > (:k1, :k2, :k3), expanded to support mixed directions
+        req += "(" + t1.expr + op1 + v1 + " OR (" + t1.expr + " = " + v1 +
+                " AND (" + t2.expr + op2 + v2 + " OR (" + t2.expr + " = " + v2 +
+                " AND " + m_primaryKey + op1 + ":k3))))";
+    }
+    req += " ORDER BY ";
+    for ( auto i = 0u; i < m_nbTerms; ++i )
+    {
+        req += m_terms[i].expr;
+        if ( m_terms[i].desc == true )
+            req += " DESC";
+        req += ", ";
+    }
+    req += m_primaryKey;
+    if ( m_terms[0].desc == true )
+        req += " DESC";
+    req += " LIMIT ?";
+    return req;
+}
+
+std::string Keyset::encode( const Row& row ) const
+{
+    auto nbColumns = row.nbColumns();
+    assert( nbColumns >= 3 );
+    std::string res;
+    appendField( res, m_tag );
+    appendField( res, row.load<std::string>( nbColumns - 2 ) );
+    appendField( res, row.load<std::string>( nbColumns - 1 ) );
+    appendField( res, std::to_string( row.load<int64_t>( 0 ) ) );
+    return res;
+}
+
+bool Keyset::decode( const std::string& after, Key& key ) const
+{
+    size_t offset = 0;
+    std::string tag;
+    std::string id;
+    if ( readField( after, offset, tag ) == false ||
+         readField( after, offset, key.first ) == false ||
+         readField( after, offset, key.second ) == false ||
+         readField( after, offset, id ) == false ||
+         offset != after.length() )
+        return false;
+    if ( tag != m_tag )
+        return false;
+    char* end;
+    key.id = strtoll( id.c_str(), &end, 10 );
+    return id.empty() == false && *end == 0;
+}
+
+}
+
+}
@@ -0,0 +1,111 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "medialibrary/IMediaLibrary.h"
+
+namespace medialibrary
+{
+
+namespace sqlite
+{
+
+class Row;
+
+///
+/// \brief Describes the ordering of a paginated listing, and generates the SQL
+/// required to resume that listing after a given row.
+///
+/// A keyset is composed of one or two sorting terms, and is always terminated by
+/// the entity primary key, so that the ordering is total. The "after" key handed
+/// back to the application encodes the values of those terms for the last row of
+/// a page, which lets us resume from there without using OFFSET.
+///
+class Keyset
+{
+public:
+    struct Term
+    {
+        Term( std::string e, bool n, bool d )
+            : expr( std::move( e ) ), numeric( n ), desc( d ) {}
+        /// The SQL expression, as it would appear in an ORDER BY clause. It must
+        /// not evaluate to NULL.
+        std::string expr;
+        /// Whether this expression evaluates to an integer or a string
+        bool numeric;
+        bool desc;
+    };
+
+    enum class Filter
+    {
+        /// The request doesn't have a WHERE clause yet
+        Where,
+        /// The request already has a WHERE clause
+        And,
+        /// The request uses a GROUP BY clause, the terms refer to aggregates
+        Having,
+    };
+
+    struct Key
+    {
+        std::string first;
+        std::string second;
+        int64_t id;
+    };
+
+    Keyset( SortingCriteria sort, bool desc, std::vector<Term> terms,
+            std::string primaryKey, Filter filter );
+
+    /**
+     * @brief columns Returns the list of columns to append to the SELECT clause
+     * so that the key can be extracted from each row.
+     * The returned string starts with a comma, and must be the last columns of
+     * the result set.
+     */
+    std::string columns() const;
+    /**
+     * @brief clause Returns the end of the request, starting with the filtering
+     * on the key when resuming a listing, followed by the ORDER BY & LIMIT clauses
+     *
+     * When hasKey is true, the request expects the 3 Key fields followed by the
+     * limit to be bound. Otherwise, only the limit is expected.
+     */
+    std::string clause( bool hasKey ) const;
+
+    std::string encode( const Row& row ) const;
+    bool decode( const std::string& after, Key& key ) const;
+
+private:
+    std::string m_tag;
+    std::vector<Term> m_terms;
+    size_t m_nbTerms;
+    std::string m_primaryKey;
+    Filter m_filter;
+};
+
+}
+
+}
@@ -0,0 +1,123 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "SqliteQueryProfiler.h"
+
+#include <algorithm>
+
+namespace medialibrary
+{
+
+namespace sqlite
+{
+
+static_assert( QueryStats::NbLatencyBuckets == utils::LatencyHistogram::NbBuckets,
+               "Mismatching latency histogram size" );
+
+QueryProfiler::Entry::Entry( std::string req )
+    : m_request( std::move( req ) )
+    , m_nbExecutions( 0 )
+    , m_nbRows( 0 )
+    , m_lockWaitDuration( 0 )
+{
+}
+
+void QueryProfiler::Entry::record( Clock::duration duration, uint64_t nbRows )
+{
+    m_nbExecutions.fetch_add( 1, std::memory_order_relaxed );
+    m_nbRows.fetch_add( nbRows, std::memory_order_relaxed );
+    m_latencies.record( duration );
+}
+
+void QueryProfiler::Entry::recordLockWait( Clock::duration duration )
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>( duration ).count();
+    m_lockWaitDuration.fetch_add( static_cast<uint64_t>( us ), std::memory_order_relaxed );
+}
+
+QueryStats QueryProfiler::Entry::stats() const
+{
+    QueryStats s;
+    s.request = m_request;
+    s.nbExecutions = m_nbExecutions.load( std::memory_order_relaxed );
+    s.nbRows = m_nbRows.load( std::memory_order_relaxed );
+    s.totalDuration = m_latencies.totalDuration();
+    s.maxDuration = m_latencies.maxDuration();
+    s.lockWaitDuration = m_lockWaitDuration.load( std::memory_order_relaxed );
+    s.latencies = m_latencies.buckets();
+    return s;
+}
+
+void QueryProfiler::Entry::reset()
+{
+    m_nbExecutions.store( 0, std::memory_order_relaxed );
+    m_nbRows.store( 0, std::memory_order_relaxed );
+    m_lockWaitDuration.store( 0, std::memory_order_relaxed );
+    m_latencies.reset();
+}
+
+QueryProfiler::Entry& QueryProfiler::entry( const std::string& req )
+{
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    auto it = m_entries.find( req );
+    if ( it != end( m_entries ) )
+        return *it->second;
+    auto e = std::unique_ptr<Entry>( new Entry( req ) );
+    auto& res = *e;
+    m_entries.emplace( req, std::move( e ) );
+    return res;
+}
+
+std::vector<QueryStats> QueryProfiler::stats() const
+{
+    std::vector<QueryStats> res;
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        res.reserve( m_entries.size() );
+        for ( const auto& p : m_entries )
+        {
+            auto s = p.second->stats();
+            if ( s.nbExecutions > 0 )
+                res.push_back( std::move( s ) );
+        }
+    }
+    // Most expensive requests first
+    std::sort( begin( res ), end( res ), []( const QueryStats& l, const QueryStats& r ) {
+        return l.totalDuration > r.totalDuration;
+    });
+    return res;
+}
+
+void QueryProfiler::reset()
+{
+    std::unique_lock<compat::Mutex> lock( m_mutex );
+    for ( auto& p : m_entries )
+        p.second->reset();
+}
+
+}
+
+}
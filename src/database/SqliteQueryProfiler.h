@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compat/Mutex.h"
+#include "medialibrary/IMediaLibrary.h"
+#include "utils/LatencyHistogram.h"
+
+namespace medialibrary
+{
+
+namespace sqlite
+{
+
+/**
+ * @brief QueryProfiler collects the execution statistics of each SQL request.
+ *
+ * Each request gets its own set of counters, which are only updated using
+ * relaxed atomic operations, so that recording an execution is cheap enough to
+ * be left enabled at all times. Counters are never released once created, which
+ * allows them to be referenced by the compiled statements caches without
+ * looking them up again for each execution.
+ */
+class QueryProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Entry
+    {
+    public:
+        explicit Entry( std::string req );
+        void record( Clock::duration duration, uint64_t nbRows );
+        void recordLockWait( Clock::duration duration );
+        QueryStats stats() const;
+        void reset();
+
+    private:
+        const std::string m_request;
+        std::atomic<uint64_t> m_nbExecutions;
+        std::atomic<uint64_t> m_nbRows;
+        std::atomic<uint64_t> m_lockWaitDuration;
+        utils::LatencyHistogram m_latencies;
+    };
+
+    /**
+     * @brief entry Returns the counters for the provided request, creating
+     *        them if needed.
+     *
+     * The returned reference stays valid for the profiler lifetime.
+     */
+    Entry& entry( const std::string& req );
+    std::vector<QueryStats> stats() const;
+    void reset();
+
+private:
+    mutable compat::Mutex m_mutex;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> m_entries;
+};
+
+}
+
+}
@@ -22,9 +22,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
 #include <chrono>
 #include <cstring>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <sqlite3.h>
 #include <string>
@@ -34,6 +38,7 @@
 #include <compat/Mutex.h>
 #include "database/SqliteConnection.h"
 #include "database/SqliteErrors.h"
+#include "database/SqliteKeyset.h"
 #include "database/SqliteTraits.h"
 #include "database/SqliteTransaction.h"
 #include "logging/Logger.h"
@@ -48,10 +53,11 @@ namespace sqlite
 class Row
 {
 public:
-    Row( sqlite3_stmt* stmt )
+    Row( sqlite3_stmt* stmt, uint64_t cacheGeneration )
         : m_stmt( stmt )
         , m_idx( 0 )
         , m_nbColumns( sqlite3_column_count( stmt ) )
+        , m_cacheGeneration( cacheGeneration )
     {
     }
 
@@ -59,6 +65,7 @@ public:
         : m_stmt( nullptr )
         , m_idx( 0 )
         , m_nbColumns( 0 )
+        , m_cacheGeneration( 0 )
     {
     }
 
@@ -98,6 +105,15 @@ public:
         return sqlite::Traits<T>::Load( m_stmt, idx );
     }
 
+    /**
+     * @brief Returns the connection cache generation recorded before this row
+     *        was read. \sa Connection::cacheGeneration
+     */
+    uint64_t cacheGeneration() const
+    {
+        return m_cacheGeneration;
+    }
+
     bool operator==(std::nullptr_t) const
     {
         return m_stmt == nullptr;
@@ -112,60 +128,137 @@ private:
     sqlite3_stmt* m_stmt;
     unsigned int m_idx;
     unsigned int m_nbColumns;
+    uint64_t m_cacheGeneration;
 };
 
 class Statement
 {
 public:
-    Statement( Connection::Handle dbConnection, const std::string& req )
-        : m_stmt( nullptr, [](sqlite3_stmt* stmt) {
-                sqlite3_clear_bindings( stmt );
-                sqlite3_reset( stmt );
-            })
-        , m_dbConn( dbConnection )
+    /**
+     * @brief Statement Creates a statement using the current thread's
+     *        connection.
+     *
+     * The compiled statement is cached in the thread's connection context, and
+     * will be reused by subsequent executions of the same request on this
+     * thread. Since the cache is thread specific, no locking is involved.
+     */
+    Statement( Connection* dbConnection, const std::string& req )
+        : m_stmt( nullptr, &Reset )
+        , m_conn( dbConnection )
         , m_bindIdx( 0 )
         , m_isCommit( false )
+        , m_stats( nullptr )
+        , m_running( false )
+        , m_nbRows( 0 )
+        , m_duration( QueryProfiler::Clock::duration::zero() )
+        , m_cacheGeneration( Connection::AlwaysCacheable )
     {
-        std::lock_guard<compat::Mutex> lock( StatementsCacheLock );
-        auto& connMap = StatementsCache[ dbConnection ];
-        auto it = connMap.find( req );
-        if ( it == end( connMap ) )
+        auto& ctx = dbConnection->threadContext();
+        m_dbConn = ctx.handle.get();
+        auto it = ctx.statements.find( req );
+        if ( it == end( ctx.statements ) )
         {
-            sqlite3_stmt* stmt;
-            int res = sqlite3_prepare_v2( dbConnection, req.c_str(), -1, &stmt, NULL );
-            if ( res != SQLITE_OK )
-            {
-                throw errors::Generic( req.c_str(), sqlite3_errmsg( dbConnection ), res );
-            }
-            m_stmt.reset( stmt );
-            connMap.emplace( req, CachedStmtPtr( stmt, &sqlite3_finalize ) );
+            m_stmt.reset( prepare( m_dbConn, req ) );
+            m_stats = &dbConnection->profiler().entry( req );
+            ctx.statements.emplace( req, Connection::ThreadContext::CachedStatement{
+                    Connection::CachedStmtPtr( m_stmt.get(), &sqlite3_finalize ), m_stats } );
         }
         else
         {
-            m_stmt.reset( it->second.get() );
+            m_stmt.reset( it->second.stmt.get() );
+            m_stats = it->second.stats;
+        }
+        // Account for the time spent waiting for the database before this
+        // request could run
+        if ( ctx.pendingLockWait != QueryProfiler::Clock::duration::zero() )
+        {
+            m_stats->recordLockWait( ctx.pendingLockWait );
+            ctx.pendingLockWait = QueryProfiler::Clock::duration::zero();
         }
         if ( req == "COMMIT" )
             m_isCommit = true;
     }
 
+    /**
+     * @brief Statement Creates a one-shot statement for the provided sqlite
+     *        handle.
+     *
+     * Since the handle isn't tied to a connection context, the compiled
+     * statement isn't cached and gets finalized upon destruction. Its
+     * executions aren't profiled either.
+     */
+    Statement( Connection::Handle dbConnection, const std::string& req )
+        : m_stmt( nullptr, &Finalize )
+        , m_conn( nullptr )
+        , m_dbConn( dbConnection )
+        , m_bindIdx( 0 )
+        , m_isCommit( false )
+        , m_stats( nullptr )
+        , m_running( false )
+        , m_nbRows( 0 )
+        , m_duration( QueryProfiler::Clock::duration::zero() )
+        , m_cacheGeneration( Connection::AlwaysCacheable )
+    {
+        m_stmt.reset( prepare( dbConnection, req ) );
+    }
+
+    Statement( Statement&& ) = default;
+    Statement& operator=( Statement&& ) = default;
+
+    ~Statement()
+    {
+        // The request might not have been stepped through all its rows, for
+        // instance when fetching a single record
+        if ( m_stmt != nullptr )
+            recordExecution();
+    }
+
     template <typename... Args>
     void execute(Args&&... args)
     {
+        recordExecution();
+        // Recorded before the first step, which starts the read snapshot
+        if ( m_conn != nullptr && Transaction::transactionInProgress() == false )
+            m_cacheGeneration = m_conn->cacheGeneration();
+        else
+            m_cacheGeneration = Connection::AlwaysCacheable;
+        m_running = true;
         m_bindIdx = 1;
         (void)std::initializer_list<bool>{ _bind( std::forward<Args>( args ) )... };
     }
 
+    /**
+     * @brief bind Binds the provided values after the previously bound ones
+     *
+     * This allows requests with a variable number of parameters, such as
+     * multi-row insertions, to be bound in multiple steps, after execute() has
+     * been invoked.
+     */
+    template <typename... Args>
+    void bind(Args&&... args)
+    {
+        (void)std::initializer_list<bool>{ _bind( std::forward<Args>( args ) )... };
+    }
+
     Row row()
     {
         auto maxRetries = 10;
         while ( true )
         {
+            auto chrono = QueryProfiler::Clock::now();
             auto extRes = sqlite3_step( m_stmt.get() );
+            m_duration += QueryProfiler::Clock::now() - chrono;
             auto res = extRes & 0xFF;
             if ( res == SQLITE_ROW )
-                return Row( m_stmt.get() );
+            {
+                ++m_nbRows;
+                return Row( m_stmt.get(), m_cacheGeneration );
+            }
             else if ( res == SQLITE_DONE )
+            {
+                recordExecution();
                 return Row();
+            }
             else if ( ( Transaction::transactionInProgress() == false || m_isCommit == true ) &&
                      errors::isInnocuous( res ) && maxRetries-- > 0 )
                 continue;
@@ -183,20 +276,6 @@ public:
         }
     }
 
-    static void FlushStatementCache()
-    {
-        std::lock_guard<compat::Mutex> lock( StatementsCacheLock );
-        StatementsCache.clear();
-    }
-
-    static void FlushConnectionStatementCache( Connection::Handle h )
-    {
-        std::lock_guard<compat::Mutex> lock( StatementsCacheLock );
-        auto it = StatementsCache.find( h );
-        if ( it != end( StatementsCache ) )
-            StatementsCache.erase( it );
-    }
-
 private:
     template <typename T>
     bool _bind( T&& value )
@@ -208,19 +287,165 @@ private:
         return true;
     }
 
+    void recordExecution()
+    {
+        if ( m_running == false )
+            return;
+        m_running = false;
+        if ( m_stats != nullptr )
+            m_stats->record( m_duration, m_nbRows );
+        LOG_DEBUG( "Executed ", sqlite3_sql( m_stmt.get() ), " in ",
+                   std::chrono::duration_cast<std::chrono::microseconds>( m_duration ).count(),
+                   "µs (", m_nbRows, " rows)" );
+        m_nbRows = 0;
+        m_duration = QueryProfiler::Clock::duration::zero();
+    }
+
+    static sqlite3_stmt* prepare( Connection::Handle dbConnection, const std::string& req )
+    {
+        sqlite3_stmt* stmt;
+        int res = sqlite3_prepare_v2( dbConnection, req.c_str(), -1, &stmt, NULL );
+        if ( res != SQLITE_OK )
+        {
+            throw errors::Generic( req.c_str(), sqlite3_errmsg( dbConnection ), res );
+        }
+        return stmt;
+    }
+
+    static void Reset( sqlite3_stmt* stmt )
+    {
+        sqlite3_clear_bindings( stmt );
+        sqlite3_reset( stmt );
+    }
+
+    static void Finalize( sqlite3_stmt* stmt )
+    {
+        sqlite3_finalize( stmt );
+    }
+
 private:
-    // Used during the connection lifetime. This holds a compiled request
-    using CachedStmtPtr = std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)>;
     // Used for the current statement execution, this
     // basically holds the state of the currently executed request.
     using StatementPtr = std::unique_ptr<sqlite3_stmt, void(*)(sqlite3_stmt*)>;
     StatementPtr m_stmt;
+    // Null for the one-shot statements
+    Connection* m_conn;
     Connection::Handle m_dbConn;
     unsigned int m_bindIdx;
     bool m_isCommit;
-    static compat::Mutex StatementsCacheLock;
-    static std::unordered_map<Connection::Handle,
-                            std::unordered_map<std::string, CachedStmtPtr>> StatementsCache;
+    // Execution statistics, recorded once the request is done, or once the
+    // statement gets reset
+    QueryProfiler::Entry* m_stats;
+    bool m_running;
+    uint64_t m_nbRows;
+    QueryProfiler::Clock::duration m_duration;
+    // The connection cache generation, recorded upon execution
+    uint64_t m_cacheGeneration;
+};
+
+/**
+ * @brief Cursor is a lazily evaluated result set.
+ *
+ * Entities are hydrated (and added to the cache) one at a time, as the cursor
+ * is iterated over, which allows large result sets to be processed in constant
+ * memory. Stopping the iteration early doesn't step through the remaining rows.
+ *
+ * @warning A cursor holds the connection read context until it is either
+ * exhausted or destroyed. This means no write operation must be performed from
+ * the iterating thread while a cursor is alive (unless it was created within a
+ * transaction), and that the request used by the cursor must not be executed
+ * again until the cursor is destroyed, since compiled statements are shared.
+ */
+template <typename IMPL, typename INTF>
+class Cursor
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::shared_ptr<INTF>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        explicit Iterator( Cursor* cursor ) : m_cursor( cursor ) {}
+        reference operator*() const { return m_cursor->m_current; }
+        pointer operator->() const { return &m_cursor->m_current; }
+        Iterator& operator++()
+        {
+            m_cursor->next();
+            return *this;
+        }
+        bool operator==( const Iterator& it ) const { return atEnd() == it.atEnd(); }
+        bool operator!=( const Iterator& it ) const { return atEnd() != it.atEnd(); }
+
+    private:
+        bool atEnd() const
+        {
+            return m_cursor == nullptr || m_cursor->m_current == nullptr;
+        }
+
+    private:
+        Cursor* m_cursor;
+    };
+
+    using Binder = std::function<void(Statement&)>;
+
+    Cursor( MediaLibraryPtr ml, Connection::ReadContext ctx, Statement stmt,
+            std::shared_ptr<Binder> binder )
+        : m_ml( ml )
+        , m_ctx( std::move( ctx ) )
+        , m_stmt( std::move( stmt ) )
+        , m_binder( std::move( binder ) )
+        , m_started( false )
+    {
+    }
+
+    Cursor( Cursor&& ) = default;
+    Cursor& operator=( Cursor&& ) = default;
+
+    Iterator begin()
+    {
+        if ( m_started == false )
+        {
+            m_started = true;
+            next();
+        }
+        return Iterator{ this };
+    }
+
+    Iterator end()
+    {
+        return Iterator{ nullptr };
+    }
+
+private:
+    void next()
+    {
+        auto row = m_stmt.row();
+        if ( row != nullptr )
+        {
+            m_current = IMPL::load( m_ml, row );
+            return;
+        }
+        m_current = nullptr;
+        // Once the statement is done, it doesn't hold any sqlite lock anymore,
+        // so there's no reason to keep other threads from writing
+        if ( m_ctx.owns_lock() == true )
+            m_ctx.unlock();
+    }
+
+private:
+    MediaLibraryPtr m_ml;
+    // The context must outlive the statement, so that the statement is reset
+    // before another thread is allowed to write
+    Connection::ReadContext m_ctx;
+    Statement m_stmt;
+    // Holds a copy of the bound parameters, since they must outlive the statement
+    std::shared_ptr<Binder> m_binder;
+    std::shared_ptr<INTF> m_current;
+    bool m_started;
 };
 
 class Tools
@@ -240,10 +465,8 @@ class Tools
             Connection::ReadContext ctx;
             if (Transaction::transactionInProgress() == false)
                 ctx = dbConnection->acquireReadContext();
-            auto chrono = std::chrono::steady_clock::now();
-
             std::vector<std::shared_ptr<INTF>> results;
-            Statement stmt( dbConnection->handle(), req );
+            Statement stmt( dbConnection, req );
             stmt.execute( std::forward<Args>( args )... );
             Row sqliteRow;
             while ( ( sqliteRow = stmt.row() ) != nullptr )
@@ -251,12 +474,174 @@ class Tools
                 auto row = IMPL::load( ml, sqliteRow );
                 results.push_back( row );
             }
-            auto duration = std::chrono::steady_clock::now() - chrono;
-            LOG_DEBUG("Executed ", req, " in ",
-                     std::chrono::duration_cast<std::chrono::microseconds>( duration ).count(), "µs" );
             return results;
         }
 
+        /**
+         * Fetches the records of type IMPL matching any of the provided values
+         * This WILL add all fetched records to the cache
+         *
+         * @param req The request, up to and including its IN keyword. The
+         *            values list gets appended to it.
+         *
+         * Values are fetched by chunks, so that a single request never exceeds
+         * the maximum number of parameters. Chunks are padded to a power of 2
+         * by repeating their last value, so that only a handful of different
+         * requests end up compiled & cached.
+         * Records are returned in an undefined order.
+         */
+        template <typename IMPL, typename INTF>
+        static std::vector<std::shared_ptr<INTF>> fetchAllIn( MediaLibraryPtr ml, const std::string& req,
+                                                              const std::vector<int64_t>& values )
+        {
+            std::vector<std::shared_ptr<INTF>> results;
+            if ( values.empty() == true )
+                return results;
+            results.reserve( values.size() );
+            forEachRowIn( ml, req, values, [ml, &results]( Row& row ) {
+                results.push_back( IMPL::load( ml, row ) );
+            });
+            return results;
+        }
+
+        /**
+         * Same as fetchAllIn, but only returns the first column of each row,
+         * without hydrating anything.
+         * The provided arguments are bound before the values list, meaning
+         * they must match the parameters located before the IN clause.
+         */
+        template <typename... Args>
+        static std::vector<int64_t> fetchIdsIn( MediaLibraryPtr ml, const std::string& req,
+                                                const std::vector<int64_t>& values, Args&&... args )
+        {
+            std::vector<int64_t> results;
+            if ( values.empty() == true )
+                return results;
+            forEachRowIn( ml, req, values, [&results]( Row& row ) {
+                results.push_back( row.load<int64_t>( 0 ) );
+            }, std::forward<Args>( args )... );
+            return results;
+        }
+
+        /**
+         * Calls func with each row returned by the request, for any of the
+         * provided values. See fetchAllIn for the request & chunking details.
+         * The provided arguments are bound before the values list.
+         */
+        template <typename Func, typename... Args>
+        static void forEachRowIn( MediaLibraryPtr ml, const std::string& req,
+                            const std::vector<int64_t>& values, Func&& func, Args&&... args )
+        {
+            auto dbConnection = ml->getConn();
+            Connection::ReadContext ctx;
+            if (Transaction::transactionInProgress() == false)
+                ctx = dbConnection->acquireReadContext();
+
+            auto maxParams = static_cast<size_t>( sqlite3_limit( dbConnection->handle(),
+                                                  SQLITE_LIMIT_VARIABLE_NUMBER, -1 ) ) - sizeof...( args );
+            auto limit = maxParams < MaxInChunkSize ? maxParams : MaxInChunkSize;
+            size_t maxChunkSize = 1;
+            while ( maxChunkSize * 2 <= limit )
+                maxChunkSize *= 2;
+            for ( size_t i = 0; i < values.size(); )
+            {
+                auto nbValues = std::min( maxChunkSize, values.size() - i );
+                size_t chunkSize = 1;
+                while ( chunkSize < nbValues )
+                    chunkSize *= 2;
+                std::string chunkReq = req;
+                chunkReq.reserve( req.size() + chunkSize * 2 + 1 );
+                chunkReq += "(?";
+                for ( auto j = 1u; j < chunkSize; ++j )
+                    chunkReq += ",?";
+                chunkReq += ')';
+                Statement stmt( dbConnection, chunkReq );
+                stmt.execute( args... );
+                for ( auto j = 0u; j < chunkSize; ++j )
+                    stmt.bind( values[i + std::min<size_t>( j, nbValues - 1 )] );
+                Row sqliteRow;
+                while ( ( sqliteRow = stmt.row() ) != nullptr )
+                    func( sqliteRow );
+                i += nbValues;
+            }
+        }
+
+        /**
+         * Returns a cursor over the records of type IMPL, hydrated as the cursor
+         * is being iterated over.
+         *
+         * The parameters are copied, since the request is stepped after this
+         * function returns.
+         */
+        template <typename IMPL, typename INTF, typename... Args>
+        static Cursor<IMPL, INTF> fetchCursor( MediaLibraryPtr ml, const std::string& req, Args&&... args )
+        {
+            auto dbConnection = ml->getConn();
+            Connection::ReadContext ctx;
+            if (Transaction::transactionInProgress() == false)
+                ctx = dbConnection->acquireReadContext();
+
+            Statement stmt( dbConnection, req );
+            auto binder = std::make_shared<typename Cursor<IMPL, INTF>::Binder>(
+                        [args...]( Statement& s ) { s.execute( args... ); } );
+            (*binder)( stmt );
+            return Cursor<IMPL, INTF>{ ml, std::move( ctx ), std::move( stmt ), std::move( binder ) };
+        }
+
+        /**
+         * Fetches at most nbItems records of type IMPL, located after the
+         * provided key in the order described by the keyset.
+         * Only the returned records are hydrated & added to the cache.
+         *
+         * @param req   The request, up to (and including) its WHERE clause, if
+         *              any. The keyset clause will be appended to it.
+         * @param after An opaque key, as returned in a previous Page::next, or
+         *              an empty string to start from the beginning of the list.
+         */
+        template <typename IMPL, typename INTF, typename... Args>
+        static Page<INTF> fetchPage( MediaLibraryPtr ml, const Keyset& keyset, uint32_t nbItems,
+                                     const std::string& after, const std::string& req, Args&&... args )
+        {
+            Page<INTF> page;
+            if ( nbItems == 0 )
+                return page;
+            Keyset::Key key;
+            auto hasKey = after.empty() == false;
+            if ( hasKey == true && keyset.decode( after, key ) == false )
+            {
+                LOG_ERROR( "Invalid or mismatching pagination key: ", after );
+                return page;
+            }
+            auto dbConnection = ml->getConn();
+            Connection::ReadContext ctx;
+            if (Transaction::transactionInProgress() == false)
+                ctx = dbConnection->acquireReadContext();
+            auto fullReq = req + keyset.clause( hasKey );
+            Statement stmt( dbConnection, fullReq );
+            // Fetch an extra row to know if another page is available
+            if ( hasKey == true )
+                stmt.execute( std::forward<Args>( args )..., key.first, key.second, key.id,
+                              static_cast<int64_t>( nbItems ) + 1 );
+            else
+                stmt.execute( std::forward<Args>( args )..., static_cast<int64_t>( nbItems ) + 1 );
+            page.items.reserve( nbItems );
+            std::string lastKey;
+            Row sqliteRow;
+            while ( ( sqliteRow = stmt.row() ) != nullptr )
+            {
+                if ( page.items.size() == nbItems )
+                {
+                    // Don't step through the remaining rows, we have all we need
+                    page.next = std::move( lastKey );
+                    break;
+                }
+                page.items.push_back( IMPL::load( ml, sqliteRow ) );
+                if ( page.items.size() == nbItems )
+                    lastKey = keyset.encode( sqliteRow );
+            }
+            return page;
+        }
+
         template <typename T, typename... Args>
         static std::shared_ptr<T> fetchOne( MediaLibraryPtr ml, const std::string& req, Args&&... args )
         {
@@ -264,17 +649,12 @@ class Tools
             Connection::ReadContext ctx;
             if (Transaction::transactionInProgress() == false)
                 ctx = dbConnection->acquireReadContext();
-            auto chrono = std::chrono::steady_clock::now();
-
-            Statement stmt( dbConnection->handle(), req );
+            Statement stmt( dbConnection, req );
             stmt.execute( std::forward<Args>( args )... );
             auto row = stmt.row();
             std::shared_ptr<T> res;
             if ( row != nullptr )
                 res = T::load( ml, row );
-            auto duration = std::chrono::steady_clock::now() - chrono;
-            LOG_DEBUG("Executed ", req, " in ",
-                     std::chrono::duration_cast<std::chrono::microseconds>( duration ).count(), "µs" );
             return res;
         }
 
@@ -318,6 +698,122 @@ class Tools
             return sqlite3_last_insert_rowid( dbConnection->handle() );
         }
 
+        /**
+         * Inserts multiple records using multi-row insertions, and returns
+         * their primary keys, in the insertion order.
+         * Records are inserted by chunks, so that a single request never
+         * exceeds the maximum number of parameters.
+         *
+         * @param req The insertion request, up to and including the VALUES keyword
+         * @param rowPlaceholders The placeholders for a single record, ie. "(?, ?)"
+         * @param nbParams The number of parameters for a single record
+         * @param nbRows The number of records to insert
+         * @param bindRow Invoked with the statement & the record index, to bind
+         *                a single record using Statement::bind
+         *
+         * This must be run from within a transaction, so that a failure
+         * doesn't leave only some of the chunks inserted.
+         */
+        template <typename Binder>
+        static std::vector<int64_t> executeInsertBatch( sqlite::Connection* dbConnection,
+                                                        const std::string& req,
+                                                        const std::string& rowPlaceholders,
+                                                        unsigned int nbParams, size_t nbRows,
+                                                        Binder&& bindRow )
+        {
+            assert( Transaction::transactionInProgress() == true );
+            assert( nbParams > 0 );
+            auto maxParams = sqlite3_limit( dbConnection->handle(),
+                                            SQLITE_LIMIT_VARIABLE_NUMBER, -1 );
+            size_t maxRows = std::max( 1u, static_cast<unsigned int>( maxParams ) / nbParams );
+            std::vector<int64_t> keys;
+            keys.reserve( nbRows );
+            size_t row = 0;
+            while ( row < nbRows )
+            {
+                auto nbChunkRows = std::min( maxRows, nbRows - row );
+                std::string chunkReq = req;
+                chunkReq.reserve( req.size() + nbChunkRows * ( rowPlaceholders.size() + 1 ) );
+                for ( auto i = 0u; i < nbChunkRows; ++i )
+                {
+                    if ( i > 0 )
+                        chunkReq += ',';
+                    chunkReq += rowPlaceholders;
+                }
+                // Each chunk is profiled by the statement itself
+                Statement stmt( dbConnection, chunkReq );
+                stmt.execute();
+                for ( auto i = 0u; i < nbChunkRows; ++i )
+                    bindRow( stmt, row + i );
+                while ( stmt.row() != nullptr )
+                    ;
+                auto handle = dbConnection->handle();
+                if ( static_cast<size_t>( sqlite3_changes( handle ) ) != nbChunkRows )
+                    return {};
+                // Rows inserted by a single statement get consecutive row IDs,
+                // the last one being reported as the last inserted row ID
+                auto lastKey = sqlite3_last_insert_rowid( handle );
+                for ( auto key = lastKey - static_cast<int64_t>( nbChunkRows ) + 1; key <= lastKey; ++key )
+                    keys.push_back( key );
+                row += nbChunkRows;
+            }
+            return keys;
+        }
+
+        /**
+         * Converts a user provided search pattern to an FTS5 query, matching
+         * the records containing a word starting with each of the pattern's
+         * words.
+         * Each word is quoted, so that FTS5 operators & special characters
+         * are matched literally.
+         */
+        static std::string sanitizePattern( const std::string& pattern )
+        {
+            return sanitizePattern( patternWords( pattern ) );
+        }
+
+        static std::string sanitizePattern( const std::vector<std::string>& words )
+        {
+            std::string res;
+            for ( const auto& w : words )
+            {
+                if ( res.empty() == false )
+                    res += ' ';
+                res += '"';
+                for ( auto c : w )
+                {
+                    if ( c == '"' )
+                        res += '"';
+                    res += c;
+                }
+                res += "\"*";
+            }
+            return res;
+        }
+
+        /**
+         * Splits a user provided search pattern in whitespace separated words
+         */
+        static std::vector<std::string> patternWords( const std::string& pattern )
+        {
+            std::vector<std::string> words;
+            auto i = 0u;
+            while ( i < pattern.size() )
+            {
+                if ( isspace( static_cast<unsigned char>( pattern[i] ) ) != 0 )
+                {
+                    ++i;
+                    continue;
+                }
+                auto begin = i;
+                while ( i < pattern.size() &&
+                        isspace( static_cast<unsigned char>( pattern[i] ) ) == 0 )
+                    ++i;
+                words.emplace_back( pattern, begin, i - begin );
+            }
+            return words;
+        }
+
         /**
          * \brief   Automatically retry a code block when innocuous sqlite errors occur.
          *
@@ -345,17 +841,15 @@ class Tools
         }
 
     private:
+        static constexpr size_t MaxInChunkSize = 512;
+
         template <typename... Args>
         static void executeRequestLocked( sqlite::Connection* dbConnection, const std::string& req, Args&&... args )
         {
-            auto chrono = std::chrono::steady_clock::now();
-            Statement stmt( dbConnection->handle(), req );
+            Statement stmt( dbConnection, req );
             stmt.execute( std::forward<Args>( args )... );
             while ( stmt.row() != nullptr )
                 ;
-            auto duration = std::chrono::steady_clock::now() - chrono;
-            LOG_DEBUG("Executed ", req, " in ",
-                     std::chrono::duration_cast<std::chrono::microseconds>( duration ).count(), "µs" );
         }
 };
 
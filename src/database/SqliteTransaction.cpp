@@ -38,22 +38,50 @@ thread_local Transaction* Transaction::CurrentTransaction = nullptr;
 
 Transaction::Transaction( sqlite::Connection* dbConn)
     : m_dbConn( dbConn )
-    , m_ctx( dbConn->acquireWriteContext() )
+    , m_parent( CurrentTransaction )
+    , m_ctx( m_parent == nullptr ? dbConn->acquireWriteContext() : Connection::WriteContext{} )
 {
-    assert( CurrentTransaction == nullptr );
-    LOG_DEBUG( "Starting SQLite transaction" );
-    Statement s( dbConn->handle(), "BEGIN" );
-    s.execute();
-    while ( s.row() != nullptr )
-        ;
+    assert( m_parent == nullptr || m_parent->m_dbConn == dbConn );
+    if ( m_parent == nullptr )
+    {
+        LOG_DEBUG( "Starting SQLite transaction" );
+        Statement s( dbConn, "BEGIN" );
+        s.execute();
+        while ( s.row() != nullptr )
+            ;
+    }
+    else
+    {
+        // Savepoints with the same name are allowed, and always refer to the
+        // most recent one
+        Statement s( dbConn, "SAVEPOINT nested" );
+        s.execute();
+        while ( s.row() != nullptr )
+            ;
+    }
     CurrentTransaction = this;
 }
 
 void Transaction::commit()
 {
-    assert( CurrentTransaction != nullptr );
+    assert( CurrentTransaction == this );
+    if ( m_parent != nullptr )
+    {
+        Statement s( m_dbConn, "RELEASE nested" );
+        s.execute();
+        while ( s.row() != nullptr )
+            ;
+        // Our changes are now part of the parent transaction, and will be
+        // rolled back along with it
+        m_parent->m_failureHandlers.insert( end( m_parent->m_failureHandlers ),
+                std::make_move_iterator( begin( m_failureHandlers ) ),
+                std::make_move_iterator( end( m_failureHandlers ) ) );
+        m_failureHandlers.clear();
+        CurrentTransaction = m_parent;
+        return;
+    }
     auto chrono = std::chrono::steady_clock::now();
-    Statement s( m_dbConn->handle(), "COMMIT" );
+    Statement s( m_dbConn, "COMMIT" );
     s.execute();
     while ( s.row() != nullptr )
         ;
@@ -78,30 +106,41 @@ void Transaction::onCurrentTransactionFailure( std::function<void ()> f )
 
 Transaction::~Transaction()
 {
+    if ( CurrentTransaction != this )
+        return;
     try
     {
-        if ( CurrentTransaction != nullptr )
+        if ( m_parent == nullptr )
         {
-            Statement s( m_dbConn->handle(), "ROLLBACK" );
+            Statement s( m_dbConn, "ROLLBACK" );
             s.execute();
             while ( s.row() != nullptr )
                 ;
-            for ( const auto& f : m_failureHandlers )
-                f();
-            CurrentTransaction = nullptr;
+        }
+        else
+        {
+            // Rolling back to a savepoint leaves it on the transaction stack
+            Statement s( m_dbConn, "ROLLBACK TO nested" );
+            s.execute();
+            while ( s.row() != nullptr )
+                ;
+            Statement r( m_dbConn, "RELEASE nested" );
+            r.execute();
+            while ( r.row() != nullptr )
+                ;
         }
     }
     // Ignore a rollback failure as it is most likely innocuous (see
     // http://www.sqlite.org/lang_transaction.html
     catch( const std::exception& ex )
     {
-        // Ensure we don't assume a transaction is still running
-        for ( const auto& f : m_failureHandlers )
-            f();
-        CurrentTransaction = nullptr;
-        LOG_WARN( "Failed to rollback transaction: ", ex.what() );
         // Don't call std::terminate if ROLLBACK throws an exception
+        LOG_WARN( "Failed to rollback transaction: ", ex.what() );
     }
+    // Ensure we don't assume a transaction is still running
+    for ( const auto& f : m_failureHandlers )
+        f();
+    CurrentTransaction = m_parent;
 }
 
 }
@@ -34,6 +34,15 @@ namespace medialibrary
 namespace sqlite
 {
 
+/**
+ * @brief The Transaction class represents a write transaction.
+ *
+ * Transactions can be nested: when a transaction is already in progress on the
+ * current thread, a savepoint is created instead. Committing a nested
+ * transaction releases its savepoint, and its changes will only be persisted
+ * when the outermost transaction is committed. Destroying an uncommitted
+ * nested transaction only rolls back the changes made since it was started.
+ */
 class Transaction
 {
 public:
@@ -50,6 +59,7 @@ public:
 
 private:
     sqlite::Connection* m_dbConn;
+    Transaction* m_parent;
     Connection::WriteContext m_ctx;
     std::vector<std::function<void()>> m_failureHandlers;
 
@@ -0,0 +1,58 @@
+"DROP TABLE IF EXISTS " + MediaTable::Name + "Fts;",
+"DROP TABLE IF EXISTS " + AlbumTable::Name + "Fts;",
+"DROP TABLE IF EXISTS " + ArtistTable::Name + "Fts;",
+"DROP TABLE IF EXISTS " + GenreTable::Name + "Fts;",
+"DROP TABLE IF EXISTS " + PlaylistTable::Name + "Fts;",
+
+"CREATE VIRTUAL TABLE " + MediaTable::Name + "Fts USING FTS5("
+    "title,"
+    "labels,"
+    "prefix = '2 3',"
+    "tokenize = 'unicode61 remove_diacritics 1'"
+");",
+
+"CREATE VIRTUAL TABLE " + AlbumTable::Name + "Fts USING FTS5("
+    "title,"
+    "artist,"
+    "prefix = '2 3',"
+    "tokenize = 'unicode61 remove_diacritics 1'"
+");",
+
+"CREATE VIRTUAL TABLE " + ArtistTable::Name + "Fts USING FTS5("
+    "name,"
+    "prefix = '2 3',"
+    "tokenize = 'unicode61 remove_diacritics 1'"
+");",
+
+"CREATE VIRTUAL TABLE " + GenreTable::Name + "Fts USING FTS5("
+    "name,"
+    "prefix = '2 3',"
+    "tokenize = 'unicode61 remove_diacritics 1'"
+");",
+
+"CREATE VIRTUAL TABLE " + PlaylistTable::Name + "Fts USING FTS5("
+    "name,"
+    "prefix = '2 3',"
+    "tokenize = 'unicode61 remove_diacritics 1'"
+");",
+
+"INSERT INTO " + MediaTable::Name + "Fts(rowid, title, labels)"
+    " SELECT id_media, title, COALESCE(("
+        "SELECT GROUP_CONCAT(l.name, ' ') FROM " + LabelTable::Name + " l"
+        " INNER JOIN LabelFileRelation lfr ON lfr.label_id = l.id_label"
+        " WHERE lfr.media_id = m.id_media"
+    "), '') FROM " + MediaTable::Name + " m;",
+
+"INSERT INTO " + AlbumTable::Name + "Fts(rowid, title, artist)"
+    " SELECT id_album, title, ("
+        "SELECT name FROM " + ArtistTable::Name + " WHERE id_artist = alb.artist_id"
+    ") FROM " + AlbumTable::Name + " alb WHERE title IS NOT NULL;",
+
+"INSERT INTO " + ArtistTable::Name + "Fts(rowid, name)"
+    " SELECT id_artist, name FROM " + ArtistTable::Name + " WHERE name IS NOT NULL;",
+
+"INSERT INTO " + GenreTable::Name + "Fts(rowid, name)"
+    " SELECT id_genre, name FROM " + GenreTable::Name + ";",
+
+"INSERT INTO " + PlaylistTable::Name + "Fts(rowid, name)"
+    " SELECT id_playlist, name FROM " + PlaylistTable::Name + ";",
@@ -28,6 +28,7 @@
 
 #include <algorithm>
 #include <queue>
+#include <unordered_map>
 #include <utility>
 
 #include "factory/FileSystemFactory.h"
@@ -36,6 +37,7 @@
 #include "File.h"
 #include "Device.h"
 #include "Folder.h"
+#include "database/SqliteTransaction.h"
 #include "logging/Logger.h"
 #include "MediaLibrary.h"
 #include "probe/CrawlerProbe.h"
@@ -274,7 +276,11 @@ void FsDiscoverer::checkFiles( std::shared_ptr<fs::IDirectory> parentFolderFs,
     LOG_INFO( "Checking file in ", parentFolderFs->mrl() );
     static const std::string req = "SELECT * FROM " + policy::FileTable::Name
             + " WHERE folder_id = ?";
-    auto files = File::fetchAll<File>( m_ml, req, parentFolder->id() );
+    // Index the known files by mrl as they are being fetched, to avoid a linear
+    // lookup for each file on the filesystem
+    std::unordered_map<std::string, std::shared_ptr<File>> knownFiles;
+    for ( const auto& f : File::fetchCursor<File>( m_ml, req, parentFolder->id() ) )
+        knownFiles.emplace( f->mrl(), f );
     std::vector<std::shared_ptr<fs::IFile>> filesToAdd;
     std::vector<std::shared_ptr<File>> filesToRemove;
     for ( const auto& fileFs: parentFolderFs->files() )
@@ -283,32 +289,40 @@ void FsDiscoverer::checkFiles( std::shared_ptr<fs::IDirectory> parentFolderFs,
             break;
         if ( m_probe->proceedOnFile( *fileFs ) == false )
             continue;
-        auto it = std::find_if( begin( files ), end( files ), [fileFs](const std::shared_ptr<File>& f) {
-            return f->mrl() == fileFs->mrl();
-        });
-        if ( it == end( files ) || m_probe->forceFileRefresh() == true )
+        auto it = knownFiles.find( fileFs->mrl() );
+        if ( it == end( knownFiles ) || m_probe->forceFileRefresh() == true )
         {
             if ( MediaLibrary::isExtensionSupported( fileFs->extension().c_str() ) == true )
                 filesToAdd.push_back( fileFs );
             continue;
         }
-        if ( fileFs->lastModificationDate() == (*it)->lastModificationDate() )
+        if ( fileFs->lastModificationDate() == it->second->lastModificationDate() )
         {
             // Unchanged file
-            files.erase( it );
+            knownFiles.erase( it );
             continue;
         }
-        auto& file = (*it);
+        auto& file = it->second;
         LOG_INFO( "Forcing file refresh ", fileFs->mrl() );
         // Pre-cache the file's media, since we need it to remove. However, better doing it
         // out of a write context, since that way, other threads can also read the database.
         file->media();
         filesToRemove.push_back( std::move( file ) );
         filesToAdd.push_back( fileFs );
-        files.erase( it );
+        knownFiles.erase( it );
+    }
+    std::vector<std::shared_ptr<File>> files;
+    if ( m_probe->deleteUnseenFiles() == true )
+    {
+        files.reserve( knownFiles.size() );
+        for ( auto& p : knownFiles )
+            files.push_back( std::move( p.second ) );
     }
-    if ( m_probe->deleteUnseenFiles() == false )
-        files.clear();
+    // Let the parser catch up before queuing more files, unless this would
+    // prevent it from committing its changes
+    if ( filesToAdd.empty() == false &&
+         sqlite::Transaction::transactionInProgress() == false )
+        m_ml->waitForParserBacklog();
     using FilesT = decltype( files );
     using FilesToRemoveT = decltype( filesToRemove );
     using FilesToAddT = decltype( filesToAdd );
@@ -34,14 +34,17 @@
 #include "Folder.h"
 #include "Genre.h"
 #include "Media.h"
+#include "Movie.h"
 #include "Playlist.h"
 #include "Show.h"
+#include "ShowEpisode.h"
 #include "utils/Directory.h"
 #include "utils/Filename.h"
 #include "utils/Url.h"
-#include "utils/ModificationsNotifier.h"
 #include "discoverer/FsDiscoverer.h"
 #include "discoverer/probe/PathProbe.h"
+#include "ResolutionCache.h"
+#include "native/TagReader.h"
 
 #include <cstdlib>
 
@@ -61,9 +64,9 @@ bool MetadataParser::initialize()
     return m_unknownArtist != nullptr;
 }
 
-int MetadataParser::toInt( VLC::Media& vlcMedia, libvlc_meta_t meta, const char* name )
+int MetadataParser::toInt( parser::Task& task, libvlc_meta_t meta, const char* name )
 {
-    auto str = vlcMedia.meta( meta );
+    auto str = task.meta( meta );
     if ( str.empty() == false )
     {
         try
@@ -81,7 +84,8 @@ int MetadataParser::toInt( VLC::Media& vlcMedia, libvlc_meta_t meta, const char*
 parser::Task::Status MetadataParser::run( parser::Task& task )
 {
     bool alreadyInParser = false;
-    int nbSubitem = task.vlcMedia.subitems()->count();
+    // Files read natively never have a libvlc media, and can't be playlists
+    int nbSubitem = task.vlcMedia.isValid() == true ? task.vlcMedia.subitems()->count() : 0;
     // Assume that file containing subitem(s) is a Playlist
     if ( nbSubitem > 0 )
     {
@@ -160,12 +164,12 @@ parser::Task::Status MetadataParser::run( parser::Task& task )
         return parser::Task::Status::Success;
     }
 
-    const auto& tracks = task.vlcMedia.tracks();
+    auto tracks = task.tags == nullptr ? task.vlcMedia.tracks() : std::vector<VLC::MediaTrack>{};
 
     // If we failed to extract any tracks, don't make any assumption and forward to the
     // thumbnailer. Since it starts an actual playback, it will have more information.
     // Since the metadata steps won't be marked, it will run again once the thumbnailer has completed.
-    if ( tracks.empty() == true )
+    if ( task.tags == nullptr && tracks.empty() == true )
     {
         // However, if the file is not unknown anymore, it means the thumbnailer has already processed it
         if ( task.media->type() == Media::Type::Unknown )
@@ -204,7 +208,12 @@ parser::Task::Status MetadataParser::run( parser::Task& task )
                                           track.language(), track.description() );
                 }
             }
-            task.media->setDuration( task.vlcMedia.duration() );
+            // The native tag reader only handles files with a single audio track
+            if ( task.tags != nullptr )
+                task.media->addAudioTrack( task.tags->codec, task.tags->bitrate,
+                                           task.tags->sampleRate, task.tags->nbChannels,
+                                           "", "" );
+            task.media->setDuration( task.duration() );
             t->commit();
         }, std::move( tracks ) );
     }
@@ -229,7 +238,7 @@ parser::Task::Status MetadataParser::run( parser::Task& task )
         task.markStepCompleted( parser::Task::ParserStep::Thumbnailer );
     if ( task.file->saveParserStep() == false )
         return parser::Task::Status::Fatal;
-    m_notifier->notifyMediaCreation( task.media );
+    task.mediaCreated = true;
     return parser::Task::Status::Success;
 }
 
@@ -239,7 +248,7 @@ bool MetadataParser::addPlaylistMedias( parser::Task& task, int nbSubitem ) cons
 {
     auto t = m_ml->getConn()->newTransaction();
     LOG_INFO( "Try to import ", task.mrl, " as a playlist" );
-    auto playlistName = task.vlcMedia.meta( libvlc_meta_Title );
+    auto playlistName = task.meta( libvlc_meta_Title );
     if ( playlistName.empty() == true )
         playlistName = utils::url::decode( utils::file::fileName( task.mrl ) );
     auto playlistPtr = Playlist::create( m_ml, playlistName );
@@ -343,11 +352,11 @@ bool MetadataParser::parseVideoFile( parser::Task& task ) const
 {
     auto media = task.media.get();
     media->setType( IMedia::Type::Video );
-    const auto& title = task.vlcMedia.meta( libvlc_meta_Title );
+    const auto& title = task.meta( libvlc_meta_Title );
     if ( title.length() == 0 )
         return true;
 
-    const auto& showName = task.vlcMedia.meta( libvlc_meta_ShowName );
+    const auto& showName = task.meta( libvlc_meta_ShowName );
 
     return sqlite::Tools::withRetries( 3, [this, &showName, &title, &task]() {
         auto t = m_ml->getConn()->newTransaction();
@@ -362,7 +371,7 @@ bool MetadataParser::parseVideoFile( parser::Task& task ) const
                 if ( show == nullptr )
                     return false;
             }
-            auto episode = toInt( task.vlcMedia, libvlc_meta_Episode, "episode number" );
+            auto episode = toInt( task, libvlc_meta_Episode, "episode number" );
             if ( episode != 0 )
             {
                 std::shared_ptr<Show> s = std::static_pointer_cast<Show>( show );
@@ -386,7 +395,7 @@ bool MetadataParser::parseAudioFile( parser::Task& task )
 {
     task.media->setType( IMedia::Type::Audio );
 
-    auto artworkMrl = task.vlcMedia.meta( libvlc_meta_ArtworkURL );
+    auto artworkMrl = task.meta( libvlc_meta_ArtworkURL );
     if ( artworkMrl.empty() == false )
     {
         task.media->setThumbnail( artworkMrl );
@@ -394,23 +403,37 @@ bool MetadataParser::parseAudioFile( parser::Task& task )
         if ( utils::file::schemeIs( "attachment", artworkMrl ) )
             artworkMrl.clear();
     }
-
+    // libvlc exposes the embedded artworks as attachments. When the file was
+    // read natively, copy it to the thumbnails folder instead
+    else if ( task.tags != nullptr && task.tags->artworkSize > 0 )
+    {
+        auto path = m_ml->thumbnailPath() + "/" + std::to_string( task.media->id() );
+        path = TagReader::extractArtwork( utils::file::toLocalPath( task.mrl ), *task.tags, path );
+        if ( path.empty() == false )
+            task.media->setThumbnail( path );
+    }
 
     auto genre = handleGenre( task );
     auto artists = findOrCreateArtist( task );
     if ( artists.first == nullptr && artists.second == nullptr )
         return false;
     auto album = findAlbum( task, artists.first, artists.second );
-    return sqlite::Tools::withRetries( 3, [this, &task, &artists]( std::string artworkMrl,
-                                                  std::shared_ptr<Album> album, std::shared_ptr<Genre> genre ) {
+    auto nbCreatedAlbums = task.createdAlbums.size();
+    auto nbCreatedTracks = task.createdTracks.size();
+    return sqlite::Tools::withRetries( 3, [this, &task, &artists, nbCreatedAlbums, nbCreatedTracks](
+                                       std::string artworkMrl, std::shared_ptr<Album> album,
+                                       std::shared_ptr<Genre> genre ) {
+        // Forget about the entities created by a previous, rolled back, attempt
+        task.createdAlbums.resize( nbCreatedAlbums );
+        task.createdTracks.resize( nbCreatedTracks );
         auto t = m_ml->getConn()->newTransaction();
         if ( album == nullptr )
         {
-            const auto& albumName = task.vlcMedia.meta( libvlc_meta_Album );
+            const auto& albumName = task.meta( libvlc_meta_Album );
             album = m_ml->createAlbum( albumName, artworkMrl );
             if ( album == nullptr )
                 return false;
-            m_notifier->notifyAlbumCreation( album );
+            task.createdAlbums.push_back( album );
         }
         // If we know a track artist, specify it, otherwise, fallback to the album/unknown artist
         auto track = handleTrack( album, task, artists.second ? artists.second : artists.first,
@@ -425,16 +448,25 @@ bool MetadataParser::parseAudioFile( parser::Task& task )
 
 std::shared_ptr<Genre> MetadataParser::handleGenre( parser::Task& task ) const
 {
-    const auto& genreStr = task.vlcMedia.meta( libvlc_meta_Genre );
+    const auto& genreStr = task.meta( libvlc_meta_Genre );
     if ( genreStr.length() == 0 )
         return nullptr;
-    auto genre = Genre::fromName( m_ml, genreStr );
+    auto& cache = m_ml->getResolutionCache();
+    uint32_t generation;
+    auto genre = cache.genre( genreStr, generation );
+    if ( genre != nullptr )
+        return genre;
+    genre = Genre::fromName( m_ml, genreStr );
     if ( genre == nullptr )
     {
         genre = Genre::create( m_ml, genreStr );
         if ( genre == nullptr )
+        {
             LOG_ERROR( "Failed to get/create Genre", genreStr );
+            return nullptr;
+        }
     }
+    cache.insertGenre( genre, generation );
     return genre;
 }
 
@@ -443,7 +475,7 @@ std::shared_ptr<Genre> MetadataParser::handleGenre( parser::Task& task ) const
 std::shared_ptr<Album> MetadataParser::findAlbum( parser::Task& task, std::shared_ptr<Artist> albumArtist,
                                                     std::shared_ptr<Artist> trackArtist )
 {
-    const auto& albumName = task.vlcMedia.meta( libvlc_meta_Album );
+    const auto& albumName = task.meta( libvlc_meta_Album );
     if ( albumName.empty() == true )
     {
         if ( albumArtist != nullptr )
@@ -463,13 +495,23 @@ std::shared_ptr<Album> MetadataParser::findAlbum( parser::Task& task, std::share
     // Specificaly pass the albumArtist here.
     static const std::string req = "SELECT * FROM " + policy::AlbumTable::Name +
             " WHERE title = ?";
-    auto albums = Album::fetchAll<Album>( m_ml, req, albumName );
+    // The candidates are cached by title only, since an album artist can
+    // change once a compilation gets detected. Their album artist is cached
+    // by each album.
+    auto& cache = m_ml->getResolutionCache();
+    std::vector<std::shared_ptr<Album>> albums;
+    uint32_t generation;
+    if ( cache.albums( albumName, albums, generation ) == false )
+    {
+        albums = Album::fetchAll<Album>( m_ml, req, albumName );
+        cache.insertAlbums( albumName, albums, generation );
+    }
 
     if ( albums.size() == 0 )
         return nullptr;
 
-    const auto discTotal = toInt( task.vlcMedia, libvlc_meta_DiscTotal, "disc total" );
-    const auto discNumber = toInt( task.vlcMedia, libvlc_meta_DiscNumber, "disc number" );
+    const auto discTotal = toInt( task, libvlc_meta_DiscTotal, "disc total" );
+    const auto discNumber = toInt( task, libvlc_meta_DiscNumber, "disc number" );
     /*
      * Even if we get only 1 album, we need to filter out invalid matches.
      * For instance, if we have already inserted an album "A" by an artist "john"
@@ -541,7 +583,7 @@ std::shared_ptr<Album> MetadataParser::findAlbum( parser::Task& task, std::share
              ( trackArtist != nullptr && candidateAlbumArtist != nullptr &&
                trackArtist->id() == candidateAlbumArtist->id() ) )
         {
-            auto candidateDate = task.vlcMedia.meta( libvlc_meta_Date );
+            auto candidateDate = task.meta( libvlc_meta_Date );
             if ( candidateDate.empty() == false )
             {
                 try
@@ -603,9 +645,11 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
     std::shared_ptr<Artist> albumArtist;
     std::shared_ptr<Artist> artist;
     static const std::string req = "SELECT * FROM " + policy::ArtistTable::Name + " WHERE name = ?";
+    auto& cache = m_ml->getResolutionCache();
+    uint32_t generation;
 
-    const auto& albumArtistStr = task.vlcMedia.meta( libvlc_meta_AlbumArtist );
-    const auto& artistStr = task.vlcMedia.meta( libvlc_meta_Artist );
+    const auto& albumArtistStr = task.meta( libvlc_meta_AlbumArtist );
+    const auto& artistStr = task.meta( libvlc_meta_Artist );
     if ( albumArtistStr.empty() == true && artistStr.empty() == true )
     {
         return {m_unknownArtist, m_unknownArtist};
@@ -613,7 +657,9 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
 
     if ( albumArtistStr.empty() == false )
     {
-        albumArtist = Artist::fetch( m_ml, req, albumArtistStr );
+        albumArtist = cache.artist( albumArtistStr, generation );
+        if ( albumArtist == nullptr )
+            albumArtist = Artist::fetch( m_ml, req, albumArtistStr );
         if ( albumArtist == nullptr )
         {
             albumArtist = m_ml->createArtist( albumArtistStr );
@@ -622,12 +668,15 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
                 LOG_ERROR( "Failed to create new artist ", albumArtistStr );
                 return {nullptr, nullptr};
             }
-            m_notifier->notifyArtistCreation( albumArtist );
+            task.createdArtists.push_back( albumArtist );
         }
+        cache.insertArtist( albumArtist, generation );
     }
     if ( artistStr.empty() == false && artistStr != albumArtistStr )
     {
-        artist = Artist::fetch( m_ml, req, artistStr );
+        artist = cache.artist( artistStr, generation );
+        if ( artist == nullptr )
+            artist = Artist::fetch( m_ml, req, artistStr );
         if ( artist == nullptr )
         {
             artist = m_ml->createArtist( artistStr );
@@ -636,8 +685,9 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
                 LOG_ERROR( "Failed to create new artist ", artistStr );
                 return {nullptr, nullptr};
             }
-            m_notifier->notifyArtistCreation( albumArtist );
+            task.createdArtists.push_back( artist );
         }
+        cache.insertArtist( artist, generation );
     }
     return {albumArtist, artist};
 }
@@ -647,9 +697,9 @@ std::pair<std::shared_ptr<Artist>, std::shared_ptr<Artist>> MetadataParser::find
 std::shared_ptr<AlbumTrack> MetadataParser::handleTrack( std::shared_ptr<Album> album, parser::Task& task,
                                                          std::shared_ptr<Artist> artist, Genre* genre ) const
 {
-    auto title = task.vlcMedia.meta( libvlc_meta_Title );
-    const auto trackNumber = toInt( task.vlcMedia, libvlc_meta_TrackNumber, "track number" );
-    const auto discNumber = toInt( task.vlcMedia, libvlc_meta_DiscNumber, "disc number" );
+    auto title = task.meta( libvlc_meta_Title );
+    const auto trackNumber = toInt( task, libvlc_meta_TrackNumber, "track number" );
+    const auto discNumber = toInt( task, libvlc_meta_DiscNumber, "disc number" );
     if ( title.empty() == true )
     {
         LOG_WARN( "Failed to get track title" );
@@ -671,7 +721,7 @@ std::shared_ptr<AlbumTrack> MetadataParser::handleTrack( std::shared_ptr<Album>
         return nullptr;
     }
 
-    const auto& releaseDate = task.vlcMedia.meta( libvlc_meta_Date );
+    const auto& releaseDate = task.meta( libvlc_meta_Date );
     if ( releaseDate.empty() == false )
     {
         auto releaseYear = atoi( releaseDate.c_str() );
@@ -681,7 +731,7 @@ std::shared_ptr<AlbumTrack> MetadataParser::handleTrack( std::shared_ptr<Album>
         // using Album class internals.
         album->setReleaseYear( releaseYear, false );
     }
-    m_notifier->notifyAlbumTrackCreation( track );
+    task.createdTracks.push_back( track );
     return track;
 }
 
@@ -767,6 +817,102 @@ void MetadataParser::flush()
     m_variousArtists = nullptr;
     m_previousAlbum = nullptr;
     m_previousFolderId = 0;
+    m_ml->getResolutionCache().clear();
+}
+
+uint32_t MetadataParser::maxBatchSize() const
+{
+    // This service only runs database operations, so we'd rather have them
+    // flushed together than having each file going through multiple fsync
+    return 32;
+}
+
+void MetadataParser::prepareBatch( std::vector<parser::Task*>& tasks )
+{
+    // Create the Media & File for all the newly discovered files of a folder
+    // with a single INSERT each, instead of 2 INSERT per file.
+    // Playlists and refreshed files are left for run() to handle
+    auto needsCreation = []( parser::Task* task ) {
+        return task->file == nullptr && task->fileFs != nullptr &&
+               task->parentFolder != nullptr && task->parentFolderFs != nullptr &&
+               ( task->vlcMedia.isValid() == false || task->vlcMedia.subitems()->count() == 0 );
+    };
+    for ( auto it = begin( tasks ); it != end( tasks ); )
+    {
+        if ( needsCreation( *it ) == false )
+        {
+            ++it;
+            continue;
+        }
+        // Files sharing the same folder are inserted together
+        auto folderId = (*it)->parentFolder->id();
+        auto isRemovable = (*it)->parentFolderFs->device()->isRemovable();
+        std::vector<parser::Task*> group;
+        for ( ; it != end( tasks ) && needsCreation( *it ) == true &&
+                (*it)->parentFolder->id() == folderId; ++it )
+            group.push_back( *it );
+
+        std::vector<std::string> fileNames;
+        std::vector<std::shared_ptr<fs::IFile>> filesFs;
+        fileNames.reserve( group.size() );
+        filesFs.reserve( group.size() );
+        for ( const auto task : group )
+        {
+            LOG_INFO( "Adding ", task->mrl );
+            fileNames.push_back( utils::file::fileName( task->mrl ) );
+            filesFs.push_back( task->fileFs );
+        }
+        try
+        {
+            auto t = m_ml->getConn()->newTransaction();
+            auto medias = Media::createBatch( m_ml, IMedia::Type::Unknown, fileNames );
+            if ( medias.size() != group.size() )
+                continue;
+            std::vector<int64_t> mediaIds;
+            mediaIds.reserve( medias.size() );
+            for ( const auto& m : medias )
+                mediaIds.push_back( m->id() );
+            auto files = File::createBatch( m_ml, mediaIds, File::Type::Main, filesFs,
+                                            folderId, isRemovable );
+            if ( files.size() != group.size() )
+                continue;
+            t->commit();
+            for ( auto i = 0u; i < group.size(); ++i )
+            {
+                group[i]->media = std::move( medias[i] );
+                group[i]->file = std::move( files[i] );
+                // Synchronize file step tracker with task
+                group[i]->markStepCompleted( group[i]->step );
+            }
+        }
+        catch ( const sqlite::errors::Generic& ex )
+        {
+            // Most likely a duplicated task. run() will sort it out for each
+            // file individually
+            LOG_INFO( "Failed to create ", group.size(), " media & files at once: ",
+                      ex.what(), ". Falling back to individual creations" );
+        }
+    }
+}
+
+void MetadataParser::onBatchRolledBack()
+{
+    // Those might have been created as part of the rolled back batch
+    m_variousArtists = nullptr;
+    m_previousAlbum = nullptr;
+    m_previousFolderId = 0;
+    m_ml->getResolutionCache().clear();
+    // The cached instances of the entities the batch updated still hold the
+    // rolled back changes. We don't know which ones were updated, but this
+    // is a rare occurrence, so drop them all.
+    Album::clear();
+    AlbumTrack::clear();
+    Artist::clear();
+    Genre::clear();
+    Show::clear();
+    ShowEpisode::clear();
+    Movie::clear();
+    Playlist::clear();
 }
 
 bool MetadataParser::isCompleted( const parser::Task& task ) const
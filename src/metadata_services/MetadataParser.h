@@ -42,6 +42,9 @@ protected:
     virtual uint8_t nbThreads() const override;
     virtual void flush() override;
     bool isCompleted( const parser::Task& task ) const override;
+    virtual uint32_t maxBatchSize() const override;
+    virtual void prepareBatch( std::vector<parser::Task*>& tasks ) override;
+    virtual void onBatchRolledBack() override;
 
     bool addPlaylistMedias( parser::Task& task, int nbSubitem ) const;
     void addPlaylistElement( parser::Task& task, const std::shared_ptr<Playlist>& playlistPtr,
@@ -57,7 +60,7 @@ protected:
     std::shared_ptr<Genre> handleGenre( parser::Task& task ) const;
 
 private:
-    static int toInt( VLC::Media& vlcMedia, libvlc_meta_t meta, const char* name );
+    static int toInt( parser::Task& task, libvlc_meta_t meta, const char* name );
 
 private:
     std::shared_ptr<Artist> m_unknownArtist;
@@ -0,0 +1,167 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "ResolutionCache.h"
+
+#include "Album.h"
+#include "Artist.h"
+#include "Genre.h"
+
+namespace medialibrary
+{
+
+namespace
+{
+
+template <typename T>
+std::shared_ptr<T> lookup( const std::unordered_map<std::string, std::shared_ptr<T>>& map,
+                           const std::string& key )
+{
+    auto it = map.find( key );
+    if ( it == end( map ) )
+        return nullptr;
+    return it->second;
+}
+
+template <typename T>
+void remove( std::unordered_map<std::string, T>& map,
+             std::unordered_map<int64_t, std::string>& keys, int64_t id )
+{
+    auto it = keys.find( id );
+    if ( it == end( keys ) )
+        return;
+    map.erase( it->second );
+    keys.erase( it );
+}
+
+}
+
+ResolutionCache::ResolutionCache()
+    : m_generation( 0 )
+{
+}
+
+std::shared_ptr<Genre> ResolutionCache::genre( const std::string& name, uint32_t& generation ) const
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    generation = m_generation;
+    return lookup( m_genres, name );
+}
+
+void ResolutionCache::insertGenre( std::shared_ptr<Genre> genre, uint32_t generation )
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    if ( generation != m_generation )
+        return;
+    const auto& name = genre->name();
+    m_genreNames[genre->id()] = name;
+    m_genres[name] = std::move( genre );
+}
+
+std::shared_ptr<Artist> ResolutionCache::artist( const std::string& name, uint32_t& generation ) const
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    generation = m_generation;
+    return lookup( m_artists, name );
+}
+
+void ResolutionCache::insertArtist( std::shared_ptr<Artist> artist, uint32_t generation )
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    if ( generation != m_generation )
+        return;
+    const auto& name = artist->name();
+    m_artistNames[artist->id()] = name;
+    m_artists[name] = std::move( artist );
+}
+
+bool ResolutionCache::albums( const std::string& title, std::vector<std::shared_ptr<Album>>& albums,
+                              uint32_t& generation ) const
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    generation = m_generation;
+    auto it = m_albums.find( title );
+    if ( it == end( m_albums ) )
+        return false;
+    albums = it->second;
+    return true;
+}
+
+void ResolutionCache::insertAlbums( const std::string& title,
+                                    std::vector<std::shared_ptr<Album>> albums,
+                                    uint32_t generation )
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    if ( generation != m_generation )
+        return;
+    for ( const auto& a : albums )
+        m_albumTitles[a->id()] = title;
+    m_albums[title] = std::move( albums );
+}
+
+void ResolutionCache::onGenreDeleted( int64_t genreId )
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    ++m_generation;
+    remove( m_genres, m_genreNames, genreId );
+}
+
+void ResolutionCache::onArtistDeleted( int64_t artistId )
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    ++m_generation;
+    remove( m_artists, m_artistNames, artistId );
+}
+
+void ResolutionCache::onAlbumInserted()
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    ++m_generation;
+    m_albums.clear();
+    m_albumTitles.clear();
+}
+
+void ResolutionCache::onAlbumDeleted( int64_t albumId )
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    ++m_generation;
+    // The other albums sharing this title are fetched again along with it
+    remove( m_albums, m_albumTitles, albumId );
+}
+
+void ResolutionCache::clear()
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    ++m_generation;
+    m_genres.clear();
+    m_genreNames.clear();
+    m_artists.clear();
+    m_artistNames.clear();
+    m_albums.clear();
+    m_albumTitles.clear();
+}
+
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compat/Mutex.h"
+
+namespace medialibrary
+{
+
+class Album;
+class Artist;
+class Genre;
+
+/**
+ * @brief ResolutionCache maps the genre & artist names, and the album titles,
+ *        found in the files metadata to their database entities.
+ *
+ * Only the entities themselves are kept, so the changes made to them are
+ * visible through the cache, while their deletion is reported through the
+ * sqlite update hooks. Since no request can be run from a hook, and since an
+ * insertion doesn't tell which title it is about, a new album evicts all the
+ * cached album titles.
+ *
+ * The lookups are made without holding the cache lock while the database is
+ * queried: a lookup returns a generation, which the matching insertion checks,
+ * so an entity deleted in the meantime doesn't get cached.
+ */
+class ResolutionCache
+{
+public:
+    ResolutionCache();
+
+    std::shared_ptr<Genre> genre( const std::string& name, uint32_t& generation ) const;
+    void insertGenre( std::shared_ptr<Genre> genre, uint32_t generation );
+    std::shared_ptr<Artist> artist( const std::string& name, uint32_t& generation ) const;
+    void insertArtist( std::shared_ptr<Artist> artist, uint32_t generation );
+    /**
+     * @brief albums Fetches all the albums with the provided title, if they
+     *               are cached.
+     * @return true if the title was cached, even if there's no such album.
+     */
+    bool albums( const std::string& title, std::vector<std::shared_ptr<Album>>& albums,
+                 uint32_t& generation ) const;
+    void insertAlbums( const std::string& title, std::vector<std::shared_ptr<Album>> albums,
+                       uint32_t generation );
+
+    /// To be called from the sqlite update hooks
+    void onGenreDeleted( int64_t genreId );
+    void onArtistDeleted( int64_t artistId );
+    void onAlbumInserted();
+    void onAlbumDeleted( int64_t albumId );
+
+    void clear();
+
+private:
+    mutable compat::Mutex m_lock;
+    uint32_t m_generation;
+    std::unordered_map<std::string, std::shared_ptr<Genre>> m_genres;
+    std::unordered_map<int64_t, std::string> m_genreNames;
+    std::unordered_map<std::string, std::shared_ptr<Artist>> m_artists;
+    std::unordered_map<int64_t, std::string> m_artistNames;
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Album>>> m_albums;
+    std::unordered_map<int64_t, std::string> m_albumTitles;
+};
+
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "NativeTagService.h"
+#include "TagReader.h"
+#include "logging/Logger.h"
+#include "utils/Filename.h"
+
+namespace medialibrary
+{
+
+parser::Task::Status NativeTagService::run( parser::Task& task )
+{
+    // Anything we can't handle is left for the VLC metadata service to process
+    if ( utils::file::schemeIs( "file://", task.mrl ) == false ||
+         TagReader::isSupported( utils::file::extension( task.mrl ) ) == false )
+        return parser::Task::Status::Success;
+    task.tags = TagReader::read( utils::file::toLocalPath( task.mrl ) );
+    if ( task.tags == nullptr )
+    {
+        LOG_INFO( "Falling back to libvlc to parse ", task.mrl );
+        return parser::Task::Status::Success;
+    }
+    task.markStepCompleted( parser::Task::ParserStep::MetadataExtraction );
+    return parser::Task::Status::Success;
+}
+
+const char* NativeTagService::name() const
+{
+    return "NativeTags";
+}
+
+uint8_t NativeTagService::nbThreads() const
+{
+    return nbNativeThreads();
+}
+
+bool NativeTagService::isCompleted( const parser::Task& task ) const
+{
+    // Once the media was parsed by libvlc, there's nothing left to do for us
+    return task.tags != nullptr || task.vlcMedia.isValid() == true;
+}
+
+}
@@ -0,0 +1,46 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include "parser/ParserService.h"
+
+namespace medialibrary
+{
+
+/**
+ * @brief NativeTagService reads the tags of the common audio files without libvlc
+ *
+ * This service runs before the VLC metadata service. When it successfully
+ * reads a file, the libvlc preparsing is skipped. Otherwise, the task is left
+ * untouched and the VLC metadata service will handle it.
+ */
+class NativeTagService : public ParserService
+{
+private:
+    virtual parser::Task::Status run( parser::Task& task ) override;
+    virtual const char* name() const override;
+    virtual uint8_t nbThreads() const override;
+    virtual bool isCompleted( const parser::Task& task ) const override;
+};
+
+}
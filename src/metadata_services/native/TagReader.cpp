@@ -0,0 +1,1313 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "TagReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+# include "utils/Charsets.h"
+#else
+# include <cerrno>
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "logging/Logger.h"
+
+namespace medialibrary
+{
+
+namespace
+{
+
+// Text frames & comments larger than this are assumed to be corrupted
+constexpr uint32_t MaxTextSize = 64 * 1024;
+// Vorbis comment blocks can embed pictures, but we don't need those
+constexpr uint32_t MaxCommentSize = 4 * 1024 * 1024;
+// The distance in which we look for the first MPEG audio frame
+constexpr uint32_t MaxMpegSyncDistance = 64 * 1024;
+// Larger artworks are assumed to be corrupted
+constexpr uint64_t MaxArtworkSize = 16 * 1024 * 1024;
+// Maximum depth of MP4 atoms we will walk through
+constexpr unsigned int MaxAtomDepth = 8;
+
+/*
+ * Reads arbitrary ranges of a file. Positional reads are used so that no file
+ * position needs to be maintained.
+ */
+class FileReader
+{
+public:
+    explicit FileReader( const std::string& path );
+    ~FileReader();
+    FileReader( const FileReader& ) = delete;
+    FileReader& operator=( const FileReader& ) = delete;
+
+    bool isValid() const;
+    uint64_t size() const
+    {
+        return m_size;
+    }
+    /// Reads exactly size bytes starting at offset
+    bool read( uint64_t offset, void* buffer, size_t size ) const;
+    bool read( uint64_t offset, std::vector<uint8_t>& buffer, size_t size ) const
+    {
+        buffer.resize( size );
+        return read( offset, buffer.data(), size );
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE m_handle;
+#else
+    int m_fd;
+#endif
+    uint64_t m_size;
+};
+
+#ifdef _WIN32
+
+FileReader::FileReader( const std::string& path )
+    : m_handle( INVALID_HANDLE_VALUE )
+    , m_size( 0 )
+{
+    auto wpath = charset::ToWide( path.c_str() );
+    if ( wpath == nullptr )
+        return;
+    m_handle = CreateFileW( wpath.get(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    LARGE_INTEGER size;
+    if ( m_handle != INVALID_HANDLE_VALUE && GetFileSizeEx( m_handle, &size ) != 0 )
+        m_size = size.QuadPart;
+}
+
+FileReader::~FileReader()
+{
+    if ( m_handle != INVALID_HANDLE_VALUE )
+        CloseHandle( m_handle );
+}
+
+bool FileReader::isValid() const
+{
+    return m_handle != INVALID_HANDLE_VALUE;
+}
+
+bool FileReader::read( uint64_t offset, void* buffer, size_t size ) const
+{
+    if ( offset > m_size || size > m_size - offset )
+        return false;
+    auto buff = static_cast<uint8_t*>( buffer );
+    while ( size > 0 )
+    {
+        OVERLAPPED ov;
+        memset( &ov, 0, sizeof( ov ) );
+        ov.Offset = static_cast<DWORD>( offset & 0xFFFFFFFF );
+        ov.OffsetHigh = static_cast<DWORD>( offset >> 32 );
+        DWORD nbRead;
+        if ( ReadFile( m_handle, buff, static_cast<DWORD>( size ), &nbRead, &ov ) == 0 ||
+             nbRead == 0 )
+            return false;
+        buff += nbRead;
+        offset += nbRead;
+        size -= nbRead;
+    }
+    return true;
+}
+
+#else
+
+FileReader::FileReader( const std::string& path )
+    : m_fd( open( path.c_str(), O_RDONLY ) )
+    , m_size( 0 )
+{
+    struct stat st;
+    if ( m_fd >= 0 && fstat( m_fd, &st ) == 0 )
+        m_size = st.st_size;
+}
+
+FileReader::~FileReader()
+{
+    if ( m_fd >= 0 )
+        close( m_fd );
+}
+
+bool FileReader::isValid() const
+{
+    return m_fd >= 0;
+}
+
+bool FileReader::read( uint64_t offset, void* buffer, size_t size ) const
+{
+    if ( offset > m_size || size > m_size - offset )
+        return false;
+    auto buff = static_cast<uint8_t*>( buffer );
+    while ( size > 0 )
+    {
+        auto nbRead = pread( m_fd, buff, size, static_cast<off_t>( offset ) );
+        if ( nbRead < 0 && errno == EINTR )
+            continue;
+        if ( nbRead <= 0 )
+            return false;
+        buff += nbRead;
+        offset += nbRead;
+        size -= nbRead;
+    }
+    return true;
+}
+
+#endif
+
+/* Helpers */
+
+uint16_t be16( const uint8_t* p )
+{
+    return static_cast<uint16_t>( p[0] << 8 | p[1] );
+}
+
+uint32_t be24( const uint8_t* p )
+{
+    return static_cast<uint32_t>( p[0] ) << 16 | p[1] << 8 | p[2];
+}
+
+uint32_t be32( const uint8_t* p )
+{
+    return static_cast<uint32_t>( p[0] ) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+uint64_t be64( const uint8_t* p )
+{
+    return static_cast<uint64_t>( be32( p ) ) << 32 | be32( p + 4 );
+}
+
+uint16_t le16( const uint8_t* p )
+{
+    return static_cast<uint16_t>( p[1] << 8 | p[0] );
+}
+
+uint32_t le32( const uint8_t* p )
+{
+    return static_cast<uint32_t>( p[3] ) << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+uint64_t le64( const uint8_t* p )
+{
+    return static_cast<uint64_t>( le32( p + 4 ) ) << 32 | le32( p );
+}
+
+uint32_t syncSafe32( const uint8_t* p )
+{
+    return ( p[0] & 0x7F ) << 21 | ( p[1] & 0x7F ) << 14 | ( p[2] & 0x7F ) << 7 | ( p[3] & 0x7F );
+}
+
+void appendUtf8( std::string& out, uint32_t cp )
+{
+    if ( cp < 0x80 )
+        out += static_cast<char>( cp );
+    else if ( cp < 0x800 )
+    {
+        out += static_cast<char>( 0xC0 | cp >> 6 );
+        out += static_cast<char>( 0x80 | ( cp & 0x3F ) );
+    }
+    else if ( cp < 0x10000 )
+    {
+        out += static_cast<char>( 0xE0 | cp >> 12 );
+        out += static_cast<char>( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+        out += static_cast<char>( 0x80 | ( cp & 0x3F ) );
+    }
+    else
+    {
+        out += static_cast<char>( 0xF0 | cp >> 18 );
+        out += static_cast<char>( 0x80 | ( ( cp >> 12 ) & 0x3F ) );
+        out += static_cast<char>( 0x80 | ( ( cp >> 6 ) & 0x3F ) );
+        out += static_cast<char>( 0x80 | ( cp & 0x3F ) );
+    }
+}
+
+// Removes the trailing NUL characters & spaces some taggers use as padding
+std::string trim( std::string str )
+{
+    auto pos = str.find( '\0' );
+    if ( pos != std::string::npos )
+        str.erase( pos );
+    while ( str.empty() == false && str.back() == ' ' )
+        str.pop_back();
+    return str;
+}
+
+std::string latin1ToUtf8( const uint8_t* p, size_t size )
+{
+    std::string res;
+    res.reserve( size );
+    for ( auto i = 0u; i < size && p[i] != 0; ++i )
+        appendUtf8( res, p[i] );
+    return res;
+}
+
+std::string utf16ToUtf8( const uint8_t* p, size_t size, bool bigEndian )
+{
+    std::string res;
+    res.reserve( size / 2 );
+    for ( auto i = 0u; i + 1 < size; i += 2 )
+    {
+        uint32_t cu = bigEndian ? be16( p + i ) : le16( p + i );
+        if ( cu == 0 )
+            break;
+        if ( cu >= 0xD800 && cu < 0xDC00 && i + 3 < size )
+        {
+            uint32_t low = bigEndian ? be16( p + i + 2 ) : le16( p + i + 2 );
+            if ( low >= 0xDC00 && low < 0xE000 )
+            {
+                cu = 0x10000 + ( ( cu - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+                i += 2;
+            }
+        }
+        appendUtf8( res, cu );
+    }
+    return res;
+}
+
+// Parses a "n" or "n/total" string
+void parseNumber( const std::string& str, uint32_t& number, uint32_t* total )
+{
+    number = static_cast<uint32_t>( strtoul( str.c_str(), nullptr, 10 ) );
+    auto pos = str.find( '/' );
+    if ( total != nullptr && pos != std::string::npos )
+        *total = static_cast<uint32_t>( strtoul( str.c_str() + pos + 1, nullptr, 10 ) );
+}
+
+void setIfEmpty( std::string& field, std::string value )
+{
+    if ( field.empty() == true )
+        field = trim( std::move( value ) );
+}
+
+const char* const Id3Genres[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge",
+    "Hip-Hop", "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B",
+    "Rap", "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska",
+    "Death Metal", "Pranks", "Soundtrack", "Euro-Techno", "Ambient",
+    "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance", "Classical",
+    "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "AlternRock", "Bass", "Soul", "Punk", "Space", "Meditative",
+    "Instrumental Pop", "Instrumental Rock", "Ethnic", "Gothic", "Darkwave",
+    "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap",
+    "Pop/Funk", "Jungle", "Native American", "Cabaret", "New Wave",
+    "Psychadelic", "Rave", "Showtunes", "Trailer", "Lo-Fi", "Tribal",
+    "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll",
+    "Hard Rock", "Folk", "Folk-Rock", "National Folk", "Swing",
+    "Fast Fusion", "Bebob", "Latin", "Revival", "Celtic", "Bluegrass",
+    "Avantgarde", "Gothic Rock", "Progressive Rock", "Psychedelic Rock",
+    "Symphonic Rock", "Slow Rock", "Big Band", "Chorus", "Easy Listening",
+    "Acoustic", "Humour", "Speech", "Chanson", "Opera", "Chamber Music",
+    "Sonata", "Symphony", "Booty Bass", "Primus", "Porn Groove", "Satire",
+    "Slow Jam", "Club", "Tango", "Samba", "Folklore", "Ballad",
+    "Power Ballad", "Rhythmic Soul", "Freestyle", "Duet", "Punk Rock",
+    "Drum Solo", "A capella", "Euro-House", "Dance Hall",
+};
+
+std::string id3Genre( uint32_t index )
+{
+    if ( index >= sizeof( Id3Genres ) / sizeof( Id3Genres[0] ) )
+        return {};
+    return Id3Genres[index];
+}
+
+/* ID3 & MPEG audio */
+
+std::string id3Text( const uint8_t* p, size_t size )
+{
+    if ( size < 1 )
+        return {};
+    auto encoding = p[0];
+    ++p;
+    --size;
+    switch ( encoding )
+    {
+        case 0:
+            return latin1ToUtf8( p, size );
+        case 1:
+            if ( size >= 2 && p[0] == 0xFE && p[1] == 0xFF )
+                return utf16ToUtf8( p + 2, size - 2, true );
+            if ( size >= 2 && p[0] == 0xFF && p[1] == 0xFE )
+                return utf16ToUtf8( p + 2, size - 2, false );
+            return utf16ToUtf8( p, size, false );
+        case 2:
+            return utf16ToUtf8( p, size, true );
+        case 3:
+            return std::string( reinterpret_cast<const char*>( p ),
+                                strnlen( reinterpret_cast<const char*>( p ), size ) );
+        default:
+            return {};
+    }
+}
+
+// Handles the "(17)", "(17)Rock", "17", "RX" & "CR" forms of the TCON frame
+std::string id3v2Genre( const std::string& genre )
+{
+    if ( genre.empty() == true )
+        return genre;
+    if ( genre[0] == '(' )
+    {
+        auto end = genre.find( ')' );
+        if ( end != std::string::npos )
+        {
+            if ( end + 1 < genre.size() )
+                return genre.substr( end + 1 );
+            return id3v2Genre( genre.substr( 1, end - 1 ) );
+        }
+    }
+    if ( std::all_of( begin( genre ), end( genre ), ::isdigit ) == true )
+        return id3Genre( static_cast<uint32_t>( atoi( genre.c_str() ) ) );
+    if ( genre == "RX" )
+        return "Remix";
+    if ( genre == "CR" )
+        return "Cover";
+    return genre;
+}
+
+// Returns the offset following the NUL terminator of a string in the provided encoding
+size_t id3SkipString( const uint8_t* p, size_t size, uint8_t encoding )
+{
+    if ( encoding == 1 || encoding == 2 )
+    {
+        for ( auto i = 0u; i + 1 < size; i += 2 )
+        {
+            if ( p[i] == 0 && p[i + 1] == 0 )
+                return i + 2;
+        }
+        return size;
+    }
+    auto end = static_cast<const uint8_t*>( memchr( p, 0, size ) );
+    return end == nullptr ? size : end - p + 1;
+}
+
+// A front cover replaces any other picture, but we otherwise keep the first one
+void id3Picture( const FileReader& reader, uint64_t offset, uint32_t size,
+                 bool v22, AudioTags& tags, bool& hasFrontCover )
+{
+    if ( hasFrontCover == true )
+        return;
+    std::vector<uint8_t> buff;
+    auto headerSize = std::min<uint32_t>( size, 1024 );
+    if ( reader.read( offset, buff, headerSize ) == false || headerSize < 4 )
+        return;
+    auto encoding = buff[0];
+    size_t pos = 1;
+    std::string mimeType;
+    if ( v22 == true )
+    {
+        std::string format( reinterpret_cast<const char*>( &buff[1] ), 3 );
+        mimeType = format == "PNG" ? "image/png" : "image/jpeg";
+        pos = 4;
+    }
+    else
+    {
+        auto len = id3SkipString( &buff[pos], headerSize - pos, 0 );
+        mimeType = latin1ToUtf8( &buff[pos], len );
+        pos += len;
+    }
+    if ( pos >= headerSize )
+        return;
+    auto pictureType = buff[pos++];
+    pos += id3SkipString( &buff[pos], headerSize - pos, encoding );
+    if ( pos >= headerSize )
+        return;
+    if ( tags.artworkSize > 0 && pictureType != 3 )
+        return;
+    if ( mimeType.find( '/' ) == std::string::npos )
+        mimeType = "image/" + mimeType;
+    tags.artworkOffset = offset + pos;
+    tags.artworkSize = size - pos;
+    tags.artworkMimeType = std::move( mimeType );
+    hasFrontCover = pictureType == 3;
+}
+
+void id3Frame( const FileReader& reader, const std::string& id, uint64_t offset,
+               uint32_t size, bool v22, AudioTags& tags, bool& hasFrontCover )
+{
+    if ( id == "APIC" || id == "PIC" )
+    {
+        id3Picture( reader, offset, size, v22, tags, hasFrontCover );
+        return;
+    }
+    if ( size > MaxTextSize || id[0] != 'T' )
+        return;
+    std::vector<uint8_t> buff;
+    if ( reader.read( offset, buff, size ) == false )
+        return;
+    if ( id == "TIT2" || id == "TT2" )
+        setIfEmpty( tags.title, id3Text( buff.data(), size ) );
+    else if ( id == "TPE1" || id == "TP1" )
+        setIfEmpty( tags.artist, id3Text( buff.data(), size ) );
+    else if ( id == "TPE2" || id == "TP2" )
+        setIfEmpty( tags.albumArtist, id3Text( buff.data(), size ) );
+    else if ( id == "TALB" || id == "TAL" )
+        setIfEmpty( tags.album, id3Text( buff.data(), size ) );
+    else if ( id == "TCON" || id == "TCO" )
+        setIfEmpty( tags.genre, id3v2Genre( id3Text( buff.data(), size ) ) );
+    else if ( id == "TYER" || id == "TYE" || id == "TDRC" )
+        setIfEmpty( tags.date, id3Text( buff.data(), size ) );
+    else if ( id == "TRCK" || id == "TRK" )
+        parseNumber( id3Text( buff.data(), size ), tags.trackNumber, nullptr );
+    else if ( id == "TPOS" || id == "TPA" )
+        parseNumber( id3Text( buff.data(), size ), tags.discNumber, &tags.discTotal );
+}
+
+/*
+ * Reads an ID3v2 tag starting at offset, if any.
+ * Returns the offset following the tag, or the provided offset when there's
+ * no tag.
+ */
+uint64_t readId3v2( const FileReader& reader, uint64_t offset, AudioTags& tags )
+{
+    uint8_t header[10];
+    if ( reader.read( offset, header, sizeof( header ) ) == false ||
+         memcmp( header, "ID3", 3 ) != 0 )
+        return offset;
+    auto major = header[3];
+    auto flags = header[5];
+    auto tagSize = syncSafe32( header + 6 );
+    auto tagEnd = offset + sizeof( header ) + tagSize;
+    auto end = tagEnd + ( flags & 0x10 ? 10 : 0 );
+    // Tag level unsynchronisation would require us to decode the whole tag
+    if ( major < 2 || major > 4 || ( flags & 0x80 ) != 0 )
+    {
+        LOG_INFO( "Skipping unsupported ID3v2.", major, " tag" );
+        return end;
+    }
+    auto pos = offset + sizeof( header );
+    if ( ( flags & 0x40 ) != 0 && major >= 3 )
+    {
+        uint8_t ext[4];
+        if ( reader.read( pos, ext, sizeof( ext ) ) == false )
+            return end;
+        pos += major == 4 ? syncSafe32( ext ) : be32( ext ) + 4;
+    }
+    const auto v22 = major == 2;
+    const auto frameHeaderSize = v22 ? 6u : 10u;
+    auto hasFrontCover = false;
+    while ( pos + frameHeaderSize <= tagEnd )
+    {
+        uint8_t fh[10];
+        if ( reader.read( pos, fh, frameHeaderSize ) == false || fh[0] == 0 )
+            break;
+        std::string id( reinterpret_cast<const char*>( fh ), v22 ? 3 : 4 );
+        uint32_t frameSize;
+        bool unsupported = false;
+        if ( v22 == true )
+            frameSize = be24( fh + 3 );
+        else if ( major == 3 )
+        {
+            frameSize = be32( fh + 4 );
+            // Compression, encryption & grouping
+            unsupported = ( fh[9] & 0xE0 ) != 0;
+        }
+        else
+        {
+            frameSize = syncSafe32( fh + 4 );
+            // Grouping, compression, encryption, unsynchronisation & data length
+            unsupported = ( fh[9] & 0x4F ) != 0;
+        }
+        auto data = pos + frameHeaderSize;
+        pos = data + frameSize;
+        if ( pos > tagEnd )
+            break;
+        if ( unsupported == false && frameSize > 0 )
+            id3Frame( reader, id, data, frameSize, v22, tags, hasFrontCover );
+    }
+    return end;
+}
+
+/*
+ * Reads an ID3v1 tag at the end of the file, if any, and only uses it to fill
+ * the fields the ID3v2 tag didn't provide.
+ * Returns the size of the tag.
+ */
+uint64_t readId3v1( const FileReader& reader, AudioTags& tags )
+{
+    uint8_t tag[128];
+    if ( reader.size() < sizeof( tag ) ||
+         reader.read( reader.size() - sizeof( tag ), tag, sizeof( tag ) ) == false ||
+         memcmp( tag, "TAG", 3 ) != 0 )
+        return 0;
+    setIfEmpty( tags.title, latin1ToUtf8( tag + 3, 30 ) );
+    setIfEmpty( tags.artist, latin1ToUtf8( tag + 33, 30 ) );
+    setIfEmpty( tags.album, latin1ToUtf8( tag + 63, 30 ) );
+    setIfEmpty( tags.date, latin1ToUtf8( tag + 93, 4 ) );
+    // ID3v1.1 stores the track number in the last byte of the comment
+    if ( tags.trackNumber == 0 && tag[125] == 0 && tag[126] != 0 )
+        tags.trackNumber = tag[126];
+    setIfEmpty( tags.genre, id3Genre( tag[127] ) );
+    return sizeof( tag );
+}
+
+struct MpegHeader
+{
+    uint32_t bitrate;
+    uint32_t sampleRate;
+    uint32_t nbChannels;
+    uint32_t samplesPerFrame;
+    uint32_t frameSize;
+    // Offset of the Xing header, relative to the frame start
+    uint32_t xingOffset;
+};
+
+bool parseMpegHeader( const uint8_t* p, MpegHeader& h )
+{
+    static const uint16_t bitrates[5][15] = {
+        // MPEG-1 layer I, II & III
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+        // MPEG-2 & 2.5 layer I, then II & III
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    };
+    static const uint32_t sampleRates[3] = { 44100, 48000, 32000 };
+
+    if ( p[0] != 0xFF || ( p[1] & 0xE0 ) != 0xE0 )
+        return false;
+    auto version = ( p[1] >> 3 ) & 3; // 0: MPEG-2.5, 2: MPEG-2, 3: MPEG-1
+    auto layer = 4 - ( ( p[1] >> 1 ) & 3 );
+    auto bitrateIdx = p[2] >> 4;
+    auto sampleRateIdx = ( p[2] >> 2 ) & 3;
+    if ( version == 1 || layer == 4 || bitrateIdx == 0 || bitrateIdx == 15 ||
+         sampleRateIdx == 3 )
+        return false;
+    auto mpeg1 = version == 3;
+    auto padding = ( p[2] >> 1 ) & 1;
+    auto mono = ( p[3] >> 6 ) == 3;
+    auto table = mpeg1 ? layer - 1 : ( layer == 1 ? 3 : 4 );
+    h.bitrate = bitrates[table][bitrateIdx] * 1000;
+    h.sampleRate = sampleRates[sampleRateIdx] >> ( mpeg1 ? 0 : ( version == 2 ? 1 : 2 ) );
+    h.nbChannels = mono ? 1 : 2;
+    if ( layer == 1 )
+    {
+        h.samplesPerFrame = 384;
+        h.frameSize = ( 12 * h.bitrate / h.sampleRate + padding ) * 4;
+    }
+    else
+    {
+        h.samplesPerFrame = layer == 3 && mpeg1 == false ? 576 : 1152;
+        h.frameSize = h.samplesPerFrame / 8 * h.bitrate / h.sampleRate + padding;
+    }
+    if ( mpeg1 == true )
+        h.xingOffset = 4 + ( mono ? 17 : 32 );
+    else
+        h.xingOffset = 4 + ( mono ? 9 : 17 );
+    return h.frameSize > 4;
+}
+
+bool readMpeg( const FileReader& reader, AudioTags& tags )
+{
+    auto audioStart = readId3v2( reader, 0, tags );
+    auto audioEnd = reader.size() - readId3v1( reader, tags );
+    if ( audioStart >= audioEnd )
+        return false;
+
+    std::vector<uint8_t> buff;
+    auto toRead = std::min<uint64_t>( audioEnd - audioStart, MaxMpegSyncDistance );
+    if ( reader.read( audioStart, buff, toRead ) == false )
+        return false;
+    MpegHeader h;
+    size_t pos = 0;
+    for ( ; pos + 4 <= buff.size(); ++pos )
+    {
+        if ( parseMpegHeader( &buff[pos], h ) == false )
+            continue;
+        // Require the next frame to start where expected, to avoid false syncs
+        MpegHeader next;
+        uint8_t nextHeader[4];
+        auto nextOffset = audioStart + pos + h.frameSize;
+        if ( nextOffset + 4 > audioEnd ||
+             ( reader.read( nextOffset, nextHeader, 4 ) == true &&
+               parseMpegHeader( nextHeader, next ) == true &&
+               next.sampleRate == h.sampleRate ) )
+            break;
+    }
+    if ( pos + 4 > buff.size() )
+        return false;
+    auto frameStart = audioStart + pos;
+    tags.codec = "mpga";
+    tags.sampleRate = h.sampleRate;
+    tags.nbChannels = h.nbChannels;
+    tags.bitrate = h.bitrate;
+
+    uint8_t xing[16];
+    uint32_t nbFrames = 0;
+    if ( reader.read( frameStart + h.xingOffset, xing, sizeof( xing ) ) == true &&
+         ( memcmp( xing, "Xing", 4 ) == 0 || memcmp( xing, "Info", 4 ) == 0 ) &&
+         ( be32( xing + 4 ) & 1 ) != 0 )
+        nbFrames = be32( xing + 8 );
+    else if ( reader.read( frameStart + 36, xing, sizeof( xing ) ) == true &&
+              memcmp( xing, "VBRI", 4 ) == 0 )
+        nbFrames = be32( xing + 14 );
+
+    auto audioSize = audioEnd - frameStart;
+    if ( nbFrames > 0 )
+    {
+        tags.duration = static_cast<int64_t>( nbFrames ) * h.samplesPerFrame * 1000 /
+                h.sampleRate;
+        if ( tags.duration > 0 )
+            tags.bitrate = static_cast<uint32_t>( audioSize * 8 * 1000 / tags.duration );
+    }
+    else
+        tags.duration = static_cast<int64_t>( audioSize * 8 * 1000 / h.bitrate );
+    return true;
+}
+
+/* Vorbis comments, used by FLAC & Ogg */
+
+bool iequals( const std::string& a, const char* b )
+{
+    auto len = strlen( b );
+    if ( a.size() != len )
+        return false;
+    for ( auto i = 0u; i < len; ++i )
+    {
+        if ( toupper( static_cast<unsigned char>( a[i] ) ) != b[i] )
+            return false;
+    }
+    return true;
+}
+
+bool readVorbisComment( const uint8_t* p, size_t size, AudioTags& tags )
+{
+    if ( size < 8 )
+        return false;
+    auto vendorLength = le32( p );
+    if ( vendorLength > size - 8 )
+        return false;
+    size_t pos = 4 + vendorLength;
+    auto nbComments = le32( p + pos );
+    pos += 4;
+    for ( auto i = 0u; i < nbComments && pos + 4 <= size; ++i )
+    {
+        auto length = le32( p + pos );
+        pos += 4;
+        if ( length > size - pos )
+            return false;
+        std::string comment( reinterpret_cast<const char*>( p + pos ), length );
+        pos += length;
+        auto sep = comment.find( '=' );
+        if ( sep == std::string::npos )
+            continue;
+        auto key = comment.substr( 0, sep );
+        auto value = comment.substr( sep + 1 );
+        if ( iequals( key, "TITLE" ) )
+            setIfEmpty( tags.title, std::move( value ) );
+        else if ( iequals( key, "ARTIST" ) )
+            setIfEmpty( tags.artist, std::move( value ) );
+        else if ( iequals( key, "ALBUMARTIST" ) || iequals( key, "ALBUM ARTIST" ) )
+            setIfEmpty( tags.albumArtist, std::move( value ) );
+        else if ( iequals( key, "ALBUM" ) )
+            setIfEmpty( tags.album, std::move( value ) );
+        else if ( iequals( key, "GENRE" ) )
+            setIfEmpty( tags.genre, std::move( value ) );
+        else if ( iequals( key, "DATE" ) )
+            setIfEmpty( tags.date, std::move( value ) );
+        else if ( iequals( key, "TRACKNUMBER" ) && tags.trackNumber == 0 )
+            parseNumber( value, tags.trackNumber, nullptr );
+        else if ( iequals( key, "DISCNUMBER" ) && tags.discNumber == 0 )
+            parseNumber( value, tags.discNumber, &tags.discTotal );
+        else if ( ( iequals( key, "DISCTOTAL" ) || iequals( key, "TOTALDISCS" ) ) &&
+                  tags.discTotal == 0 )
+            parseNumber( value, tags.discTotal, nullptr );
+    }
+    return true;
+}
+
+/* FLAC */
+
+bool readFlacPicture( const FileReader& reader, uint64_t offset, uint32_t size,
+                      AudioTags& tags )
+{
+    // Picture type, MIME type & description lengths, width, height, depth,
+    // number of colors & data length
+    const uint32_t MinPictureBlockSize = 32;
+    if ( size < MinPictureBlockSize )
+        return false;
+    std::vector<uint8_t> buff;
+    auto headerSize = std::min<uint32_t>( size, 1024 );
+    if ( reader.read( offset, buff, headerSize ) == false )
+        return false;
+    auto pictureType = be32( &buff[0] );
+    if ( tags.artworkSize > 0 && pictureType != 3 )
+        return true;
+    // The lengths are read as 64 bits values and the bounds are checked by
+    // additions only, so that a crafted length can't wrap the checks around
+    uint64_t pos = 4;
+    uint64_t mimeLength = be32( &buff[pos] );
+    pos += 4;
+    if ( pos + mimeLength + 4 > headerSize )
+        return false;
+    std::string mimeType( reinterpret_cast<const char*>( &buff[pos] ), mimeLength );
+    pos += mimeLength;
+    uint64_t descLength = be32( &buff[pos] );
+    pos += 4;
+    // Description, then width, height, depth, number of colors & data length
+    if ( pos + descLength + 20 > headerSize )
+        return false;
+    pos += descLength + 16;
+    uint64_t dataLength = be32( &buff[pos] );
+    pos += 4;
+    if ( pos + dataLength > size )
+        return false;
+    tags.artworkOffset = offset + pos;
+    tags.artworkSize = dataLength;
+    tags.artworkMimeType = std::move( mimeType );
+    return true;
+}
+
+bool readFlac( const FileReader& reader, AudioTags& tags )
+{
+    // Some taggers prepend an ID3v2 tag to FLAC files, although it's not allowed
+    AudioTags ignored;
+    auto pos = readId3v2( reader, 0, ignored );
+    uint8_t magic[4];
+    if ( reader.read( pos, magic, sizeof( magic ) ) == false ||
+         memcmp( magic, "fLaC", 4 ) != 0 )
+        return false;
+    pos += 4;
+    uint64_t nbSamples = 0;
+    bool last = false;
+    while ( last == false )
+    {
+        uint8_t header[4];
+        if ( reader.read( pos, header, sizeof( header ) ) == false )
+            return false;
+        last = ( header[0] & 0x80 ) != 0;
+        auto type = header[0] & 0x7F;
+        auto size = be24( header + 1 );
+        pos += sizeof( header );
+        if ( type == 0 )
+        {
+            uint8_t si[34];
+            if ( size < sizeof( si ) || reader.read( pos, si, sizeof( si ) ) == false )
+                return false;
+            tags.sampleRate = static_cast<uint32_t>( si[10] ) << 12 | si[11] << 4 | si[12] >> 4;
+            tags.nbChannels = ( ( si[12] >> 1 ) & 7 ) + 1;
+            nbSamples = static_cast<uint64_t>( si[13] & 0x0F ) << 32 | be32( si + 14 );
+        }
+        else if ( type == 4 )
+        {
+            std::vector<uint8_t> buff;
+            if ( size <= MaxCommentSize && reader.read( pos, buff, size ) == true )
+                readVorbisComment( buff.data(), size, tags );
+        }
+        else if ( type == 6 )
+            readFlacPicture( reader, pos, size, tags );
+        pos += size;
+    }
+    if ( tags.sampleRate == 0 )
+        return false;
+    tags.codec = "flac";
+    tags.duration = static_cast<int64_t>( nbSamples * 1000 / tags.sampleRate );
+    if ( tags.duration > 0 && pos < reader.size() )
+        tags.bitrate = static_cast<uint32_t>( ( reader.size() - pos ) * 8 * 1000 / tags.duration );
+    return true;
+}
+
+/* Ogg */
+
+/*
+ * Reassembles the packets of the first logical bitstream of an Ogg file.
+ * Multiplexed files are rejected, since they are likely to contain a video.
+ */
+class OggPacketReader
+{
+public:
+    explicit OggPacketReader( const FileReader& reader )
+        : m_reader( reader )
+        , m_offset( 0 )
+        , m_serial( 0 )
+        , m_nbPages( 0 )
+        , m_segment( 0 )
+        , m_bodyPos( 0 )
+    {
+    }
+
+    bool next( std::vector<uint8_t>& packet )
+    {
+        packet.clear();
+        while ( true )
+        {
+            if ( m_segment >= m_segments.size() && readPage() == false )
+                return false;
+            while ( m_segment < m_segments.size() )
+            {
+                auto length = m_segments[m_segment++];
+                if ( packet.size() + length > MaxCommentSize )
+                    return false;
+                packet.insert( end( packet ), m_body.begin() + m_bodyPos,
+                               m_body.begin() + m_bodyPos + length );
+                m_bodyPos += length;
+                if ( length < 255 )
+                    return true;
+            }
+        }
+    }
+
+    uint32_t serial() const
+    {
+        return m_serial;
+    }
+
+private:
+    bool readPage()
+    {
+        uint8_t header[27];
+        if ( m_reader.read( m_offset, header, sizeof( header ) ) == false ||
+             memcmp( header, "OggS", 4 ) != 0 )
+            return false;
+        auto serial = le32( header + 14 );
+        if ( m_nbPages++ == 0 )
+            m_serial = serial;
+        else if ( serial != m_serial && ( header[5] & 0x02 ) != 0 )
+            return false;
+        auto nbSegments = header[26];
+        m_segments.resize( nbSegments );
+        if ( m_reader.read( m_offset + sizeof( header ), m_segments.data(), nbSegments ) == false )
+            return false;
+        size_t bodySize = 0;
+        for ( auto s : m_segments )
+            bodySize += s;
+        auto bodyOffset = m_offset + sizeof( header ) + nbSegments;
+        m_offset = bodyOffset + bodySize;
+        if ( serial != m_serial )
+        {
+            m_segments.clear();
+            m_segment = 0;
+            return true;
+        }
+        if ( m_reader.read( bodyOffset, m_body, bodySize ) == false )
+            return false;
+        m_segment = 0;
+        m_bodyPos = 0;
+        return true;
+    }
+
+private:
+    const FileReader& m_reader;
+    uint64_t m_offset;
+    uint32_t m_serial;
+    uint32_t m_nbPages;
+    std::vector<uint8_t> m_segments;
+    size_t m_segment;
+    std::vector<uint8_t> m_body;
+    size_t m_bodyPos;
+};
+
+// Returns the granule position of the last page of the provided stream
+bool lastGranule( const FileReader& reader, uint32_t serial, uint64_t& granule )
+{
+    std::vector<uint8_t> buff;
+    auto toRead = std::min<uint64_t>( reader.size(), 65536 );
+    if ( reader.read( reader.size() - toRead, buff, toRead ) == false )
+        return false;
+    for ( auto i = static_cast<int64_t>( buff.size() ) - 27; i >= 0; --i )
+    {
+        if ( memcmp( &buff[i], "OggS", 4 ) != 0 || le32( &buff[i + 14] ) != serial )
+            continue;
+        granule = le64( &buff[i + 6] );
+        // -1 means no packet ends on this page
+        if ( granule != static_cast<uint64_t>( -1 ) )
+            return true;
+    }
+    return false;
+}
+
+bool readOgg( const FileReader& reader, AudioTags& tags )
+{
+    OggPacketReader packets( reader );
+    std::vector<uint8_t> packet;
+    if ( packets.next( packet ) == false )
+        return false;
+    uint32_t preSkip = 0;
+    size_t commentOffset;
+    const char* commentMagic;
+    if ( packet.size() >= 30 && memcmp( packet.data(), "\x01vorbis", 7 ) == 0 )
+    {
+        tags.codec = "vorb";
+        tags.nbChannels = packet[11];
+        tags.sampleRate = le32( &packet[12] );
+        auto nominal = static_cast<int32_t>( le32( &packet[20] ) );
+        tags.bitrate = nominal > 0 ? nominal : 0;
+        commentMagic = "\x03vorbis";
+        commentOffset = 7;
+    }
+    else if ( packet.size() >= 19 && memcmp( packet.data(), "OpusHead", 8 ) == 0 )
+    {
+        tags.codec = "opus";
+        tags.nbChannels = packet[9];
+        preSkip = le16( &packet[10] );
+        // Opus always decodes at 48kHz, regardless of the input rate
+        tags.sampleRate = 48000;
+        commentMagic = "OpusTags";
+        commentOffset = 8;
+    }
+    else
+        return false;
+    if ( tags.sampleRate == 0 || packets.next( packet ) == false ||
+         packet.size() < commentOffset ||
+         memcmp( packet.data(), commentMagic, commentOffset ) != 0 )
+        return false;
+    readVorbisComment( packet.data() + commentOffset, packet.size() - commentOffset, tags );
+
+    uint64_t granule;
+    if ( lastGranule( reader, packets.serial(), granule ) == false || granule < preSkip )
+        return false;
+    tags.duration = static_cast<int64_t>( ( granule - preSkip ) * 1000 / tags.sampleRate );
+    if ( tags.bitrate == 0 && tags.duration > 0 )
+        tags.bitrate = static_cast<uint32_t>( reader.size() * 8 * 1000 / tags.duration );
+    return true;
+}
+
+/* MP4 */
+
+struct Atom
+{
+    char type[4];
+    // The payload boundaries
+    uint64_t begin;
+    uint64_t end;
+
+    bool is( const char* t ) const
+    {
+        return memcmp( type, t, 4 ) == 0;
+    }
+};
+
+/*
+ * Calls the provided function for each atom in [begin; end[, until it returns
+ * false. Returns false if an atom header couldn't be read
+ */
+bool forEachAtom( const FileReader& reader, uint64_t begin, uint64_t end,
+                  const std::function<bool(const Atom&)>& func )
+{
+    auto pos = begin;
+    while ( pos + 8 <= end )
+    {
+        uint8_t header[16];
+        if ( reader.read( pos, header, 8 ) == false )
+            return false;
+        Atom atom;
+        memcpy( atom.type, header + 4, 4 );
+        uint64_t size = be32( header );
+        atom.begin = pos + 8;
+        if ( size == 1 )
+        {
+            if ( reader.read( pos + 8, header + 8, 8 ) == false )
+                return false;
+            size = be64( header + 8 );
+            atom.begin += 8;
+        }
+        else if ( size == 0 )
+            size = end - pos;
+        if ( size < atom.begin - pos || size > end - pos )
+            return false;
+        atom.end = pos + size;
+        pos = atom.end;
+        if ( func( atom ) == false )
+            return true;
+    }
+    return true;
+}
+
+bool findAtom( const FileReader& reader, uint64_t begin, uint64_t end,
+               const char* type, Atom& res )
+{
+    bool found = false;
+    forEachAtom( reader, begin, end, [type, &res, &found]( const Atom& a ) {
+        if ( a.is( type ) == false )
+            return true;
+        res = a;
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+// Walks a path of nested atoms, such as "mdia/minf/stbl"
+bool findPath( const FileReader& reader, Atom parent, const std::vector<const char*>& path,
+               Atom& res )
+{
+    if ( path.size() > MaxAtomDepth )
+        return false;
+    for ( auto type : path )
+    {
+        if ( findAtom( reader, parent.begin, parent.end, type, parent ) == false )
+            return false;
+    }
+    res = parent;
+    return true;
+}
+
+// Returns false if the track isn't an audio track we can handle
+bool readMp4Track( const FileReader& reader, const Atom& trak, AudioTags& tags,
+                   bool& isAudio )
+{
+    isAudio = false;
+    Atom hdlr;
+    uint8_t buff[36];
+    if ( findPath( reader, trak, { "mdia", "hdlr" }, hdlr ) == false ||
+         hdlr.end - hdlr.begin < 12 || reader.read( hdlr.begin, buff, 12 ) == false )
+        return true;
+    if ( memcmp( buff + 8, "vide", 4 ) == 0 )
+        return false;
+    if ( memcmp( buff + 8, "soun", 4 ) != 0 || tags.codec.empty() == false )
+        return true;
+    Atom stsd;
+    if ( findPath( reader, trak, { "mdia", "minf", "stbl", "stsd" }, stsd ) == false ||
+         stsd.end - stsd.begin < 8 + sizeof( buff ) ||
+         reader.read( stsd.begin + 8, buff, sizeof( buff ) ) == false )
+        return true;
+    // Skip the sample entry header & the reserved/version/vendor fields
+    if ( memcmp( buff + 4, "mp4a", 4 ) == 0 )
+        tags.codec = "mp4a";
+    else if ( memcmp( buff + 4, "alac", 4 ) == 0 )
+        tags.codec = "alac";
+    else
+        return false;
+    tags.nbChannels = be16( buff + 8 + 16 );
+    tags.sampleRate = be16( buff + 8 + 24 );
+    isAudio = true;
+    return true;
+}
+
+void readIlstItem( const FileReader& reader, const Atom& item, AudioTags& tags )
+{
+    Atom data;
+    if ( findAtom( reader, item.begin, item.end, "data", data ) == false ||
+         data.end - data.begin < 8 )
+        return;
+    auto valueSize = data.end - data.begin - 8;
+    if ( item.is( "covr" ) )
+    {
+        uint8_t type[4];
+        if ( tags.artworkSize > 0 || reader.read( data.begin, type, 4 ) == false )
+            return;
+        tags.artworkOffset = data.begin + 8;
+        tags.artworkSize = valueSize;
+        tags.artworkMimeType = be32( type ) == 14 ? "image/png" : "image/jpeg";
+        return;
+    }
+    if ( valueSize > MaxTextSize )
+        return;
+    std::vector<uint8_t> buff;
+    if ( reader.read( data.begin + 8, buff, valueSize ) == false )
+        return;
+    std::string value( buff.begin(), buff.end() );
+    if ( item.is( "\xA9nam" ) )
+        setIfEmpty( tags.title, std::move( value ) );
+    else if ( item.is( "\xA9" "ART" ) )
+        setIfEmpty( tags.artist, std::move( value ) );
+    else if ( item.is( "aART" ) )
+        setIfEmpty( tags.albumArtist, std::move( value ) );
+    else if ( item.is( "\xA9" "alb" ) )
+        setIfEmpty( tags.album, std::move( value ) );
+    else if ( item.is( "\xA9gen" ) )
+        setIfEmpty( tags.genre, std::move( value ) );
+    else if ( item.is( "gnre" ) && valueSize >= 2 && be16( buff.data() ) > 0 )
+        setIfEmpty( tags.genre, id3Genre( be16( buff.data() ) - 1u ) );
+    else if ( item.is( "\xA9" "day" ) )
+        setIfEmpty( tags.date, std::move( value ) );
+    else if ( item.is( "trkn" ) && valueSize >= 4 )
+        tags.trackNumber = be16( buff.data() + 2 );
+    else if ( item.is( "disk" ) && valueSize >= 4 )
+    {
+        tags.discNumber = be16( buff.data() + 2 );
+        if ( valueSize >= 6 )
+            tags.discTotal = be16( buff.data() + 4 );
+    }
+}
+
+void readMp4Tags( const FileReader& reader, const Atom& moov, AudioTags& tags )
+{
+    Atom meta;
+    if ( findPath( reader, moov, { "udta", "meta" }, meta ) == false )
+        return;
+    // meta is a full box, although some writers omit its version & flags
+    uint8_t header[8];
+    if ( reader.read( meta.begin, header, sizeof( header ) ) == false )
+        return;
+    if ( memcmp( header + 4, "hdlr", 4 ) != 0 )
+        meta.begin += 4;
+    Atom ilst;
+    if ( findAtom( reader, meta.begin, meta.end, "ilst", ilst ) == false )
+        return;
+    forEachAtom( reader, ilst.begin, ilst.end, [&reader, &tags]( const Atom& item ) {
+        readIlstItem( reader, item, tags );
+        return true;
+    });
+}
+
+bool readMp4( const FileReader& reader, AudioTags& tags )
+{
+    Atom ftyp, moov;
+    if ( findAtom( reader, 0, reader.size(), "ftyp", ftyp ) == false ||
+         ftyp.begin != 8 ||
+         findAtom( reader, 0, reader.size(), "moov", moov ) == false )
+        return false;
+    Atom mvhd;
+    uint8_t buff[32];
+    if ( findAtom( reader, moov.begin, moov.end, "mvhd", mvhd ) == false ||
+         mvhd.end - mvhd.begin < sizeof( buff ) ||
+         reader.read( mvhd.begin, buff, sizeof( buff ) ) == false )
+        return false;
+    uint32_t timescale;
+    uint64_t duration;
+    if ( buff[0] == 1 )
+    {
+        timescale = be32( buff + 20 );
+        duration = be64( buff + 24 );
+    }
+    else
+    {
+        timescale = be32( buff + 12 );
+        duration = be32( buff + 16 );
+    }
+    if ( timescale == 0 )
+        return false;
+    tags.duration = static_cast<int64_t>( duration * 1000 / timescale );
+
+    auto hasAudio = false;
+    auto supported = true;
+    forEachAtom( reader, moov.begin, moov.end,
+                 [&reader, &tags, &hasAudio, &supported]( const Atom& a ) {
+        if ( a.is( "trak" ) == false )
+            return true;
+        auto isAudio = false;
+        supported = readMp4Track( reader, a, tags, isAudio );
+        hasAudio = hasAudio || isAudio;
+        return supported;
+    });
+    if ( supported == false || hasAudio == false )
+        return false;
+    readMp4Tags( reader, moov, tags );
+
+    Atom mdat;
+    if ( tags.duration > 0 && findAtom( reader, 0, reader.size(), "mdat", mdat ) == true )
+        tags.bitrate = static_cast<uint32_t>( ( mdat.end - mdat.begin ) * 8 * 1000 /
+                                              tags.duration );
+    return true;
+}
+
+std::string toLower( std::string str )
+{
+    std::transform( begin( str ), end( str ), begin( str ), ::tolower );
+    return str;
+}
+
+}
+
+bool TagReader::isSupported( const std::string& extension )
+{
+    static const char* const extensions[] = {
+        "flac", "m4a", "m4b", "mp3", "oga", "ogg", "opus",
+    };
+    auto ext = toLower( extension );
+    return std::binary_search( std::begin( extensions ), std::end( extensions ), ext,
+                               []( const std::string& l, const std::string& r ) {
+        return l < r;
+    });
+}
+
+std::unique_ptr<AudioTags> TagReader::read( const std::string& path )
+{
+    FileReader reader( path );
+    if ( reader.isValid() == false )
+    {
+        LOG_WARN( "Failed to open ", path );
+        return nullptr;
+    }
+    auto ext = path.rfind( '.' );
+    if ( ext == std::string::npos )
+        return nullptr;
+    auto extension = toLower( path.substr( ext + 1 ) );
+    std::unique_ptr<AudioTags> tags( new AudioTags );
+    bool res;
+    try
+    {
+        if ( extension == "mp3" )
+            res = readMpeg( reader, *tags );
+        else if ( extension == "flac" )
+            res = readFlac( reader, *tags );
+        else if ( extension == "ogg" || extension == "oga" || extension == "opus" )
+            res = readOgg( reader, *tags );
+        else if ( extension == "m4a" || extension == "m4b" )
+            res = readMp4( reader, *tags );
+        else
+            res = false;
+    }
+    catch ( const std::exception& ex )
+    {
+        LOG_WARN( "Failed to read tags from ", path, ": ", ex.what() );
+        return nullptr;
+    }
+    if ( res == false || tags->duration <= 0 || tags->sampleRate == 0 )
+    {
+        LOG_INFO( "Can't read ", path, " natively" );
+        return nullptr;
+    }
+    return tags;
+}
+
+std::string TagReader::extractArtwork( const std::string& path, const AudioTags& tags,
+                                      const std::string& destination )
+{
+    if ( tags.artworkSize == 0 || tags.artworkSize > MaxArtworkSize )
+        return {};
+    FileReader reader( path );
+    std::vector<uint8_t> buff;
+    if ( reader.isValid() == false ||
+         reader.read( tags.artworkOffset, buff, tags.artworkSize ) == false )
+    {
+        LOG_WARN( "Failed to read ", path, " artwork" );
+        return {};
+    }
+    auto res = destination + ( tags.artworkMimeType == "image/png" ? ".png" : ".jpg" );
+    std::ofstream out( res, std::ios::binary | std::ios::trunc );
+    out.write( reinterpret_cast<const char*>( buff.data() ), buff.size() );
+    out.close();
+    if ( out.fail() == true )
+    {
+        LOG_WARN( "Failed to write artwork to ", res );
+        return {};
+    }
+    return res;
+}
+
+}
@@ -0,0 +1,95 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace medialibrary
+{
+
+/**
+ * @brief AudioTags holds the metadata read from an audio file by the TagReader
+ *
+ * Only the fields used by the metadata parser are extracted. Empty strings and
+ * 0 values denote a missing field.
+ */
+struct AudioTags
+{
+    std::string title;
+    std::string artist;
+    std::string albumArtist;
+    std::string album;
+    std::string genre;
+    std::string date;
+    uint32_t trackNumber = 0;
+    uint32_t discNumber = 0;
+    uint32_t discTotal = 0;
+    /// Duration in milliseconds
+    int64_t duration = 0;
+    /// The audio stream properties. The codec uses the same fourcc as libvlc
+    std::string codec;
+    uint32_t bitrate = 0;
+    uint32_t sampleRate = 0;
+    uint32_t nbChannels = 0;
+    /// Location of the embedded artwork within the file, if any
+    uint64_t artworkOffset = 0;
+    uint64_t artworkSize = 0;
+    std::string artworkMimeType;
+};
+
+/**
+ * @brief TagReader reads the tags & stream properties of the most common audio
+ *        containers, without demuxing them.
+ *
+ * MP3 (ID3v2 & ID3v1), FLAC, Ogg Vorbis/Opus and MP4/M4A audio files are
+ * supported. Only the headers and tags are read, using positional reads, and
+ * the embedded artworks are located but not loaded.
+ * Files using features which aren't supported, such as MP4 files containing a
+ * video track, are rejected so that they can be handed to libvlc instead.
+ */
+class TagReader
+{
+public:
+    /**
+     * @brief isSupported Returns true if the extension, without its leading
+     *                    dot, denotes a container which can be read
+     */
+    static bool isSupported( const std::string& extension );
+    /**
+     * @brief read Reads the tags of the provided local file
+     * @return The tags, or nullptr if the file couldn't be read
+     */
+    static std::unique_ptr<AudioTags> read( const std::string& path );
+    /**
+     * @brief extractArtwork Copies the embedded artwork located by read()
+     * @param path The file the tags were read from
+     * @param destination The destination path, without extension
+     * @return The path of the written artwork, or an empty string on failure
+     */
+    static std::string extractArtwork( const std::string& path, const AudioTags& tags,
+                                       const std::string& destination );
+};
+
+}
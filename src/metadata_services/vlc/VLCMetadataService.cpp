@@ -24,6 +24,7 @@
 # include "config.h"
 #endif
 
+#include <algorithm>
 #include <chrono>
 
 #include "VLCMetadataService.h"
@@ -33,9 +34,36 @@
 namespace medialibrary
 {
 
-VLCMetadataService::VLCMetadataService()
+namespace
+{
+
+// The completion state of a single media analysis
+struct ParseState
+{
+    compat::Mutex mutex;
+    compat::ConditionVariable cond;
+    VLC::Media::ParsedStatus status;
+    bool done = false;
+};
+
+}
+
+VLCMetadataService::VLCMetadataService( uint8_t nbParallelTasks )
     : m_instance( VLCInstance::get() )
+    , m_nbParallelTasks( nbParallelTasks )
 {
+    if ( m_nbParallelTasks == 0 )
+    {
+        // Most of the time is spent waiting for I/O, so use more tasks than
+        // there are cores
+        m_nbParallelTasks = std::max<uint8_t>( 2, nbNativeThreads() );
+    }
+#if LIBVLC_VERSION_INT >= LIBVLC_VERSION(4, 0, 0, 0)
+    m_nbParallelTasks = std::min<uint8_t>( m_nbParallelTasks, VLCInstance::NbPreparserThreads );
+#else
+    // libvlc 3 preparses a single media at a time
+    m_nbParallelTasks = 1;
+#endif
 }
 
 parser::Task::Status VLCMetadataService::run( parser::Task& task )
@@ -48,24 +76,26 @@ parser::Task::Status VLCMetadataService::run( parser::Task& task )
     assert( task.vlcMedia.isValid() == false );
     task.vlcMedia = VLC::Media( m_instance, mrl, VLC::Media::FromType::FromLocation );
 
-    VLC::Media::ParsedStatus status;
-    bool done = false;
-
-    auto event = task.vlcMedia.eventManager().onParsedChanged( [this, &status, &done](VLC::Media::ParsedStatus s ) {
-        std::lock_guard<compat::Mutex> lock( m_mutex );
-        status = s;
-        done = true;
-        m_cond.notify_all();
+    // Each task waits for its own media, so that several analysis can be
+    // running at once
+    auto state = std::make_shared<ParseState>();
+    auto event = task.vlcMedia.eventManager().onParsedChanged( [state](VLC::Media::ParsedStatus s ) {
+        std::lock_guard<compat::Mutex> lock( state->mutex );
+        state->status = s;
+        state->done = true;
+        state->cond.notify_all();
     });
+    VLC::Media::ParsedStatus status;
     {
-        std::unique_lock<compat::Mutex> lock( m_mutex );
+        std::unique_lock<compat::Mutex> lock( state->mutex );
 
         if ( task.vlcMedia.parseWithOptions( VLC::Media::ParseFlags::Local | VLC::Media::ParseFlags::Network |
                                              VLC::Media::ParseFlags::FetchLocal, 5000 ) == false )
             return parser::Task::Status::Fatal;
-        m_cond.wait( lock, [&status, &done]() {
-            return done == true;
+        state->cond.wait( lock, [&state]() {
+            return state->done == true;
         });
+        status = state->status;
     }
     event->unregister();
     if ( status == VLC::Media::ParsedStatus::Failed || status == VLC::Media::ParsedStatus::Timeout )
@@ -86,13 +116,14 @@ const char* VLCMetadataService::name() const
 
 uint8_t VLCMetadataService::nbThreads() const
 {
-    return 1;
+    return m_nbParallelTasks;
 }
 
 bool VLCMetadataService::isCompleted( const parser::Task& task ) const
 {
-    // We always need to run this task if the metadata extraction isn't completed
-    return task.vlcMedia.isValid() == true;
+    // We always need to run this task if the metadata extraction isn't completed,
+    // unless the tags were read natively
+    return task.vlcMedia.isValid() == true || task.tags != nullptr;
 }
 
 }
@@ -37,7 +37,13 @@ namespace medialibrary
 class VLCMetadataService : public ParserService
 {
     public:
-        explicit VLCMetadataService();
+        ///
+        /// \brief VLCMetadataService
+        /// \param nbParallelTasks The number of media being analyzed at once,
+        ///                        or 0 for the default value. It can't exceed
+        ///                        the number of libvlc preparser threads.
+        ///
+        explicit VLCMetadataService( uint8_t nbParallelTasks );
 
 private:
         virtual parser::Task::Status run( parser::Task& task ) override;
@@ -47,8 +53,7 @@ private:
 
 private:
         VLC::Instance m_instance;
-        compat::Mutex m_mutex;
-        compat::ConditionVariable m_cond;
+        uint8_t m_nbParallelTasks;
 };
 
 }
@@ -47,18 +47,37 @@
 namespace medialibrary
 {
 
-VLCThumbnailer::VLCThumbnailer()
-    : m_instance( VLCInstance::get() )
-    , m_thumbnailRequired( false )
-    , m_width( 0 )
-    , m_height( 0 )
-    , m_prevSize( 0 )
+const uint8_t VLCThumbnailer::MaxDefaultWorkers;
+const uint32_t VLCThumbnailer::MaxDownscaleFactor;
+const uint32_t VLCThumbnailer::DesiredWidth;
+const uint32_t VLCThumbnailer::DesiredHeight;
+
+VLCThumbnailer::Worker::Worker( VLC::Instance& instance )
+    : mp( instance )
+    , thumbnailRequired( false )
+    , width( 0 )
+    , height( 0 )
+    , factor( 1 )
+    , pitch( 0 )
+    , prevSize( 0 )
 {
 #ifdef HAVE_JPEG
-    m_compressor.reset( new JpegCompressor );
+    compressor.reset( new JpegCompressor );
 #elif defined(HAVE_EVAS)
-    m_compressor.reset( new EvasCompressor );
+    compressor.reset( new EvasCompressor );
 #endif
+    thumbnail.reset( new uint8_t[DesiredWidth * DesiredHeight * compressor->bpp()] );
+}
+
+VLCThumbnailer::VLCThumbnailer( uint8_t nbWorkers )
+    : m_instance( VLCInstance::get() )
+    , m_nbWorkers( nbWorkers )
+{
+    if ( m_nbWorkers == 0 )
+    {
+        m_nbWorkers = std::min<uint8_t>( MaxDefaultWorkers,
+                                         std::max( 1, nbNativeThreads() / 2 ) );
+    }
 }
 
 bool VLCThumbnailer::initialize()
@@ -72,7 +91,41 @@ bool VLCThumbnailer::isCompleted( const parser::Task& task ) const
             static_cast<uint8_t>( parser::Task::ParserStep::Thumbnailer ) ) != 0;
 }
 
+std::unique_ptr<VLCThumbnailer::Worker> VLCThumbnailer::acquireWorker()
+{
+    {
+        std::lock_guard<compat::Mutex> lock( m_workersLock );
+        if ( m_idleWorkers.empty() == false )
+        {
+            auto worker = std::move( m_idleWorkers.back() );
+            m_idleWorkers.pop_back();
+            return worker;
+        }
+    }
+    // No more than nbThreads() tasks run at once, so we only get here until
+    // each of them has created its worker
+    auto worker = std::unique_ptr<Worker>( new Worker( m_instance ) );
+    setupVout( *worker );
+    return worker;
+}
+
+void VLCThumbnailer::releaseWorker( std::unique_ptr<Worker> worker )
+{
+    // The playback is still running when the generation failed
+    worker->mp.stop();
+    std::lock_guard<compat::Mutex> lock( m_workersLock );
+    m_idleWorkers.push_back( std::move( worker ) );
+}
+
 parser::Task::Status VLCThumbnailer::run( parser::Task& task )
+{
+    auto worker = acquireWorker();
+    auto res = generate( task, *worker );
+    releaseWorker( std::move( worker ) );
+    return res;
+}
+
+parser::Task::Status VLCThumbnailer::generate( parser::Task& task, Worker& worker )
 {
     auto media = task.media.get();
     auto file = task.file.get();
@@ -99,11 +152,9 @@ parser::Task::Status VLCThumbnailer::run( parser::Task& task )
         task.vlcMedia.addOption( ss.str() );
     }
 
-    VLC::MediaPlayer mp( task.vlcMedia );
-
-    setupVout( mp );
+    worker.mp.setMedia( task.vlcMedia );
 
-    auto res = startPlayback( task, mp );
+    auto res = startPlayback( task, worker );
     if ( res != parser::Task::Status::Success )
     {
         // If the media became an audio file, it's not an error
@@ -134,14 +185,14 @@ parser::Task::Status VLCThumbnailer::run( parser::Task& task )
     if ( duration <= 0 )
     {
         // Seek ahead to have a significant preview
-        res = seekAhead( mp );
+        res = seekAhead( worker );
         if ( res != parser::Task::Status::Success )
         {
             LOG_WARN( "Failed to generate ", file->mrl(), " thumbnail: Failed to seek ahead" );
             return res;
         }
     }
-    res = takeThumbnail( media, file, mp );
+    res = takeThumbnail( media, file, worker );
     if ( res != parser::Task::Status::Success )
         return res;
 
@@ -159,7 +210,7 @@ parser::Task::Status VLCThumbnailer::run( parser::Task& task )
     return parser::Task::Status::Success;
 }
 
-parser::Task::Status VLCThumbnailer::startPlayback( parser::Task& task, VLC::MediaPlayer &mp )
+parser::Task::Status VLCThumbnailer::startPlayback( parser::Task& task, Worker& worker )
 {
     // Use a copy of the event manager to automatically unregister all events as soon
     // as we leave this method.
@@ -167,39 +218,39 @@ parser::Task::Status VLCThumbnailer::startPlayback( parser::Task& task, VLC::Med
     bool failedToStart = false;
     bool hasAnyTrack = false;
     bool success = false;
-    auto em = mp.eventManager();
-    em.onESAdded([this, &hasVideoTrack, &hasAnyTrack]( libvlc_track_type_t type, int ) {
-        std::lock_guard<compat::Mutex> lock( m_mutex );
+    auto em = worker.mp.eventManager();
+    em.onESAdded([&worker, &hasVideoTrack, &hasAnyTrack]( libvlc_track_type_t type, int ) {
+        std::lock_guard<compat::Mutex> lock( worker.mutex );
         if ( type == libvlc_track_video )
             hasVideoTrack = true;
         hasAnyTrack = true;
-        m_cond.notify_all();
+        worker.cond.notify_all();
     });
-    em.onEncounteredError([this, &failedToStart]() {
-        std::lock_guard<compat::Mutex> lock( m_mutex );
+    em.onEncounteredError([&worker, &failedToStart]() {
+        std::lock_guard<compat::Mutex> lock( worker.mutex );
         failedToStart = true;
-        m_cond.notify_all();
+        worker.cond.notify_all();
     });
 
     bool metaArtworkChanged = false;
     auto mem = task.vlcMedia.eventManager();
     if ( task.media->type() == Media::Type::Audio )
     {
-        mem.onMetaChanged([this, &metaArtworkChanged, &task]( libvlc_meta_t meta ) {
+        mem.onMetaChanged([&worker, &metaArtworkChanged, &task]( libvlc_meta_t meta ) {
             if ( meta != libvlc_meta_ArtworkURL
                  || metaArtworkChanged == true
                  || task.vlcMedia.meta( libvlc_meta_ArtworkURL ) == task.media->thumbnail() )
                 return;
-            std::lock_guard<compat::Mutex> lock( m_mutex );
+            std::lock_guard<compat::Mutex> lock( worker.mutex );
             metaArtworkChanged = true;
-            m_cond.notify_all();
+            worker.cond.notify_all();
         });
     }
 
     {
-        std::unique_lock<compat::Mutex> lock( m_mutex );
-        mp.play();
-        success = m_cond.wait_for( lock, std::chrono::seconds( 3 ), [&failedToStart, &hasAnyTrack]() {
+        std::unique_lock<compat::Mutex> lock( worker.mutex );
+        worker.mp.play();
+        success = worker.cond.wait_for( lock, std::chrono::seconds( 3 ), [&failedToStart, &hasAnyTrack]() {
             return failedToStart == true || hasAnyTrack == true;
         });
 
@@ -213,13 +264,13 @@ parser::Task::Status VLCThumbnailer::startPlayback( parser::Task& task, VLC::Med
         {
             if ( task.media->type() == Media::Type::Audio )
             {
-                m_cond.wait_for( lock, std::chrono::milliseconds( 500 ), [&metaArtworkChanged]() {
+                worker.cond.wait_for( lock, std::chrono::milliseconds( 500 ), [&metaArtworkChanged]() {
                     return metaArtworkChanged == true;
                 });
             }
             else
             {
-                m_cond.wait_for( lock, std::chrono::seconds( 1 ), [&hasVideoTrack]() {
+                worker.cond.wait_for( lock, std::chrono::seconds( 1 ), [&hasVideoTrack]() {
                     return hasVideoTrack == true;
                 });
             }
@@ -277,19 +328,19 @@ void VLCThumbnailer::updateAudioArtwork( parser::Task& task )
 
 }
 
-parser::Task::Status VLCThumbnailer::seekAhead( VLC::MediaPlayer& mp )
+parser::Task::Status VLCThumbnailer::seekAhead( Worker& worker )
 {
     float pos = .0f;
-    auto event = mp.eventManager().onPositionChanged([this, &pos](float p) {
-        std::unique_lock<compat::Mutex> lock( m_mutex );
+    auto event = worker.mp.eventManager().onPositionChanged([&worker, &pos](float p) {
+        std::unique_lock<compat::Mutex> lock( worker.mutex );
         pos = p;
-        m_cond.notify_all();
+        worker.cond.notify_all();
     });
     auto success = false;
     {
-        std::unique_lock<compat::Mutex> lock( m_mutex );
-        mp.setPosition( .4f );
-        success = m_cond.wait_for( lock, std::chrono::seconds( 3 ), [&pos]() {
+        std::unique_lock<compat::Mutex> lock( worker.mutex );
+        worker.mp.setPosition( .4f );
+        success = worker.cond.wait_for( lock, std::chrono::seconds( 3 ), [&pos]() {
             return pos >= .1f;
         });
     }
@@ -300,67 +351,80 @@ parser::Task::Status VLCThumbnailer::seekAhead( VLC::MediaPlayer& mp )
     return parser::Task::Status::Success;
 }
 
-void VLCThumbnailer::setupVout( VLC::MediaPlayer& mp )
+void VLCThumbnailer::setupVout( Worker& worker )
 {
-    mp.setVideoFormatCallbacks(
+    worker.mp.setVideoFormatCallbacks(
         // Setup
-        [this, &mp](char* chroma, unsigned int* width, unsigned int *height, unsigned int *pitches, unsigned int *lines) {
-            strcpy( chroma, m_compressor->fourCC() );
+        [&worker](char* chroma, unsigned int* width, unsigned int *height, unsigned int *pitches, unsigned int *lines) {
+            // Always fetch RV32 frames, the downscaler converts them to the
+            // format the compressor expects
+            strcpy( chroma, "RV32" );
 
             const float inputAR = (float)*width / *height;
 
-            m_width = DesiredWidth;
-            m_height = (float)m_width / inputAR + 1;
-            if ( m_height < DesiredHeight )
+            worker.width = DesiredWidth;
+            worker.height = (float)worker.width / inputAR + 1;
+            if ( worker.height < DesiredHeight )
             {
                 // Avoid downscaling too much for really wide pictures
-                m_width = inputAR * DesiredHeight;
-                m_height = DesiredHeight;
+                worker.width = inputAR * DesiredHeight;
+                worker.height = DesiredHeight;
             }
-            auto size = m_width * m_height * m_compressor->bpp();
+            worker.width = std::max( worker.width, DesiredWidth );
+            worker.height = std::max( worker.height, DesiredHeight );
+            // Ask for a frame as close as possible to the video size, so that
+            // libvlc only has to scale it a little, if at all
+            worker.factor = std::min( *width / worker.width, *height / worker.height );
+            worker.factor = std::max( 1u, std::min( worker.factor, MaxDownscaleFactor ) );
+            *width = worker.width * worker.factor;
+            *height = worker.height * worker.factor;
+            // Keep the rows aligned for the downscaler
+            worker.pitch = ( *width * 4 + 31 ) & ~31u;
+            auto size = worker.pitch * *height;
             // If our buffer isn't enough anymore, reallocate a new one.
-            if ( size > m_prevSize )
+            if ( size > worker.prevSize )
             {
-                m_buff.reset( new uint8_t[size] );
-                m_prevSize = size;
+                worker.buff.reset( new uint8_t[size] );
+                worker.prevSize = size;
             }
-            *width = m_width;
-            *height = m_height;
-            *pitches = m_width * m_compressor->bpp();
-            *lines = m_height;
+            *pitches = worker.pitch;
+            *lines = *height;
             return 1;
         },
         // Cleanup
         nullptr);
-    mp.setVideoCallbacks(
+    worker.mp.setVideoCallbacks(
         // Lock
-        [this](void** pp_buff) {
-            *pp_buff = m_buff.get();
+        [&worker](void** pp_buff) {
+            *pp_buff = worker.buff.get();
             return nullptr;
         },
         //unlock
         nullptr,
 
         //display
-        [this](void*) {
+        [&worker](void*) {
             bool expected = true;
-            if ( m_thumbnailRequired.compare_exchange_strong( expected, false ) )
+            if ( worker.thumbnailRequired.compare_exchange_strong( expected, false ) )
             {
-                m_cond.notify_all();
+                // Lock so that the wakeup can't happen between the waiting
+                // thread checking its predicate and starting to wait
+                std::lock_guard<compat::Mutex> lock( worker.mutex );
+                worker.cond.notify_all();
             }
         }
     );
 }
 
-parser::Task::Status VLCThumbnailer::takeThumbnail( Media* media, File* file, VLC::MediaPlayer &mp )
+parser::Task::Status VLCThumbnailer::takeThumbnail( Media* media, File* file, Worker& worker )
 {
     // lock, signal that we want a thumbnail, and wait.
     {
-        std::unique_lock<compat::Mutex> lock( m_mutex );
-        m_thumbnailRequired = true;
-        bool success = m_cond.wait_for( lock, std::chrono::seconds( 15 ), [this]() {
-            // Keep waiting if the vmem thread hasn't restored m_thumbnailRequired to false
-            return m_thumbnailRequired == false;
+        std::unique_lock<compat::Mutex> lock( worker.mutex );
+        worker.thumbnailRequired = true;
+        bool success = worker.cond.wait_for( lock, std::chrono::seconds( 15 ), [&worker]() {
+            // Keep waiting if the vmem thread hasn't restored thumbnailRequired to false
+            return worker.thumbnailRequired == false;
         });
         if ( success == false )
         {
@@ -368,21 +432,26 @@ parser::Task::Status VLCThumbnailer::takeThumbnail( Media* media, File* file, VL
             return parser::Task::Status::Fatal;
         }
     }
-    mp.stop();
-    return compress( media, file );
+    worker.mp.stop();
+    return compress( media, file, worker );
 }
 
-parser::Task::Status VLCThumbnailer::compress( Media* media, File* file )
+parser::Task::Status VLCThumbnailer::compress( Media* media, File* file, Worker& worker )
 {
     auto path = m_ml->thumbnailPath();
     path += "/";
-    path += std::to_string( media->id() ) + "." + m_compressor->extension();
-
-    auto hOffset = m_width > DesiredWidth ? ( m_width - DesiredWidth ) / 2 : 0;
-    auto vOffset = m_height > DesiredHeight ? ( m_height - DesiredHeight ) / 2 : 0;
-
-    if ( m_compressor->compress( m_buff.get(), path, m_width, m_height, DesiredWidth, DesiredHeight,
-                            hOffset, vOffset ) == false )
+    path += std::to_string( media->id() ) + "." + worker.compressor->extension();
+
+    auto hOffset = ( worker.width - DesiredWidth ) / 2;
+    auto vOffset = ( worker.height - DesiredHeight ) / 2;
+    auto format = worker.compressor->bpp() == 3 ? Downscaler::Format::RGB24 :
+                                                  Downscaler::Format::RV32;
+    worker.downscaler.process( worker.buff.get(), worker.pitch, worker.factor,
+                               hOffset, vOffset, worker.thumbnail.get(),
+                               DesiredWidth, DesiredHeight, format );
+
+    if ( worker.compressor->compress( worker.thumbnail.get(), path, DesiredWidth, DesiredHeight,
+                                      DesiredWidth, DesiredHeight, 0, 0 ) == false )
         return parser::Task::Status::Fatal;
 
     media->setThumbnail( path );
@@ -396,7 +465,7 @@ const char*VLCThumbnailer::name() const
 
 uint8_t VLCThumbnailer::nbThreads() const
 {
-    return 1;
+    return m_nbWorkers;
 }
 
 }
@@ -26,8 +26,13 @@
 
 #include <vlcpp/vlc.hpp>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 #include "imagecompressors/IImageCompressor.h"
 #include "parser/ParserService.h"
+#include "utils/Downscaler.h"
 
 namespace medialibrary
 {
@@ -35,19 +40,56 @@ namespace medialibrary
 class VLCThumbnailer : public ParserService
 {
 public:
-    explicit VLCThumbnailer();
+    ///
+    /// \brief VLCThumbnailer
+    /// \param nbWorkers The number of thumbnails generated at once, or 0 for
+    ///                  the default value.
+    ///
+    explicit VLCThumbnailer( uint8_t nbWorkers );
     virtual ~VLCThumbnailer() = default;
     virtual parser::Task::Status run( parser::Task& task ) override;
     virtual bool initialize() override;
     virtual bool isCompleted( const parser::Task& task ) const override;
 
 private:
-    parser::Task::Status startPlayback( parser::Task& task, VLC::MediaPlayer& mp );
+    /*
+     * A worker owns a media player, which is reused from one task to another,
+     * and all the state required to fetch a frame from it.
+     * Each running task uses its own worker, so that thumbnails can be
+     * generated concurrently.
+     */
+    struct Worker
+    {
+        explicit Worker( VLC::Instance& instance );
+
+        compat::Mutex mutex;
+        compat::ConditionVariable cond;
+        VLC::MediaPlayer mp;
+        std::unique_ptr<IImageCompressor> compressor;
+        Downscaler downscaler;
+        // The downscaled & cropped picture, handed to the compressor
+        std::unique_ptr<uint8_t[]> thumbnail;
+        // Per thumbnail variables
+        std::unique_ptr<uint8_t[]> buff;
+        std::atomic_bool thumbnailRequired;
+        // The size of the picture once downscaled, before it gets cropped
+        uint32_t width;
+        uint32_t height;
+        // The factor by which the frames provided by libvlc get downscaled
+        uint32_t factor;
+        uint32_t pitch;
+        uint32_t prevSize;
+    };
+
+    std::unique_ptr<Worker> acquireWorker();
+    void releaseWorker( std::unique_ptr<Worker> worker );
+    parser::Task::Status generate( parser::Task& task, Worker& worker );
+    parser::Task::Status startPlayback( parser::Task& task, Worker& worker );
     void updateAudioArtwork( parser::Task& task );
-    parser::Task::Status seekAhead( VLC::MediaPlayer &mp );
-    void setupVout( VLC::MediaPlayer &mp );
-    parser::Task::Status takeThumbnail( Media* media, File* file, VLC::MediaPlayer &mp );
-    parser::Task::Status compress( Media* media, File* file );
+    parser::Task::Status seekAhead( Worker& worker );
+    void setupVout( Worker& worker );
+    parser::Task::Status takeThumbnail( Media* media, File* file, Worker& worker );
+    parser::Task::Status compress( Media* media, File* file, Worker& worker );
 
     virtual const char* name() const override;
     virtual uint8_t nbThreads() const override;
@@ -56,18 +98,19 @@ private:
     // Force a base width, let height be computed depending on A/R
     static const uint32_t DesiredWidth = 320;
     static const uint32_t DesiredHeight = 200; // Aim for a 16:10 thumbnail
+    // libvlc provides frames up to this many times larger than the thumbnail,
+    // which get downscaled in a single pass
+    static const uint32_t MaxDownscaleFactor = 4;
+    // Decoding is mostly CPU bound, and libvlc already uses multiple threads
+    // per decoder, so don't use too many workers by default
+    static const uint8_t MaxDefaultWorkers = 4;
 
 private:
     VLC::Instance m_instance;
-    compat::Mutex m_mutex;
-    compat::ConditionVariable m_cond;
-    std::unique_ptr<IImageCompressor> m_compressor;
-    // Per thumbnail variables
-    std::unique_ptr<uint8_t[]> m_buff;
-    std::atomic_bool m_thumbnailRequired;
-    uint32_t m_width;
-    uint32_t m_height;
-    uint32_t m_prevSize;
+    uint8_t m_nbWorkers;
+    // The workers which aren't used by a running task
+    compat::Mutex m_workersLock;
+    std::vector<std::unique_ptr<Worker>> m_idleWorkers;
 };
 
 }
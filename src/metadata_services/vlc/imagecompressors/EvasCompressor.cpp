@@ -28,8 +28,12 @@
 
 #include <Evas_Engine_Buffer.h>
 
+#include <cstdio>
 #include <cstring>
 
+#include "utils/Directory.h"
+#include "utils/Filename.h"
+
 namespace medialibrary
 {
 
@@ -115,7 +119,15 @@ bool EvasCompressor::compress( const uint8_t* buffer, const std::string& output,
     evas_object_image_colorspace_set( evas_obj.get(), EVAS_COLORSPACE_ARGB8888 );
     evas_object_image_size_set( evas_obj.get(), outputWidth, outputHeight );
     evas_object_image_data_set( evas_obj.get(), const_cast<uint8_t*>( p_buff + vOffset * stride ) );
-    evas_object_image_save( evas_obj.get(), output.c_str(), NULL, "quality=100 compress=9");
+    // Evas guesses the format from the extension, so keep it for the
+    // temporary file, which is moved in place once completely written
+    auto tmpFile = utils::file::stripExtension( output ) + ".tmp." + extension();
+    if ( evas_object_image_save( evas_obj.get(), tmpFile.c_str(), NULL, "quality=100 compress=9") == EINA_FALSE ||
+         utils::fs::replace( tmpFile, output ) == false )
+    {
+        remove( tmpFile.c_str() );
+        return false;
+    }
     return true;
 }
 
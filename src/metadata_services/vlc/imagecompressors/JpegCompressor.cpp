@@ -27,10 +27,13 @@
 #include "JpegCompressor.h"
 
 #include "logging/Logger.h"
+#include "utils/Directory.h"
 
 #include <jpeglib.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <cstdio>
 #include <cstring>
 #include <memory>
 #include <setjmp.h>
@@ -66,6 +69,52 @@ struct jpegError : public jpeg_error_mgr
     }
 };
 
+/*
+ * Encodes into a std::vector, which keeps its capacity across pictures, so
+ * that no allocation is needed once the first thumbnails were generated.
+ */
+struct jpegMemoryDestination : public jpeg_destination_mgr
+{
+    static const size_t InitialSize = 32 * 1024;
+
+    explicit jpegMemoryDestination( std::vector<uint8_t>& buffer )
+        : buffer( buffer )
+    {
+        init_destination = &init;
+        empty_output_buffer = &grow;
+        term_destination = &term;
+    }
+
+    static void init( j_compress_ptr cinfo )
+    {
+        auto dest = static_cast<jpegMemoryDestination*>( cinfo->dest );
+        dest->buffer.resize( std::max( dest->buffer.capacity(), InitialSize ) );
+        dest->next_output_byte = dest->buffer.data();
+        dest->free_in_buffer = dest->buffer.size();
+    }
+
+    // Invoked when the buffer is full
+    static boolean grow( j_compress_ptr cinfo )
+    {
+        auto dest = static_cast<jpegMemoryDestination*>( cinfo->dest );
+        auto used = dest->buffer.size();
+        dest->buffer.resize( used * 2 );
+        dest->next_output_byte = dest->buffer.data() + used;
+        dest->free_in_buffer = dest->buffer.size() - used;
+        return TRUE;
+    }
+
+    static void term( j_compress_ptr cinfo )
+    {
+        auto dest = static_cast<jpegMemoryDestination*>( cinfo->dest );
+        dest->buffer.resize( dest->buffer.size() - dest->free_in_buffer );
+    }
+
+    std::vector<uint8_t>& buffer;
+};
+
+const size_t jpegMemoryDestination::InitialSize;
+
 bool JpegCompressor::compress( const uint8_t* buffer, const std::string& outputFile,
                               uint32_t inputWidth, uint32_t,
                               uint32_t outputWidth, uint32_t outputHeight,
@@ -73,16 +122,12 @@ bool JpegCompressor::compress( const uint8_t* buffer, const std::string& outputF
 {
     const auto stride = inputWidth * bpp();
 
-    //FIXME: Abstract this away, though libjpeg requires a FILE*...
-    auto fOut = std::unique_ptr<FILE, int(*)(FILE*)>( fopen( outputFile.c_str(), "wb" ), &fclose );
-    if ( fOut == nullptr )
-    {
-        LOG_ERROR( "Failed to open thumbnail file ", outputFile, '(', strerror( errno ), ')' );
-        return false;
-    }
+    m_rows.resize( outputHeight );
+    for ( auto y = 0u; y < outputHeight; ++y )
+        m_rows[y] = const_cast<uint8_t*>( &buffer[( y + vOffset ) * stride + hOffset * bpp()] );
 
     jpeg_compress_struct compInfo;
-    JSAMPROW row_pointer[1];
+    jpegMemoryDestination dest( m_buffer );
 
     //libjpeg's default error handling is to call exit(), which would
     //be slightly problematic...
@@ -98,7 +143,7 @@ bool JpegCompressor::compress( const uint8_t* buffer, const std::string& outputF
     }
 
     jpeg_create_compress(&compInfo);
-    jpeg_stdio_dest(&compInfo, fOut.get());
+    compInfo.dest = &dest;
 
     compInfo.image_width = outputWidth;
     compInfo.image_height = outputHeight;
@@ -111,11 +156,36 @@ bool JpegCompressor::compress( const uint8_t* buffer, const std::string& outputF
 
     while ( compInfo.next_scanline < outputHeight )
     {
-        row_pointer[0] = const_cast<uint8_t*>( &buffer[(compInfo.next_scanline + vOffset ) * stride + hOffset * bpp()] );
-        jpeg_write_scanlines(&compInfo, row_pointer, 1);
+        jpeg_write_scanlines( &compInfo, m_rows.data() + compInfo.next_scanline,
+                              outputHeight - compInfo.next_scanline );
     }
     jpeg_finish_compress(&compInfo);
     jpeg_destroy_compress(&compInfo);
+
+    // Write the thumbnail next to its final location, and only then move it
+    // in place, so that a crash can't leave a truncated thumbnail behind
+    auto tmpFile = outputFile + ".tmp";
+    auto fOut = std::unique_ptr<FILE, int(*)(FILE*)>( fopen( tmpFile.c_str(), "wb" ), &fclose );
+    if ( fOut == nullptr )
+    {
+        LOG_ERROR( "Failed to open thumbnail file ", tmpFile, '(', strerror( errno ), ')' );
+        return false;
+    }
+    auto written = fwrite( m_buffer.data(), 1, m_buffer.size(), fOut.get() );
+    // Close the file before checking for errors, since buffered data are
+    // only flushed then
+    if ( fclose( fOut.release() ) != 0 || written != m_buffer.size() )
+    {
+        LOG_ERROR( "Failed to write thumbnail file ", tmpFile, '(', strerror( errno ), ')' );
+        remove( tmpFile.c_str() );
+        return false;
+    }
+    if ( utils::fs::replace( tmpFile, outputFile ) == false )
+    {
+        LOG_ERROR( "Failed to move thumbnail file ", tmpFile, " to ", outputFile );
+        remove( tmpFile.c_str() );
+        return false;
+    }
     return true;
 }
 
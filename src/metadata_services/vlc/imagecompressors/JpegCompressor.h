@@ -24,6 +24,9 @@
 
 #include "IImageCompressor.h"
 
+#include <cstdint>
+#include <vector>
+
 namespace medialibrary
 {
 
@@ -37,6 +40,11 @@ public:
                           uint32_t inputWidth, uint32_t inputHeight,
                           uint32_t outputWidth, uint32_t outputHeight,
                           uint32_t hOffset, uint32_t vOffset) override;
+
+private:
+    // The encoded picture, reused from one thumbnail to another
+    std::vector<uint8_t> m_buffer;
+    std::vector<uint8_t*> m_rows;
 };
 
 }
@@ -33,16 +33,27 @@
 #include "Media.h"
 #include "File.h"
 #include "ParserService.h"
+#include "compat/Thread.h"
 
 namespace medialibrary
 {
 
+constexpr uint32_t Parser::RestoreChunkSize;
+constexpr uint32_t Parser::RestoreLowWatermark;
+
 Parser::Parser( MediaLibrary* ml )
     : m_ml( ml )
     , m_callback( ml->getCb() )
     , m_opToDo( 0 )
     , m_opDone( 0 )
     , m_percent( 0 )
+    , m_nbTasks( 0 )
+    , m_restoreLastId( 0 )
+    , m_restoreMaxId( 0 )
+    , m_nbUnrestored( 0 )
+    , m_maxBacklog( 0 )
+    , m_statsOpDone( 0 )
+    , m_statsStart( std::chrono::steady_clock::now() )
 {
 }
 
@@ -53,7 +64,7 @@ Parser::~Parser()
 
 void Parser::addService( ServicePtr service )
 {
-    service->initialize( m_ml, this );
+    service->initialize( m_ml, this, &m_pool );
     m_services.push_back( std::move( service ) );
 }
 
@@ -62,10 +73,12 @@ void Parser::parse( std::shared_ptr<File> file, std::shared_ptr<Media> media,
 {
     if ( m_services.empty() == true )
         return;
-    m_services[0]->parse( std::unique_ptr<parser::Task>( new parser::Task(
-                                                             std::move( file ),
-                                                             std::move( media ),
-                                                             mrl ) ) );
+    auto t = std::unique_ptr<parser::Task>( new parser::Task( std::move( file ),
+                                                              std::move( media ),
+                                                              mrl ) );
+    trackTask( *t );
+    ++m_nbTasks;
+    m_services[0]->parse( std::move( t ) );
     m_opToDo += m_services.size();
     updateStats();
 }
@@ -78,15 +91,25 @@ void Parser::parse( std::shared_ptr<fs::IFile> fileFs,
     if ( m_services.empty() == true )
         return;
     std::string mrl = fileFs->mrl();
-    m_services[0]->parse( std::unique_ptr<parser::Task>( new parser::Task(
+    auto t = std::unique_ptr<parser::Task>( new parser::Task(
             std::move( fileFs ), std::move( parentFolder ), std::move( parentFolderFs ),
-            std::move( parentPlaylist.first ), parentPlaylist.second, mrl ) ) );
+            std::move( parentPlaylist.first ), parentPlaylist.second, mrl ) );
+    trackTask( *t );
+    ++m_nbTasks;
+    m_services[0]->parse( std::move( t ) );
     m_opToDo += m_services.size();
     updateStats();
 }
 
 void Parser::start()
 {
+    // Ensure each service can run as many tasks as it allows, even when all
+    // the others are running lengthy tasks
+    auto nbTasks = 0u;
+    for ( const auto& s : m_services )
+        nbTasks += std::max<uint8_t>( 1u, s->nbThreads() );
+    auto nbWorkers = std::max( compat::Thread::hardware_concurrency(), nbTasks );
+    m_pool.start( std::max( nbWorkers, 1u ) );
     restore();
 }
 
@@ -118,19 +141,230 @@ void Parser::flush()
 {
     for ( auto& s : m_services )
         s->flush();
+    m_nbTasks = 0;
+    {
+        std::lock_guard<compat::Mutex> lock( m_priorityLock );
+        m_pendingMedia.clear();
+    }
+    {
+        std::lock_guard<compat::Mutex> lock( m_backlogLock );
+        m_backlogCond.notify_all();
+    }
+    // The flushed files must not be restored in the meantime
+    std::lock_guard<compat::Mutex> lock( m_restoreLock );
+    m_restoreLastId = m_restoreMaxId;
+    m_nbUnrestored = 0;
 }
 
 void Parser::restore()
 {
     if ( m_services.empty() == true )
         return;
+    {
+        std::lock_guard<compat::Mutex> lock( m_restoreLock );
+        m_restoreLastId = 0;
+        // The files created after this point are queued as they get discovered,
+        // so they must not be restored while their task is running
+        m_restoreMaxId = File::lastUnparsedId( m_ml );
+        m_nbUnrestored = m_restoreMaxId != 0 ?
+                    File::countUnparsed( m_ml, m_restoreMaxId ) : 0;
+    }
+    restoreChunk();
+}
 
-    auto files = File::fetchUnparsed( m_ml );
-    LOG_INFO( "Resuming parsing on ", files.size(), " mrl" );
-    for ( auto& f : files )
+void Parser::restoreChunk()
+{
+    std::vector<std::shared_ptr<File>> files;
     {
+        // If another thread is already fetching the next chunk, let it be
+        std::unique_lock<compat::Mutex> lock( m_restoreLock, std::try_to_lock );
+        if ( lock.owns_lock() == false || m_restoreLastId >= m_restoreMaxId )
+            return;
+        files = File::fetchUnparsed( m_ml, m_restoreLastId, m_restoreMaxId,
+                                     RestoreChunkSize );
+        if ( files.size() < RestoreChunkSize )
+        {
+            m_restoreLastId = m_restoreMaxId;
+            m_nbUnrestored = 0;
+        }
+        else
+        {
+            m_restoreLastId = files.back()->id();
+            auto nbUnrestored = m_nbUnrestored.load();
+            m_nbUnrestored = nbUnrestored > files.size() ?
+                        nbUnrestored - static_cast<uint32_t>( files.size() ) : 0;
+        }
+    }
+    // Only the queued tasks keep a reference to those files
+    for ( const auto& f : files )
         parse( f, f->media(), f->mrl() );
+    LOG_INFO( "Resumed parsing on ", files.size(), " mrl" );
+}
+
+void Parser::prioritize( int64_t mediaId )
+{
+    {
+        std::lock_guard<compat::Mutex> lock( m_priorityLock );
+        if ( m_prioritizedMedia.insert( mediaId ).second == false )
+            return;
+        // Its tasks will be flagged as they get queued
+        if ( m_pendingMedia.find( mediaId ) == end( m_pendingMedia ) )
+            return;
     }
+    // The previously prioritized tasks were already moved ahead, so only
+    // look for the tasks matching this media
+    prioritize( [mediaId]( const parser::Task& t ) {
+        return t.media != nullptr && t.media->id() == mediaId;
+    });
+}
+
+void Parser::prioritizeIfPending( int64_t mediaId )
+{
+    {
+        std::lock_guard<compat::Mutex> lock( m_priorityLock );
+        if ( m_pendingMedia.find( mediaId ) == end( m_pendingMedia ) ||
+             m_prioritizedMedia.insert( mediaId ).second == false )
+            return;
+    }
+    prioritize( [mediaId]( const parser::Task& t ) {
+        return t.media != nullptr && t.media->id() == mediaId;
+    });
+}
+
+void Parser::prioritize( const std::string& mrl )
+{
+    if ( mrl.empty() == true )
+    {
+        LOG_WARN( "Can't prioritize an empty mrl" );
+        return;
+    }
+    {
+        std::lock_guard<compat::Mutex> lock( m_priorityLock );
+        if ( std::find( begin( m_prioritizedMrls ), end( m_prioritizedMrls ), mrl ) !=
+             end( m_prioritizedMrls ) )
+            return;
+        m_prioritizedMrls.push_back( mrl );
+    }
+    prioritize( [&mrl]( const parser::Task& t ) {
+        return matchesMrl( t.mrl, mrl );
+    });
+}
+
+void Parser::prioritize( const std::function<bool(const parser::Task&)>& predicate )
+{
+    for ( auto& s : m_services )
+        s->prioritize( predicate );
+}
+
+bool Parser::matchesMrl( const std::string& taskMrl, const std::string& mrl )
+{
+    if ( mrl.empty() == true || taskMrl.compare( 0, mrl.size(), mrl ) != 0 )
+        return false;
+    // Either the same mrl, or a file in this folder
+    return taskMrl.size() == mrl.size() || mrl.back() == '/' ||
+           taskMrl[mrl.size()] == '/';
+}
+
+void Parser::setMaxBacklog( uint32_t nbTasks )
+{
+    std::lock_guard<compat::Mutex> lock( m_backlogLock );
+    m_maxBacklog = nbTasks;
+    m_backlogCond.notify_all();
+}
+
+void Parser::waitForBacklog()
+{
+    std::unique_lock<compat::Mutex> lock( m_backlogLock );
+    if ( m_maxBacklog == 0 || m_nbTasks <= m_maxBacklog )
+        return;
+    LOG_INFO( "Parser backlog reached ", m_nbTasks.load(), " tasks, waiting for it to shrink" );
+    m_backlogCond.wait( lock, [this]() {
+        return m_maxBacklog == 0 || m_nbTasks <= m_maxBacklog / 2;
+    });
+    LOG_INFO( "Parser backlog is down to ", m_nbTasks.load(), " tasks" );
+}
+
+ParserStats Parser::stats() const
+{
+    ParserStats s;
+    for ( const auto& service : m_services )
+        s.services.push_back( service->stats() );
+    for ( const auto& w : m_pool.stats() )
+        s.threads.push_back( ParserThreadStats{ w.busyDuration, w.idleDuration } );
+    // The files which weren't restored yet still need to go through all the
+    // services
+    uint32_t nbUnrestored = m_nbUnrestored;
+    s.nbPendingTasks = m_nbTasks + nbUnrestored;
+    {
+        std::lock_guard<compat::Mutex> lock( m_statsLock );
+        auto elapsed = std::chrono::steady_clock::now() - m_statsStart;
+        s.elapsed = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>( elapsed ).count() );
+    }
+    uint64_t opDone = m_opDone;
+    uint64_t opToDo = m_opToDo + static_cast<uint64_t>( nbUnrestored ) * m_services.size();
+    uint64_t statsOpDone = m_statsOpDone;
+    if ( opToDo > opDone && statsOpDone > 0 )
+        s.eta = ( opToDo - opDone ) * s.elapsed / statsOpDone;
+    else
+        s.eta = 0;
+    return s;
+}
+
+void Parser::resetStats()
+{
+    for ( auto& service : m_services )
+        service->resetStats();
+    m_pool.resetStats();
+    std::lock_guard<compat::Mutex> lock( m_statsLock );
+    m_statsOpDone = 0;
+    m_statsStart = std::chrono::steady_clock::now();
+}
+
+bool Parser::isPrioritizedLocked( const parser::Task& task ) const
+{
+    if ( task.media != nullptr &&
+         m_prioritizedMedia.find( task.media->id() ) != end( m_prioritizedMedia ) )
+        return true;
+    for ( const auto& mrl : m_prioritizedMrls )
+    {
+        if ( matchesMrl( task.mrl, mrl ) == true )
+            return true;
+    }
+    return false;
+}
+
+void Parser::trackTask( parser::Task& task )
+{
+    std::lock_guard<compat::Mutex> lock( m_priorityLock );
+    // The media is only known once the task was analyzed, and can change if
+    // the batch it was created in was rolled back
+    auto mediaId = task.media != nullptr ? task.media->id() : 0;
+    if ( mediaId != task.pendingMediaId )
+    {
+        untrackTaskLocked( task );
+        if ( mediaId != 0 )
+        {
+            ++m_pendingMedia[mediaId];
+            task.pendingMediaId = mediaId;
+        }
+    }
+    // The task might have been prioritized while it was running
+    if ( task.prioritized == false )
+        task.prioritized = isPrioritizedLocked( task );
+}
+
+void Parser::untrackTaskLocked( parser::Task& task )
+{
+    if ( task.pendingMediaId == 0 )
+        return;
+    auto it = m_pendingMedia.find( task.pendingMediaId );
+    if ( it != end( m_pendingMedia ) && --it->second == 0 )
+    {
+        m_pendingMedia.erase( it );
+        m_prioritizedMedia.erase( task.pendingMediaId );
+    }
+    task.pendingMediaId = 0;
 }
 
 void Parser::updateStats()
@@ -156,6 +390,7 @@ void Parser::updateStats()
 void Parser::done( std::unique_ptr<parser::Task> t, parser::Task::Status status )
 {
     ++m_opDone;
+    ++m_statsOpDone;
 
     auto serviceIdx = ++t->currentService;
 
@@ -169,6 +404,21 @@ void Parser::done( std::unique_ptr<parser::Task> t, parser::Task::Status status
             m_opToDo -= m_services.size() - serviceIdx;
         }
         updateStats();
+        {
+            std::lock_guard<compat::Mutex> lock( m_priorityLock );
+            untrackTaskLocked( *t );
+        }
+        auto nbTasks = --m_nbTasks;
+        if ( nbTasks < RestoreLowWatermark )
+            restoreChunk();
+        // The pending tasks can only shrink one at a time, so there's no need
+        // to wake the waiting threads up until exactly half of them remain
+        auto maxBacklog = m_maxBacklog.load();
+        if ( maxBacklog != 0 && nbTasks == maxBacklog / 2 )
+        {
+            std::lock_guard<compat::Mutex> lock( m_backlogLock );
+            m_backlogCond.notify_all();
+        }
         return;
     }
 
@@ -180,6 +430,7 @@ void Parser::done( std::unique_ptr<parser::Task> t, parser::Task::Status status
         LOG_INFO("Running parser chain again for ", t->mrl);
     }
     updateStats();
+    trackTask( *t );
     m_services[serviceIdx]->parse( std::move( t ) );
 }
 
@@ -200,6 +451,11 @@ void Parser::onIdleChanged( bool idle )
         if ( s->isIdle() == false )
             return;
     }
+    {
+        std::lock_guard<compat::Mutex> lock( m_priorityLock );
+        m_prioritizedMedia.clear();
+        m_prioritizedMrls.clear();
+    }
     m_ml->onParserIdleChanged( true );
 }
 
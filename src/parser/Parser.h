@@ -22,11 +22,18 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "Task.h"
 #include "File.h"
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "utils/ThreadPool.h"
 
 namespace medialibrary
 {
@@ -61,18 +68,77 @@ public:
     void resume();
     void stop();
     void flush();
-    // Queues all unparsed files for parsing.
+    ///
+    /// \brief restore Queues all unparsed files for parsing.
+    ///
+    /// The files are fetched by chunks, and the next chunk is only fetched
+    /// once most of the queued tasks are completed, so that the tasks aren't
+    /// all resident in memory at once.
+    ///
     void restore();
+    ///
+    /// \brief prioritize Runs the tasks of the provided media before the
+    /// other pending tasks, including the ones which are currently running
+    /// or haven't been queued yet.
+    /// The prioritized media are forgotten once the parser becomes idle.
+    ///
+    void prioritize( int64_t mediaId );
+    ///
+    /// \brief prioritize Same as above, for the media with the provided mrl,
+    /// or the media located in the folder with the provided mrl.
+    ///
+    void prioritize( const std::string& mrl );
+    ///
+    /// \brief prioritizeIfPending Same as prioritize( int64_t ), but only if
+    /// the media has a task in progress. This doesn't scan the pending tasks
+    /// otherwise, and the media isn't remembered for later.
+    ///
+    void prioritizeIfPending( int64_t mediaId );
+    ///
+    /// \brief setMaxBacklog Sets the number of pending tasks above which
+    /// waitForBacklog() blocks. 0 disables the limit, and releases the
+    /// threads currently waiting.
+    ///
+    void setMaxBacklog( uint32_t nbTasks );
+    ///
+    /// \brief waitForBacklog Blocks until half of the pending tasks are
+    /// completed, if their number exceeds the maximum backlog.
+    ///
+    /// This must not be called while holding a transaction, nor from a
+    /// parser thread, as this would prevent the tasks from completing.
+    ///
+    void waitForBacklog();
+    ParserStats stats() const;
+    void resetStats();
 
 private:
     void updateStats();
+    // Queues the next chunk of unparsed files, if any
+    void restoreChunk();
+    // Moves the pending tasks matching the predicate ahead, in all services
+    void prioritize( const std::function<bool(const parser::Task&)>& predicate );
+    // Returns true if the task mrl is the prioritized mrl, or is located in
+    // the prioritized folder
+    static bool matchesMrl( const std::string& taskMrl, const std::string& mrl );
+    bool isPrioritizedLocked( const parser::Task& task ) const;
+    // Indexes the task under its current media, and flags it as prioritized
+    // if it needs to be
+    void trackTask( parser::Task& task );
+    // Removes the task from the index. Once a media doesn't have any task
+    // left, it is also forgotten from the prioritized media
+    void untrackTaskLocked( parser::Task& task );
     virtual void done( std::unique_ptr<parser::Task> task, parser::Task::Status status ) override;
     virtual void onIdleChanged( bool idle ) override;
 
 private:
     typedef std::vector<ServicePtr> ServiceList;
+    static constexpr uint32_t RestoreChunkSize = 256;
+    // The next chunk is fetched when less than this many tasks are remaining
+    static constexpr uint32_t RestoreLowWatermark = 64;
 
 private:
+    // Declared before the services, so it outlives them
+    ThreadPool m_pool;
     ServiceList m_services;
 
     MediaLibrary* m_ml;
@@ -81,6 +147,30 @@ private:
     std::atomic_uint m_opDone;
     std::atomic_uint m_percent;
     std::chrono::time_point<std::chrono::steady_clock> m_chrono;
+    // The number of tasks which aren't completed yet
+    std::atomic_uint m_nbTasks;
+
+    // The restored files ids are in the ]m_restoreLastId;m_restoreMaxId] range
+    compat::Mutex m_restoreLock;
+    int64_t m_restoreLastId;
+    int64_t m_restoreMaxId;
+    // The number of unparsed files which haven't been restored yet
+    std::atomic_uint m_nbUnrestored;
+
+    compat::Mutex m_backlogLock;
+    compat::ConditionVariable m_backlogCond;
+    std::atomic_uint m_maxBacklog;
+
+    // The number of operations done since the statistics were reset
+    std::atomic_uint m_statsOpDone;
+    mutable compat::Mutex m_statsLock;
+    std::chrono::steady_clock::time_point m_statsStart;
+
+    mutable compat::Mutex m_priorityLock;
+    std::unordered_set<int64_t> m_prioritizedMedia;
+    // The number of tasks in progress for each media
+    std::unordered_map<int64_t, uint32_t> m_pendingMedia;
+    std::vector<std::string> m_prioritizedMrls;
 };
 
 }
@@ -26,11 +26,28 @@
 
 #include "ParserService.h"
 #include "Parser.h"
+#include "Album.h"
+#include "AlbumTrack.h"
+#include "Artist.h"
 #include "Media.h"
+#include "compat/Thread.h"
+#include "utils/ModificationsNotifier.h"
+#include "utils/ThreadPool.h"
+
+#include <algorithm>
 
 namespace medialibrary
 {
 
+static_assert( ParserServiceStats::NbLatencyBuckets == utils::LatencyHistogram::NbBuckets,
+               "Mismatching latency histogram size" );
+
+namespace
+{
+// Maximum delay before the changes of a batch get committed
+const auto MaxBatchDuration = std::chrono::milliseconds{ 250 };
+}
+
 ParserService::ParserService()
     : m_ml( nullptr )
     , m_cb( nullptr )
@@ -38,17 +55,19 @@ ParserService::ParserService()
     , m_stopParser( false )
     , m_paused( false )
     , m_idle( true )
+    , m_notifiedIdle( true )
+    , m_notifyingIdle( false )
+    , m_pool( nullptr )
+    , m_nbRunning( 0 )
+    , m_nbNotifying( 0 )
+    , m_nbCompleted( 0 )
+    , m_nbSkipped( 0 )
+    , m_nbFailed( 0 )
+    , m_nbUnavailable( 0 )
+    , m_nbRetried( 0 )
 {
 }
 
-void ParserService::start()
-{
-    // Ensure we don't start multiple times.
-    assert( m_threads.size() == 0 );
-    for ( auto i = 0u; i < nbThreads(); ++i )
-        m_threads.emplace_back( &ParserService::mainloop, this );
-}
-
 void ParserService::pause()
 {
     std::lock_guard<compat::Mutex> lock( m_lock );
@@ -57,57 +76,73 @@ void ParserService::pause()
 
 void ParserService::resume()
 {
-    std::lock_guard<compat::Mutex> lock( m_lock );
-    m_paused = false;
-    m_cond.notify_all();
+    {
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        m_paused = false;
+        scheduleLocked();
+    }
+    notifyIdleChanged();
 }
 
 void ParserService::signalStop()
 {
-    for ( auto& t : m_threads )
-    {
-        if ( t.joinable() )
-        {
-            {
-                std::lock_guard<compat::Mutex> lock( m_lock );
-                m_cond.notify_all();
-                m_stopParser = true;
-            }
-        }
-    }
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    m_stopParser = true;
 }
 
 void ParserService::stop()
 {
-    for ( auto& t : m_threads )
-    {
-        if ( t.joinable() )
-            t.join();
-    }
+    std::unique_lock<compat::Mutex> lock( m_lock );
+    m_idleCond.wait( lock, [this]() {
+        return m_nbRunning == 0 && m_nbNotifying == 0 && m_notifyingIdle == false;
+    });
 }
 
 void ParserService::parse( std::unique_ptr<parser::Task> t )
 {
-    if ( m_threads.size() == 0 )
     {
-        // Since the thread isn't started, no need to lock the mutex before pushing the task
-        m_tasks.push( std::move( t ) );
-        start();
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        if ( t->prioritized == true )
+            m_priorityTasks.push_back( std::move( t ) );
+        else
+            m_tasks.push_back( std::move( t ) );
+        scheduleLocked();
     }
-    else
+    notifyIdleChanged();
+}
+
+void ParserService::prioritize( const std::function<bool(const parser::Task&)>& predicate )
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    auto it = std::find_if( begin( m_tasks ), end( m_tasks ),
+                            [&predicate]( const std::unique_ptr<parser::Task>& t ) {
+        return predicate( *t );
+    });
+    if ( it == end( m_tasks ) )
+        return;
+    // Only move the matching tasks, and the ones following them
+    auto last = it;
+    for ( ; it != end( m_tasks ); ++it )
     {
-        std::lock_guard<compat::Mutex> lock( m_lock );
-        m_tasks.push( std::move( t ) );
-        m_cond.notify_all();
+        if ( predicate( **it ) == true )
+        {
+            (*it)->prioritized = true;
+            m_priorityTasks.push_back( std::move( *it ) );
+        }
+        else
+            *last++ = std::move( *it );
     }
+    m_tasks.erase( last, end( m_tasks ) );
 }
 
-void ParserService::initialize( MediaLibrary* ml, IParserCb* parserCb )
+void ParserService::initialize( MediaLibrary* ml, IParserCb* parserCb, ThreadPool* pool )
 {
     m_ml = ml;
     m_cb = ml->getCb();
     m_notifier = ml->getNotifier();
     m_parserCb = parserCb;
+    m_pool = pool;
+    m_name = name();
     // Run the service specific initializer
     initialize();
 }
@@ -120,12 +155,43 @@ bool ParserService::isIdle() const
 void ParserService::flush()
 {
     std::unique_lock<compat::Mutex> lock( m_lock );
-    assert( m_paused == true || m_threads.empty() == true );
+    assert( m_paused == true || m_nbRunning == 0 );
     m_idleCond.wait( lock, [this]() {
-        return m_idle == true;
+        return m_nbRunning == 0 && m_nbNotifying == 0 && m_notifyingIdle == false;
     });
-    while ( m_tasks.empty() == false )
-        m_tasks.pop();
+    m_priorityTasks.clear();
+    m_tasks.clear();
+}
+
+ParserServiceStats ParserService::stats() const
+{
+    ParserServiceStats s;
+    s.name = m_name;
+    {
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        s.nbQueuedTasks = static_cast<uint32_t>( m_priorityTasks.size() + m_tasks.size() );
+        s.nbRunningJobs = m_nbRunning;
+    }
+    s.maxRunningJobs = std::max<uint8_t>( 1u, nbThreads() );
+    s.nbCompleted = m_nbCompleted.load( std::memory_order_relaxed );
+    s.nbSkipped = m_nbSkipped.load( std::memory_order_relaxed );
+    s.nbFailed = m_nbFailed.load( std::memory_order_relaxed );
+    s.nbUnavailable = m_nbUnavailable.load( std::memory_order_relaxed );
+    s.nbRetried = m_nbRetried.load( std::memory_order_relaxed );
+    s.totalDuration = m_latencies.totalDuration();
+    s.maxDuration = m_latencies.maxDuration();
+    s.latencies = m_latencies.buckets();
+    return s;
+}
+
+void ParserService::resetStats()
+{
+    m_nbCompleted.store( 0, std::memory_order_relaxed );
+    m_nbSkipped.store( 0, std::memory_order_relaxed );
+    m_nbFailed.store( 0, std::memory_order_relaxed );
+    m_nbUnavailable.store( 0, std::memory_order_relaxed );
+    m_nbRetried.store( 0, std::memory_order_relaxed );
+    m_latencies.reset();
 }
 
 uint8_t ParserService::nbNativeThreads() const
@@ -141,81 +207,374 @@ bool ParserService::initialize()
     return true;
 }
 
-void ParserService::mainloop()
+uint32_t ParserService::maxBatchSize() const
+{
+    return 1;
+}
+
+void ParserService::prepareBatch( std::vector<parser::Task*>& )
 {
-    // It would be unsafe to call name() at the end of this function, since
-    // we might stop the thread during ParserService destruction. This implies
-    // that the underlying service has been deleted already.
-    std::string serviceName = name();
-    LOG_INFO("Entering ParserService [", serviceName, "] thread");
-    setIdle( false );
+}
+
+void ParserService::onBatchRolledBack()
+{
+}
+
+void ParserService::scheduleLocked()
+{
+    if ( m_stopParser == true || m_paused == true )
+        return;
+    auto maxJobs = std::min<size_t>( std::max<uint8_t>( 1u, nbThreads() ),
+                                     m_priorityTasks.size() + m_tasks.size() );
+    if ( m_nbRunning >= maxJobs )
+        return;
+    if ( m_idle == true )
+    {
+        LOG_INFO( "Resuming ParserService [", m_name, "]" );
+        m_idle = false;
+    }
+    while ( m_nbRunning < maxJobs )
+    {
+        ++m_nbRunning;
+        m_pool->submit( [this]() { runJob(); } );
+    }
+}
 
-    while ( m_stopParser == false )
+void ParserService::runJob()
+{
+    size_t batchSize = std::max( 1u, maxBatchSize() );
+    std::vector<std::unique_ptr<parser::Task>> tasks;
     {
-        std::unique_ptr<parser::Task> task;
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        if ( m_stopParser == false && m_paused == false )
         {
-            std::unique_lock<compat::Mutex> lock( m_lock );
-            if ( m_tasks.empty() == true || m_paused == true )
+            LOG_INFO('[', m_name, "] has ", m_priorityTasks.size() + m_tasks.size(),
+                     " tasks remaining, ", m_priorityTasks.size(), " of them being prioritized" );
+            // When batching, take all the tasks we can process in a single
+            // batch, but don't wait for more tasks to come
+            for ( auto queue : { &m_priorityTasks, &m_tasks } )
             {
-                LOG_INFO( "Halting ParserService [", serviceName, "] mainloop" );
-                setIdle( true );
-                m_idleCond.notify_all();
-                m_cond.wait( lock, [this]() {
-                    return ( m_tasks.empty() == false && m_paused == false )
-                            || m_stopParser == true;
-                });
-                LOG_INFO( "Resuming ParserService [", serviceName, "] mainloop" );
-                // We might have been woken up because the parser is being destroyed
-                if ( m_stopParser  == true )
-                    break;
-                setIdle( false );
+                while ( tasks.size() < batchSize && queue->empty() == false )
+                {
+                    tasks.push_back( std::move( queue->front() ) );
+                    queue->pop_front();
+                }
             }
-            // Otherwise it's safe to assume we have at least one element.
-            LOG_INFO('[', serviceName, "] has ", m_tasks.size(), " tasks remaining" );
-            task = std::move( m_tasks.front() );
-            m_tasks.pop();
         }
-        if ( isCompleted( *task ) == true )
+    }
+    auto it = std::remove_if( begin( tasks ), end( tasks ),
+                              [this]( std::unique_ptr<parser::Task>& task ) {
+        if ( isCompleted( *task ) == false )
+            return false;
+        LOG_INFO( "Skipping completed task [", m_name, "] on ", task->mrl );
+        m_nbSkipped.fetch_add( 1, std::memory_order_relaxed );
+        m_parserCb->done( std::move( task ), parser::Task::Status::Success );
+        return true;
+    });
+    tasks.erase( it, end( tasks ) );
+    if ( batchSize == 1 )
+    {
+        for ( auto& task : tasks )
+        {
+            auto status = runTask( *task, m_name );
+            done( std::move( task ), status );
+        }
+    }
+    else if ( tasks.empty() == false )
+        runBatch( std::move( tasks ), m_name );
+
+    {
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        --m_nbRunning;
+        // Give the other services' jobs a chance to run before processing the
+        // next batch, by submitting a new job instead of looping
+        scheduleLocked();
+        if ( m_nbRunning == 0 )
         {
-            LOG_INFO( "Skipping completed task [", serviceName, "] on ", task->mrl );
-            m_parserCb->done( std::move( task ), parser::Task::Status::Success );
+            LOG_INFO( "Halting ParserService [", m_name, "]" );
+            m_idle = true;
+        }
+        // Prevent the service from being stopped until the idle state change
+        // has been notified
+        ++m_nbNotifying;
+    }
+    notifyIdleChanged();
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    --m_nbNotifying;
+    if ( m_nbRunning == 0 && m_nbNotifying == 0 )
+        m_idleCond.notify_all();
+}
+
+void ParserService::runBatch( std::vector<std::unique_ptr<parser::Task>> tasks,
+                              const std::string& serviceName )
+{
+    // All the tasks changes are written in a single transaction, and the tasks
+    // completion is only reported once it has been committed, so the next
+    // services don't run before the changes are visible.
+    std::vector<BatchedTask> batchedTasks;
+    batchedTasks.reserve( tasks.size() );
+    for ( auto& t : tasks )
+        batchedTasks.emplace_back( std::move( t ) );
+
+    std::unique_ptr<sqlite::Transaction> batch;
+    try
+    {
+        batch = m_ml->getConn()->newTransaction();
+    }
+    catch ( const std::exception& ex )
+    {
+        LOG_ERROR( "Failed to start a batch [", serviceName, "]: ", ex.what() );
+        for ( auto& t : batchedTasks )
+        {
+            auto status = runTask( *t.task, serviceName );
+            done( std::move( t.task ), status );
+        }
+        return;
+    }
+    prepareTasks( begin( batchedTasks ), end( batchedTasks ), serviceName );
+
+    auto first = begin( batchedTasks );
+    auto batchStart = std::chrono::steady_clock::now();
+    for ( auto it = begin( batchedTasks ); it != end( batchedTasks ); )
+    {
+        // Tasks which couldn't be restored after a rollback are already failed
+        if ( it->status == parser::Task::Status::Unknown )
+            it->status = runTask( *it->task, serviceName );
+        ++it;
+        if ( it == end( batchedTasks ) ||
+             std::chrono::steady_clock::now() - batchStart < MaxBatchDuration )
             continue;
+        // Don't hold the write lock for too long, and start a new batch for the
+        // remaining tasks
+        auto committed = commitBatch( std::move( batch ), first, it, serviceName );
+        first = it;
+        for ( auto remaining = it; remaining != end( batchedTasks ); ++remaining )
+        {
+            // Their prepared changes are now committed
+            if ( committed == true )
+                remaining->snapshot();
+            // Otherwise, the rows prepareBatch created for them were rolled
+            // back along with the batch, and they need to start over
+            else if ( remaining->restore( m_ml ) == false )
+            {
+                LOG_WARN( "Failed to restore ", remaining->task->mrl, " state" );
+                remaining->status = parser::Task::Status::Fatal;
+            }
         }
-        parser::Task::Status status;
         try
         {
-            LOG_INFO( "Executing ", serviceName, " task on ", task->mrl );
-            auto chrono = std::chrono::steady_clock::now();
-            if ( ( task->file != nullptr && task->file->isDeleted() )
-                 || ( task->media != nullptr && task->media->isDeleted() ) )
-                status = parser::Task::Status::Fatal;
-            else
+            batch = m_ml->getConn()->newTransaction();
+        }
+        catch ( const std::exception& ex )
+        {
+            LOG_ERROR( "Failed to start a batch [", serviceName, "]: ", ex.what() );
+        }
+        if ( committed == false )
+            prepareTasks( it, end( batchedTasks ), serviceName );
+        batchStart = std::chrono::steady_clock::now();
+    }
+    commitBatch( std::move( batch ), first, end( batchedTasks ), serviceName );
+}
+
+void ParserService::prepareTasks( std::vector<BatchedTask>::iterator first,
+                                  std::vector<BatchedTask>::iterator last,
+                                  const std::string& serviceName )
+{
+    try
+    {
+        std::vector<parser::Task*> toPrepare;
+        toPrepare.reserve( std::distance( first, last ) );
+        for ( auto it = first; it != last; ++it )
+        {
+            if ( it->status == parser::Task::Status::Unknown )
+                toPrepare.push_back( it->task.get() );
+        }
+        prepareBatch( toPrepare );
+    }
+    catch ( const std::exception& ex )
+    {
+        LOG_WARN( "Failed to prepare a batch [", serviceName, "]: ", ex.what() );
+    }
+}
+
+void ParserService::done( std::unique_ptr<parser::Task> task, parser::Task::Status status )
+{
+    switch ( status )
+    {
+        case parser::Task::Status::Success:
+            m_nbCompleted.fetch_add( 1, std::memory_order_relaxed );
+            break;
+        case parser::Task::Status::TemporaryUnavailable:
+            m_nbUnavailable.fetch_add( 1, std::memory_order_relaxed );
+            break;
+        default:
+            m_nbFailed.fetch_add( 1, std::memory_order_relaxed );
+            break;
+    }
+    notifyCreations( *task );
+    m_parserCb->done( std::move( task ), status );
+}
+
+void ParserService::notifyCreations( parser::Task& task )
+{
+    if ( task.mediaCreated == true && task.media != nullptr )
+        m_notifier->notifyMediaCreation( task.media );
+    for ( auto& a : task.createdAlbums )
+        m_notifier->notifyAlbumCreation( std::move( a ) );
+    for ( auto& a : task.createdArtists )
+        m_notifier->notifyArtistCreation( std::move( a ) );
+    for ( auto& t : task.createdTracks )
+        m_notifier->notifyAlbumTrackCreation( std::move( t ) );
+    task.mediaCreated = false;
+    task.createdAlbums.clear();
+    task.createdArtists.clear();
+    task.createdTracks.clear();
+}
+
+parser::Task::Status ParserService::runTask( parser::Task& task, const std::string& serviceName )
+{
+    try
+    {
+        LOG_INFO( "Executing ", serviceName, " task on ", task.mrl );
+        auto chrono = std::chrono::steady_clock::now();
+        if ( ( task.file != nullptr && task.file->isDeleted() )
+             || ( task.media != nullptr && task.media->isDeleted() ) )
+            return parser::Task::Status::Fatal;
+        if ( task.file != nullptr )
+            task.file->startParserStep(); // FIXME ?
+        auto status = run( task );
+        auto duration = std::chrono::steady_clock::now() - chrono;
+        m_latencies.record( duration );
+        LOG_INFO( "Done executing ", serviceName, " task on ", task.mrl, " in ",
+                  std::chrono::duration_cast<std::chrono::milliseconds>( duration ).count(), "ms" );
+        return status;
+    }
+    catch ( const std::exception& ex )
+    {
+        LOG_ERROR( "Caught an exception during ", task.mrl, " [", serviceName, "] parsing: ", ex.what() );
+        return parser::Task::Status::Fatal;
+    }
+}
+
+bool ParserService::commitBatch( std::unique_ptr<sqlite::Transaction> batch,
+                                 std::vector<BatchedTask>::iterator first,
+                                 std::vector<BatchedTask>::iterator last,
+                                 const std::string& serviceName )
+{
+    auto nbTasks = std::distance( first, last );
+    auto committed = true;
+    try
+    {
+        // A null batch means the tasks were run without batching
+        if ( batch != nullptr )
+        {
+            batch->commit();
+            LOG_DEBUG( '[', serviceName, "] committed a batch of ", nbTasks, " tasks" );
+        }
+    }
+    catch ( const std::exception& ex )
+    {
+        LOG_ERROR( "Failed to commit a batch of ", nbTasks, " tasks [",
+                   serviceName, "]: ", ex.what(), ". Retrying them one by one" );
+        // Rollback, and let the caches know about it
+        batch.reset();
+        onBatchRolledBack();
+        for ( auto it = first; it != last; ++it )
+        {
+            m_nbRetried.fetch_add( 1, std::memory_order_relaxed );
+            if ( it->restore( m_ml ) == false )
             {
-                if ( task->file != nullptr )
-                    task->file->startParserStep(); // FIXME ?
-                status = run( *task );
-                auto duration = std::chrono::steady_clock::now() - chrono;
-                LOG_INFO( "Done executing ", serviceName, " task on ", task->mrl, " in ",
-                          std::chrono::duration_cast<std::chrono::milliseconds>( duration ).count(), "ms" );
+                LOG_WARN( "Failed to restore ", it->task->mrl, " state. Not retrying" );
+                it->status = parser::Task::Status::Fatal;
+                continue;
             }
+            it->status = runTask( *it->task, serviceName );
         }
-        catch ( const std::exception& ex )
+        committed = false;
+    }
+    for ( auto it = first; it != last; ++it )
+        done( std::move( it->task ), it->status );
+    return committed;
+}
+
+ParserService::BatchedTask::BatchedTask( std::unique_ptr<parser::Task> t )
+    : task( std::move( t ) )
+    , status( parser::Task::Status::Unknown )
+{
+    snapshot();
+}
+
+void ParserService::BatchedTask::snapshot()
+{
+    media = task->media;
+    file = task->file;
+    step = task->step;
+}
+
+bool ParserService::BatchedTask::restore( MediaLibraryPtr ml )
+{
+    task->step = step;
+    // The created entities were rolled back, and mustn't be notified
+    task->mediaCreated = false;
+    task->createdAlbums.clear();
+    task->createdArtists.clear();
+    task->createdTracks.clear();
+    // The cached instances may hold changes which were rolled back, so the
+    // entities are reloaded from the database. The ones created since the
+    // snapshot don't exist anymore, but their ids could be reused
+    if ( task->media != nullptr && task->media != media )
+        Media::removeFromCache( task->media->id() );
+    if ( task->file != nullptr && task->file != file )
+        File::removeFromCache( task->file->id() );
+    task->media = nullptr;
+    task->file = nullptr;
+    try
+    {
+        if ( media != nullptr )
         {
-            LOG_ERROR( "Caught an exception during ", task->mrl, " [", serviceName, "] parsing: ", ex.what() );
-            status = parser::Task::Status::Fatal;
+            Media::removeFromCache( media->id() );
+            task->media = Media::fetch( ml, media->id() );
+            if ( task->media == nullptr )
+                return false;
         }
-        m_parserCb->done( std::move( task ), status );
+        if ( file != nullptr )
+        {
+            File::removeFromCache( file->id() );
+            task->file = File::fetch( ml, file->id() );
+            if ( task->file == nullptr )
+                return false;
+        }
+    }
+    catch ( const sqlite::errors::Generic& ex )
+    {
+        LOG_ERROR( "Failed to reload ", task->mrl, " entities: ", ex.what() );
+        return false;
     }
-    LOG_INFO("Exiting ParserService [", serviceName, "] thread");
-    setIdle( true );
+    media = task->media;
+    file = task->file;
+    return true;
 }
 
-void ParserService::setIdle(bool isIdle)
+void ParserService::notifyIdleChanged()
 {
-    // Calling the idleChanged callback will trigger a call to isIdle, so set the value before
-    // invoking it, otherwise we have an incoherent state.
-    m_idle = isIdle;
-    m_parserCb->onIdleChanged( isIdle );
+    std::unique_lock<compat::Mutex> lock( m_lock );
+    // Only one thread notifies the changes at a time, so they can't be
+    // reordered. It will also notify the changes made while it's notifying.
+    if ( m_notifyingIdle == true )
+        return;
+    m_notifyingIdle = true;
+    while ( m_idle != m_notifiedIdle )
+    {
+        // The idle state is set before invoking the callback, since it will
+        // trigger a call to isIdle
+        bool idle = m_idle;
+        m_notifiedIdle = idle;
+        lock.unlock();
+        m_parserCb->onIdleChanged( idle );
+        lock.lock();
+    }
+    m_notifyingIdle = false;
+    m_idleCond.notify_all();
 }
 
 }
@@ -23,14 +23,18 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include "compat/ConditionVariable.h"
-#include <queue>
+#include <deque>
+#include <functional>
 
 #include "Task.h"
 #include "medialibrary/Types.h"
+#include "medialibrary/IMediaLibrary.h"
 #include "compat/Mutex.h"
-#include "compat/Thread.h"
+#include "database/SqliteTransaction.h"
 #include "File.h"
+#include "utils/LatencyHistogram.h"
 
 namespace medialibrary
 {
@@ -38,6 +42,7 @@ namespace medialibrary
 class IParserCb;
 class ModificationNotifier;
 class MediaLibrary;
+class ThreadPool;
 
 class ParserService
 {
@@ -48,19 +53,28 @@ public:
     void pause();
     void resume();
     ///
-    /// \brief signalStop Will trigger the threads for termination.
-    /// This doesn't wait for the threads to be done, but ensure they won't
-    /// queue another operation.
-    /// This is usefull to ask all the threads to terminate asynchronously, before
-    /// waiting for them to actually stop in the stop() method.
+    /// \brief signalStop Will trigger the service termination.
+    /// This doesn't wait for the running tasks to be done, but ensure the
+    /// service won't run another one.
+    /// This is usefull to ask all the services to terminate asynchronously,
+    /// before waiting for them to actually stop in the stop() method.
     ///
     void signalStop();
     ///
-    /// \brief stop Effectively wait the the underlying threads to join.
+    /// \brief stop Effectively wait for the running tasks to complete.
     ///
     void stop();
     void parse( std::unique_ptr<parser::Task> t );
-    void initialize( MediaLibrary* mediaLibrary, IParserCb* parserCb );
+    ///
+    /// \brief prioritize Flags the pending tasks matching the predicate as
+    /// prioritized, and moves them ahead of the other pending tasks.
+    ///
+    void prioritize( const std::function<bool(const parser::Task&)>& predicate );
+    ///
+    /// \brief initialize Initializes the service
+    /// \param pool The pool running the tasks, shared by all services
+    ///
+    void initialize( MediaLibrary* mediaLibrary, IParserCb* parserCb, ThreadPool* pool );
     bool isIdle() const;
     ///
     /// \brief flush flush every currently scheduled tasks
@@ -68,6 +82,16 @@ public:
     /// The service needs to be previously paused or unstarted
     ///
     virtual void flush();
+    ///
+    /// \brief nbThreads Returns the maximum number of tasks this service can
+    /// run concurrently.
+    ///
+    /// The tasks are run by the parser's shared thread pool, this is only
+    /// a cap, and doesn't reserve any thread.
+    ///
+    virtual uint8_t nbThreads() const = 0;
+    ParserServiceStats stats() const;
+    void resetStats();
 
 protected:
     uint8_t nbNativeThreads() const;
@@ -75,14 +99,80 @@ protected:
     virtual bool initialize();
     virtual parser::Task::Status run( parser::Task& task ) = 0;
     virtual const char* name() const = 0;
-    virtual uint8_t nbThreads() const = 0;
     virtual bool isCompleted( const parser::Task& task ) const = 0;
+    ///
+    /// \brief maxBatchSize Returns the maximum number of tasks whose database
+    /// changes can be committed in a single transaction.
+    ///
+    /// The write lock is held until the batch gets committed, so only services
+    /// which don't run lengthy operations should batch their changes.
+    /// Defaults to 1, meaning no batching.
+    ///
+    virtual uint32_t maxBatchSize() const;
+    ///
+    /// \brief prepareBatch Invoked with the tasks of a batch before they are
+    /// run, from within the batch transaction.
+    ///
+    /// This allows a service to perform the database operations shared by all
+    /// the tasks in bulk.
+    ///
+    virtual void prepareBatch( std::vector<parser::Task*>& tasks );
+    ///
+    /// \brief onBatchRolledBack Invoked when a batch failed to be committed.
+    ///
+    /// Services must drop any state that could refer to the rolled back
+    /// changes, including the cached entities they modified, before the
+    /// batched tasks are run again, one by one. The tasks' media & file are
+    /// reloaded from the database by the base implementation.
+    ///
+    virtual void onBatchRolledBack();
 
 private:
-    // Thread(s) entry point
-    void start();
-    void mainloop();
-    void setIdle( bool isIdle );
+    struct BatchedTask
+    {
+        BatchedTask( std::unique_ptr<parser::Task> t );
+        // Saves the task state, or restores it after its changes were rolled
+        // back. Returns false if the task entities can't be restored.
+        void snapshot();
+        bool restore( MediaLibraryPtr ml );
+
+        std::unique_ptr<parser::Task> task;
+        parser::Task::Status status;
+        // The task state before it ran, so it can be run again
+        std::shared_ptr<Media> media;
+        std::shared_ptr<File> file;
+        parser::Task::ParserStep step;
+    };
+
+    // Submits as many jobs as needed to the pool. Must be called with m_lock held
+    void scheduleLocked();
+    // Pool job: runs a single batch of tasks, and schedules the next one
+    void runJob();
+    ///
+    /// \brief notifyIdleChanged Notifies the idle state changes to the parser.
+    ///
+    /// The state is changed while holding m_lock, but this must be called
+    /// once it has been released, since the callback reaches the application.
+    ///
+    void notifyIdleChanged();
+    // Accounts for the task outcome, and hands it back to the parser. The
+    // task changes must have been committed already.
+    void done( std::unique_ptr<parser::Task> task, parser::Task::Status status );
+    // Notifies the entities created by the task, now that they're committed
+    void notifyCreations( parser::Task& task );
+    parser::Task::Status runTask( parser::Task& task, const std::string& serviceName );
+    void runBatch( std::vector<std::unique_ptr<parser::Task>> tasks,
+                   const std::string& serviceName );
+    // Invokes prepareBatch with the tasks which haven't failed yet
+    void prepareTasks( std::vector<BatchedTask>::iterator first,
+                       std::vector<BatchedTask>::iterator last,
+                       const std::string& serviceName );
+    // Returns false if the batch was rolled back, in which case its tasks
+    // were run again without batching
+    bool commitBatch( std::unique_ptr<sqlite::Transaction> batch,
+                      std::vector<BatchedTask>::iterator first,
+                      std::vector<BatchedTask>::iterator last,
+                      const std::string& serviceName );
 
 protected:
     MediaLibrary* m_ml;
@@ -94,11 +184,30 @@ private:
     bool m_stopParser;
     bool m_paused;
     std::atomic_bool m_idle;
-    compat::ConditionVariable m_cond;
+    // The last idle state notified to the parser, and whether a thread is
+    // notifying it. Both are protected by m_lock
+    bool m_notifiedIdle;
+    bool m_notifyingIdle;
+    ThreadPool* m_pool;
+    // Cached, since it can't be called once the service is being destroyed
+    std::string m_name;
+    // The number of jobs submitted to the pool and not completed yet
+    uint32_t m_nbRunning;
+    // The number of completed jobs which are notifying an idle state change
+    uint32_t m_nbNotifying;
     compat::ConditionVariable m_idleCond;
-    std::queue<std::unique_ptr<parser::Task>> m_tasks;
-    std::vector<compat::Thread> m_threads;
-    compat::Mutex m_lock;
+    // Pending tasks, the prioritized ones being run first
+    std::deque<std::unique_ptr<parser::Task>> m_priorityTasks;
+    std::deque<std::unique_ptr<parser::Task>> m_tasks;
+    mutable compat::Mutex m_lock;
+
+    // Statistics, only updated using relaxed atomic operations
+    std::atomic<uint64_t> m_nbCompleted;
+    std::atomic<uint64_t> m_nbSkipped;
+    std::atomic<uint64_t> m_nbFailed;
+    std::atomic<uint64_t> m_nbUnavailable;
+    std::atomic<uint64_t> m_nbRetried;
+    utils::LatencyHistogram m_latencies;
 };
 
 }
@@ -29,6 +29,7 @@
 
 #include "filesystem/IFile.h"
 #include "File.h"
+#include "metadata_services/native/TagReader.h"
 
 namespace medialibrary
 {
@@ -43,6 +44,9 @@ Task::Task( std::shared_ptr<File> file, std::shared_ptr<Media> media,
     , mrl( std::move( mrl ) )
     , currentService( 0 )
     , step( this->file->parserStep() )
+    , prioritized( false )
+    , pendingMediaId( 0 )
+    , mediaCreated( false )
 {
 }
 
@@ -60,6 +64,9 @@ Task::Task( std::shared_ptr<fs::IFile> fileFs,
     , mrl( std::move( mrl ) )
     , currentService( 0 )
     , step( ParserStep::None )
+    , prioritized( false )
+    , pendingMediaId( 0 )
+    , mediaCreated( false )
 {
 }
 
@@ -77,6 +84,42 @@ void Task::markStepUncompleted( ParserStep stepUncompleted )
         file->markStepUncompleted( stepUncompleted );
 }
 
+std::string Task::meta( libvlc_meta_t meta )
+{
+    if ( tags == nullptr )
+        return vlcMedia.meta( meta );
+    switch ( meta )
+    {
+        case libvlc_meta_Title:
+            return tags->title;
+        case libvlc_meta_Artist:
+            return tags->artist;
+        case libvlc_meta_AlbumArtist:
+            return tags->albumArtist;
+        case libvlc_meta_Album:
+            return tags->album;
+        case libvlc_meta_Genre:
+            return tags->genre;
+        case libvlc_meta_Date:
+            return tags->date;
+        case libvlc_meta_TrackNumber:
+            return tags->trackNumber != 0 ? std::to_string( tags->trackNumber ) : std::string{};
+        case libvlc_meta_DiscNumber:
+            return tags->discNumber != 0 ? std::to_string( tags->discNumber ) : std::string{};
+        case libvlc_meta_DiscTotal:
+            return tags->discTotal != 0 ? std::to_string( tags->discTotal ) : std::string{};
+        default:
+            return {};
+    }
+}
+
+int64_t Task::duration()
+{
+    if ( tags != nullptr )
+        return tags->duration;
+    return vlcMedia.duration();
+}
+
 }
 
 }
@@ -38,6 +38,10 @@ class IDirectory;
 class IFile;
 }
 
+struct AudioTags;
+class Album;
+class AlbumTrack;
+class Artist;
 class Media;
 class File;
 class Folder;
@@ -89,6 +93,13 @@ struct Task
     void markStepCompleted( ParserStep stepCompleted );
     void markStepUncompleted( ParserStep stepUncompleted );
 
+    /*
+     * Returns the requested metadata, from the natively read tags when
+     * available, or from the libvlc media otherwise
+     */
+    std::string meta( libvlc_meta_t meta );
+    int64_t duration();
+
     std::shared_ptr<Media>          media;
     std::shared_ptr<File>           file;
     std::shared_ptr<fs::IFile>      fileFs;
@@ -98,8 +109,20 @@ struct Task
     unsigned int                    parentPlaylistIndex;
     std::string                     mrl;
     VLC::Media                      vlcMedia;
+    // The tags read without libvlc, if the file could be handled natively
+    std::shared_ptr<AudioTags>      tags;
     unsigned int                    currentService;
     ParserStep                      step;
+    // Prioritized tasks are run before the other pending tasks, by all services
+    bool                            prioritized;
+    // The media this task is indexed under by the parser, or 0
+    int64_t                         pendingMediaId;
+    // The entities created while running the task. Their creation is only
+    // notified once the task changes are committed.
+    bool                                        mediaCreated;
+    std::vector<std::shared_ptr<Album>>         createdAlbums;
+    std::vector<std::shared_ptr<Artist>>        createdArtists;
+    std::vector<std::shared_ptr<AlbumTrack>>    createdTracks;
 };
 
 }
@@ -27,6 +27,7 @@
 
 #include "Directory.h"
 
+#include <cstdio>
 #include <cstring>
 #include <stdexcept>
 #include <system_error>
@@ -72,6 +73,15 @@ bool isDirectory( const std::string& path )
 #endif
 }
 
+bool replace( const std::string& from, const std::string& to )
+{
+#ifdef _WIN32
+    return MoveFileEx( from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    return rename( from.c_str(), to.c_str() ) == 0;
+#endif
+}
+
 }
 
 }
@@ -36,6 +36,15 @@ namespace fs
 
 bool isDirectory( const std::string& path );
 
+/**
+ * @brief replace Atomically renames from to to, replacing to if it exists
+ *
+ * Readers of the destination either see the previous file or the new one,
+ * never a partially written file.
+ * @return false if the file couldn't be renamed
+ */
+bool replace( const std::string& from, const std::string& to );
+
 }
 
 }
@@ -0,0 +1,211 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Downscaler.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+# define DOWNSCALER_SSE2
+# include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+# define DOWNSCALER_AVX2
+# include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define DOWNSCALER_NEON
+# include <arm_neon.h>
+#endif
+
+namespace medialibrary
+{
+
+const uint32_t Downscaler::MaxFactor;
+
+namespace
+{
+
+// The position of each component within a 0x00RRGGBB pixel, in memory
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+enum : uint8_t { IdxX = 0, IdxR = 1, IdxG = 2, IdxB = 3 };
+#else
+enum : uint8_t { IdxB = 0, IdxG = 1, IdxR = 2, IdxX = 3 };
+#endif
+
+void accumulateC( uint16_t* sums, const uint8_t* row, uint32_t size )
+{
+    for ( auto i = 0u; i < size; ++i )
+        sums[i] += row[i];
+}
+
+#ifdef DOWNSCALER_SSE2
+void accumulateSse2( uint16_t* sums, const uint8_t* row, uint32_t size )
+{
+    const auto zero = _mm_setzero_si128();
+    auto i = 0u;
+    for ( ; i + 16 <= size; i += 16 )
+    {
+        auto pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( row + i ) );
+        auto lo = reinterpret_cast<__m128i*>( sums + i );
+        auto hi = reinterpret_cast<__m128i*>( sums + i + 8 );
+        _mm_storeu_si128( lo, _mm_add_epi16( _mm_loadu_si128( lo ),
+                                             _mm_unpacklo_epi8( pixels, zero ) ) );
+        _mm_storeu_si128( hi, _mm_add_epi16( _mm_loadu_si128( hi ),
+                                             _mm_unpackhi_epi8( pixels, zero ) ) );
+    }
+    accumulateC( sums + i, row + i, size - i );
+}
+#endif
+
+#ifdef DOWNSCALER_AVX2
+__attribute__((target("avx2")))
+void accumulateAvx2( uint16_t* sums, const uint8_t* row, uint32_t size )
+{
+    auto i = 0u;
+    for ( ; i + 32 <= size; i += 32 )
+    {
+        auto pixels = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( row + i ) );
+        auto lo = reinterpret_cast<__m256i*>( sums + i );
+        auto hi = reinterpret_cast<__m256i*>( sums + i + 16 );
+        _mm256_storeu_si256( lo, _mm256_add_epi16( _mm256_loadu_si256( lo ),
+                             _mm256_cvtepu8_epi16( _mm256_castsi256_si128( pixels ) ) ) );
+        _mm256_storeu_si256( hi, _mm256_add_epi16( _mm256_loadu_si256( hi ),
+                             _mm256_cvtepu8_epi16( _mm256_extracti128_si256( pixels, 1 ) ) ) );
+    }
+    accumulateC( sums + i, row + i, size - i );
+}
+#endif
+
+#ifdef DOWNSCALER_NEON
+void accumulateNeon( uint16_t* sums, const uint8_t* row, uint32_t size )
+{
+    auto i = 0u;
+    for ( ; i + 16 <= size; i += 16 )
+    {
+        auto pixels = vld1q_u8( row + i );
+        vst1q_u16( sums + i, vaddw_u8( vld1q_u16( sums + i ), vget_low_u8( pixels ) ) );
+        vst1q_u16( sums + i + 8, vaddw_u8( vld1q_u16( sums + i + 8 ), vget_high_u8( pixels ) ) );
+    }
+    accumulateC( sums + i, row + i, size - i );
+}
+#endif
+
+/*
+ * Averages the row sums of each factor x factor block, and writes the result
+ * in the requested format.
+ * The division is replaced by a multiplication by the 32 bits fixed point
+ * inverse of the area, which is exact since the sums are lower than 2^32 / area
+ */
+template <Downscaler::Format F>
+void reduceRow( const uint16_t* sums, uint8_t* dst, uint32_t width, uint32_t factor )
+{
+    const uint32_t area = factor * factor;
+    const uint64_t inverse = ( ( uint64_t{ 1 } << 32 ) + area - 1 ) / area;
+    const auto bpp = Downscaler::bytesPerPixel( F );
+    auto average = [area, inverse]( uint32_t sum ) {
+        return static_cast<uint8_t>( ( ( sum + area / 2 ) * inverse ) >> 32 );
+    };
+    for ( auto x = 0u; x < width; ++x, dst += bpp )
+    {
+        uint32_t px[4] = { 0, 0, 0, 0 };
+        for ( auto k = 0u; k < factor; ++k, sums += 4 )
+        {
+            px[0] += sums[0];
+            px[1] += sums[1];
+            px[2] += sums[2];
+            px[3] += sums[3];
+        }
+        if ( F == Downscaler::Format::RGB24 )
+        {
+            dst[0] = average( px[IdxR] );
+            dst[1] = average( px[IdxG] );
+            dst[2] = average( px[IdxB] );
+        }
+        else
+        {
+            dst[IdxR] = average( px[IdxR] );
+            dst[IdxG] = average( px[IdxG] );
+            dst[IdxB] = average( px[IdxB] );
+            dst[IdxX] = 0xFF;
+        }
+    }
+}
+
+}
+
+Downscaler::Downscaler( bool useSimd )
+    : m_accumulate( &accumulateC )
+{
+    if ( useSimd == false )
+        return;
+#if defined(DOWNSCALER_AVX2)
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+        m_accumulate = &accumulateAvx2;
+        return;
+    }
+#endif
+#if defined(DOWNSCALER_SSE2)
+    m_accumulate = &accumulateSse2;
+#elif defined(DOWNSCALER_NEON)
+    m_accumulate = &accumulateNeon;
+#endif
+}
+
+void Downscaler::process( const uint8_t* src, uint32_t pitch, uint32_t factor,
+                          uint32_t left, uint32_t top, uint8_t* dst,
+                          uint32_t width, uint32_t height, Format format )
+{
+    assert( factor >= 1 && factor <= MaxFactor );
+    // The sums of factor rows, for each component of the cropped area
+    const auto rowSize = width * factor * 4;
+    const auto bpp = bytesPerPixel( format );
+    m_sums.resize( rowSize );
+    src += static_cast<size_t>( top ) * factor * pitch + left * factor * 4;
+
+    for ( auto y = 0u; y < height; ++y )
+    {
+        std::fill( begin( m_sums ), end( m_sums ), 0 );
+        for ( auto r = 0u; r < factor; ++r, src += pitch )
+            m_accumulate( m_sums.data(), src, rowSize );
+        if ( format == Format::RGB24 )
+            reduceRow<Format::RGB24>( m_sums.data(), dst, width, factor );
+        else
+            reduceRow<Format::RV32>( m_sums.data(), dst, width, factor );
+        dst += width * bpp;
+    }
+}
+
+uint32_t Downscaler::bytesPerPixel( Format format )
+{
+    return format == Format::RGB24 ? 3 : 4;
+}
+
+}
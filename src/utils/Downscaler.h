@@ -0,0 +1,83 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace medialibrary
+{
+
+/**
+ * @brief Downscaler reduces a RV32 picture by an integer factor, crops it and
+ * converts it to the format expected by an image compressor, in a single pass.
+ *
+ * Each output pixel is the average of a factor x factor block of input pixels.
+ * The input rows are summed using AVX2, SSE2 or NEON when available.
+ * A Downscaler isn't thread safe, but reuses its buffers across pictures.
+ */
+class Downscaler
+{
+public:
+    enum class Format : uint8_t
+    {
+        /// 3 bytes per pixel: R, G, B
+        RGB24,
+        /// 4 bytes per pixel, using the input layout, with an opaque alpha
+        RV32,
+    };
+
+    static const uint32_t MaxFactor = 16;
+
+    /**
+     * @param useSimd false to force the scalar implementation
+     */
+    explicit Downscaler( bool useSimd = true );
+
+    /**
+     * @brief process Downscales & crops the provided picture
+     * @param src The input picture, using native endian 0x00RRGGBB pixels
+     * @param pitch The size of an input row, in bytes
+     * @param factor The reduction factor, in [1; MaxFactor]
+     * @param left The first column to output, in output pixels
+     * @param top The first row to output, in output pixels
+     * @param dst The output buffer, of width * height * bytesPerPixel( format ) bytes
+     *
+     * The input picture must be at least (left + width) * factor pixels wide
+     * and (top + height) * factor pixels high.
+     */
+    void process( const uint8_t* src, uint32_t pitch, uint32_t factor,
+                  uint32_t left, uint32_t top, uint8_t* dst,
+                  uint32_t width, uint32_t height, Format format );
+
+    static uint32_t bytesPerPixel( Format format );
+
+private:
+    // Adds size bytes from row to the provided sums
+    using AccumulateFunc = void (*)( uint16_t* sums, const uint8_t* row, uint32_t size );
+
+    AccumulateFunc m_accumulate;
+    std::vector<uint16_t> m_sums;
+};
+
+}
@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "LatencyHistogram.h"
+
+namespace medialibrary
+{
+
+namespace utils
+{
+
+constexpr size_t LatencyHistogram::NbBuckets;
+
+LatencyHistogram::LatencyHistogram()
+    : m_totalDuration( 0 )
+    , m_maxDuration( 0 )
+{
+    for ( auto& b : m_buckets )
+        b.store( 0, std::memory_order_relaxed );
+}
+
+void LatencyHistogram::record( std::chrono::steady_clock::duration duration )
+{
+    auto us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>( duration ).count() );
+    m_totalDuration.fetch_add( us, std::memory_order_relaxed );
+    auto max = m_maxDuration.load( std::memory_order_relaxed );
+    while ( us > max &&
+            m_maxDuration.compare_exchange_weak( max, us, std::memory_order_relaxed ) == false )
+        ;
+    // Index of the most significant bit, ie. floor(log2(us))
+    auto bucket = 0u;
+    while ( ( us >>= 1 ) != 0 && bucket < NbBuckets - 1 )
+        ++bucket;
+    m_buckets[bucket].fetch_add( 1, std::memory_order_relaxed );
+}
+
+uint64_t LatencyHistogram::totalDuration() const
+{
+    return m_totalDuration.load( std::memory_order_relaxed );
+}
+
+uint64_t LatencyHistogram::maxDuration() const
+{
+    return m_maxDuration.load( std::memory_order_relaxed );
+}
+
+std::array<uint64_t, LatencyHistogram::NbBuckets> LatencyHistogram::buckets() const
+{
+    std::array<uint64_t, NbBuckets> res;
+    for ( auto i = 0u; i < m_buckets.size(); ++i )
+        res[i] = m_buckets[i].load( std::memory_order_relaxed );
+    return res;
+}
+
+void LatencyHistogram::reset()
+{
+    m_totalDuration.store( 0, std::memory_order_relaxed );
+    m_maxDuration.store( 0, std::memory_order_relaxed );
+    for ( auto& b : m_buckets )
+        b.store( 0, std::memory_order_relaxed );
+}
+
+}
+
+}
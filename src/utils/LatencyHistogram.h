@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace medialibrary
+{
+
+namespace utils
+{
+
+/**
+ * @brief LatencyHistogram accumulates durations in a log-scaled histogram
+ *
+ * Bucket i counts the durations which lasted between 2^i and 2^(i+1) µs, the
+ * first bucket also accounting for faster durations, and the last one for
+ * slower durations. The total and maximum durations are kept as well.
+ * Counters are only updated using relaxed atomic operations, so recording a
+ * duration is cheap enough to be left enabled at all times.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr size_t NbBuckets = 24;
+
+    LatencyHistogram();
+    void record( std::chrono::steady_clock::duration duration );
+    // Durations in microseconds
+    uint64_t totalDuration() const;
+    uint64_t maxDuration() const;
+    std::array<uint64_t, NbBuckets> buckets() const;
+    void reset();
+
+private:
+    std::atomic<uint64_t> m_totalDuration;
+    std::atomic<uint64_t> m_maxDuration;
+    std::array<std::atomic<uint64_t>, NbBuckets> m_buckets;
+};
+
+}
+
+}
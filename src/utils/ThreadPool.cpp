@@ -0,0 +1,209 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "ThreadPool.h"
+
+#include <cassert>
+
+namespace medialibrary
+{
+
+namespace
+{
+// The pool & index of the worker running on the current thread, if any
+thread_local const ThreadPool* CurrentPool = nullptr;
+thread_local unsigned int CurrentWorker = 0;
+
+uint64_t elapsedUs( std::chrono::steady_clock::time_point start )
+{
+    auto d = std::chrono::steady_clock::now() - start;
+    return static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>( d ).count() );
+}
+}
+
+ThreadPool::Worker::Worker()
+    : busyDuration( 0 )
+    , idleDuration( 0 )
+{
+}
+
+ThreadPool::ThreadPool()
+    : m_nbPending( 0 )
+    , m_nbStarted( 0 )
+    , m_stop( false )
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    for ( auto& t : m_threads )
+        t.join();
+}
+
+void ThreadPool::start( unsigned int nbWorkers )
+{
+    // Ensure we don't start multiple times.
+    assert( m_threads.empty() == true );
+    {
+        // The statistics can be fetched while the pool is starting
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        for ( auto i = 0u; i < nbWorkers; ++i )
+            m_workers.emplace_back( new Worker );
+    }
+    for ( auto i = 0u; i < nbWorkers; ++i )
+        m_threads.emplace_back( &ThreadPool::run, this );
+}
+
+void ThreadPool::submit( Job job )
+{
+    if ( CurrentPool == this )
+    {
+        auto& w = *m_workers[CurrentWorker];
+        std::lock_guard<compat::Mutex> lock( w.lock );
+        w.jobs.push_back( std::move( job ) );
+        ++m_nbPending;
+    }
+    else
+    {
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        m_shared.push_back( std::move( job ) );
+        ++m_nbPending;
+    }
+    {
+        // Don't let a worker miss the notification between the moment it
+        // checks for pending jobs, and the moment it starts waiting
+        std::lock_guard<compat::Mutex> lock( m_lock );
+    }
+    m_cond.notify_one();
+}
+
+unsigned int ThreadPool::nbWorkers() const
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    return static_cast<unsigned int>( m_workers.size() );
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPool::stats() const
+{
+    std::vector<WorkerStats> res;
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    res.reserve( m_workers.size() );
+    for ( const auto& w : m_workers )
+    {
+        res.push_back( WorkerStats{ w->busyDuration.load( std::memory_order_relaxed ),
+                                    w->idleDuration.load( std::memory_order_relaxed ) } );
+    }
+    return res;
+}
+
+void ThreadPool::resetStats()
+{
+    std::lock_guard<compat::Mutex> lock( m_lock );
+    for ( auto& w : m_workers )
+    {
+        w->busyDuration.store( 0, std::memory_order_relaxed );
+        w->idleDuration.store( 0, std::memory_order_relaxed );
+    }
+}
+
+void ThreadPool::run()
+{
+    auto workerIdx = m_nbStarted++;
+    CurrentPool = this;
+    CurrentWorker = workerIdx;
+    auto& worker = *m_workers[workerIdx];
+    while ( true )
+    {
+        Job job;
+        if ( pop( workerIdx, job ) == true )
+        {
+            auto start = std::chrono::steady_clock::now();
+            job();
+            worker.busyDuration.fetch_add( elapsedUs( start ), std::memory_order_relaxed );
+            continue;
+        }
+        std::unique_lock<compat::Mutex> lock( m_lock );
+        // Run all the remaining jobs before exiting
+        if ( m_stop == true && m_nbPending == 0 )
+            break;
+        auto start = std::chrono::steady_clock::now();
+        m_cond.wait( lock, [this]() {
+            return m_nbPending > 0 || m_stop == true;
+        });
+        worker.idleDuration.fetch_add( elapsedUs( start ), std::memory_order_relaxed );
+    }
+    CurrentPool = nullptr;
+}
+
+bool ThreadPool::pop( unsigned int workerIdx, Job& job )
+{
+    if ( m_nbPending == 0 )
+        return false;
+    {
+        auto& w = *m_workers[workerIdx];
+        std::lock_guard<compat::Mutex> lock( w.lock );
+        if ( w.jobs.empty() == false )
+        {
+            job = std::move( w.jobs.front() );
+            w.jobs.pop_front();
+            --m_nbPending;
+            return true;
+        }
+    }
+    {
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        if ( m_shared.empty() == false )
+        {
+            job = std::move( m_shared.front() );
+            m_shared.pop_front();
+            --m_nbPending;
+            return true;
+        }
+    }
+    // Steal the most recently queued job of another worker, leaving the
+    // oldest ones to their owner
+    for ( auto i = 1u; i < m_workers.size(); ++i )
+    {
+        auto& victim = *m_workers[( workerIdx + i ) % m_workers.size()];
+        std::lock_guard<compat::Mutex> lock( victim.lock );
+        if ( victim.jobs.empty() == false )
+        {
+            job = std::move( victim.jobs.back() );
+            victim.jobs.pop_back();
+            --m_nbPending;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
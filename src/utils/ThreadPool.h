@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
+
+namespace medialibrary
+{
+
+/**
+ * @brief ThreadPool runs jobs on a fixed set of worker threads
+ *
+ * Each worker owns a queue, in which the jobs it submits are pushed, while
+ * jobs submitted from other threads go through a shared queue. An idle
+ * worker first runs its own jobs, then the shared ones, and finally steals
+ * jobs from the other workers.
+ * Jobs submitted before start() is called are run once the workers start.
+ */
+class ThreadPool
+{
+public:
+    using Job = std::function<void()>;
+
+    struct WorkerStats
+    {
+        // Durations in microseconds
+        uint64_t busyDuration;
+        uint64_t idleDuration;
+    };
+
+    ThreadPool();
+    ///
+    /// \brief ~ThreadPool Runs the remaining jobs & joins the workers
+    ///
+    ~ThreadPool();
+    void start( unsigned int nbWorkers );
+    void submit( Job job );
+    unsigned int nbWorkers() const;
+    std::vector<WorkerStats> stats() const;
+    void resetStats();
+
+private:
+    struct Worker
+    {
+        Worker();
+
+        compat::Mutex lock;
+        std::deque<Job> jobs;
+        std::atomic<uint64_t> busyDuration;
+        std::atomic<uint64_t> idleDuration;
+    };
+
+    // Worker thread entry point
+    void run();
+    bool pop( unsigned int workerIdx, Job& job );
+
+private:
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<compat::Thread> m_threads;
+    // Protects the shared queue & the stop flag, as well as the workers list
+    // for the threads which aren't workers
+    mutable compat::Mutex m_lock;
+    compat::ConditionVariable m_cond;
+    std::deque<Job> m_shared;
+    // The number of submitted jobs which haven't been picked by a worker yet
+    std::atomic_uint m_nbPending;
+    std::atomic_uint m_nbStarted;
+    bool m_stop;
+};
+
+}
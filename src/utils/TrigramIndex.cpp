@@ -0,0 +1,317 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "TrigramIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace medialibrary
+{
+
+namespace
+{
+
+// Base letters for U+00C0 to U+00FF, encoded as 0xC3 0x80 to 0xC3 0xBF
+// A space stands for a character which isn't a letter
+const char Latin1Letters[] = "aaaaaaaceeeeiiiidnooooo ouuuuyts"
+                             "aaaaaaaceeeeiiiidnooooo ouuuuyty";
+
+// Compaction thresholds
+const size_t MinDeltaPostings = 1 << 16;
+const size_t MinRemovedEntries = 1 << 12;
+
+}
+
+TrigramIndex::TrigramIndex()
+    : m_nbRemoved( 0 )
+    , m_offsets( 1, 0 )
+    , m_nbDeltaPostings( 0 )
+{
+}
+
+void TrigramIndex::insert( int64_t id, const std::string& value )
+{
+    remove( id );
+    auto tri = trigrams( value );
+    if ( tri.empty() == true )
+        return;
+    auto slot = static_cast<uint32_t>( m_ids.size() );
+    m_ids.push_back( id );
+    m_nbTrigrams.push_back( static_cast<uint16_t>( std::min<size_t>( tri.size(),
+                                std::numeric_limits<uint16_t>::max() ) ) );
+    m_hits.push_back( 0 );
+    m_slots.emplace( id, slot );
+    for ( auto t : tri )
+        m_delta[t].push_back( slot );
+    m_nbDeltaPostings += tri.size();
+    maybeCompact();
+}
+
+void TrigramIndex::remove( int64_t id )
+{
+    auto it = m_slots.find( id );
+    if ( it == end( m_slots ) )
+        return;
+    m_nbTrigrams[it->second] = 0;
+    m_slots.erase( it );
+    ++m_nbRemoved;
+    maybeCompact();
+}
+
+void TrigramIndex::clear()
+{
+    m_ids.clear();
+    m_nbTrigrams.clear();
+    m_slots.clear();
+    m_nbRemoved = 0;
+    m_keys.clear();
+    m_offsets.assign( 1, 0 );
+    m_postings.clear();
+    m_delta.clear();
+    m_nbDeltaPostings = 0;
+    m_hits.clear();
+}
+
+size_t TrigramIndex::size() const
+{
+    return m_slots.size();
+}
+
+std::vector<TrigramIndex::Match> TrigramIndex::search( const std::string& pattern,
+                                                       float minSimilarity,
+                                                       uint32_t maxResults )
+{
+    auto tri = trigrams( pattern );
+    if ( tri.empty() == true )
+        return {};
+
+    std::vector<uint32_t> touched;
+    auto count = [this, &touched]( uint32_t slot ) {
+        if ( m_hits[slot]++ == 0 )
+            touched.push_back( slot );
+    };
+    for ( auto t : tri )
+    {
+        auto it = std::lower_bound( begin( m_keys ), end( m_keys ), t );
+        if ( it != end( m_keys ) && *it == t )
+        {
+            auto idx = it - begin( m_keys );
+            for ( auto i = m_offsets[idx]; i < m_offsets[idx + 1]; ++i )
+                count( m_postings[i] );
+        }
+        auto dIt = m_delta.find( t );
+        if ( dIt != end( m_delta ) )
+        {
+            for ( auto slot : dIt->second )
+                count( slot );
+        }
+    }
+
+    struct Candidate
+    {
+        uint32_t slot;
+        uint16_t hits;
+        // Used to rank the entries sharing the same number of trigrams,
+        // favoring the ones which contain the fewest other trigrams
+        float jaccard;
+    };
+    auto minHits = std::max( 1u, static_cast<unsigned int>(
+                                 std::ceil( minSimilarity * tri.size() ) ) );
+    std::vector<Candidate> candidates;
+    for ( auto slot : touched )
+    {
+        auto hits = m_hits[slot];
+        m_hits[slot] = 0;
+        auto nbTrigrams = m_nbTrigrams[slot];
+        if ( nbTrigrams == 0 || hits < minHits )
+            continue;
+        candidates.push_back( Candidate{ slot, hits,
+                static_cast<float>( hits ) / ( tri.size() + nbTrigrams - hits ) } );
+    }
+    auto compare = []( const Candidate& a, const Candidate& b ) {
+        if ( a.hits != b.hits )
+            return a.hits > b.hits;
+        if ( a.jaccard != b.jaccard )
+            return a.jaccard > b.jaccard;
+        return a.slot < b.slot;
+    };
+    if ( maxResults != 0 && maxResults < candidates.size() )
+    {
+        std::partial_sort( begin( candidates ), begin( candidates ) + maxResults,
+                           end( candidates ), compare );
+        candidates.resize( maxResults );
+    }
+    else
+        std::sort( begin( candidates ), end( candidates ), compare );
+
+    std::vector<Match> res;
+    res.reserve( candidates.size() );
+    for ( const auto& c : candidates )
+        res.push_back( Match{ m_ids[c.slot], static_cast<float>( c.hits ) / tri.size() } );
+    return res;
+}
+
+void TrigramIndex::compact()
+{
+    const auto invalidSlot = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> newSlots( m_ids.size(), invalidSlot );
+    std::vector<int64_t> ids;
+    std::vector<uint16_t> nbTrigrams;
+    ids.reserve( m_slots.size() );
+    nbTrigrams.reserve( m_slots.size() );
+    m_slots.clear();
+    for ( auto i = 0u; i < m_ids.size(); ++i )
+    {
+        if ( m_nbTrigrams[i] == 0 )
+            continue;
+        newSlots[i] = static_cast<uint32_t>( ids.size() );
+        m_slots.emplace( m_ids[i], newSlots[i] );
+        ids.push_back( m_ids[i] );
+        nbTrigrams.push_back( m_nbTrigrams[i] );
+    }
+
+    std::vector<uint32_t> deltaKeys;
+    deltaKeys.reserve( m_delta.size() );
+    for ( const auto& p : m_delta )
+        deltaKeys.push_back( p.first );
+    std::sort( begin( deltaKeys ), end( deltaKeys ) );
+    std::vector<uint32_t> allKeys;
+    allKeys.reserve( m_keys.size() + deltaKeys.size() );
+    std::set_union( begin( m_keys ), end( m_keys ), begin( deltaKeys ), end( deltaKeys ),
+                    std::back_inserter( allKeys ) );
+
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> offsets( 1, 0 );
+    std::vector<uint32_t> postings;
+    keys.reserve( allKeys.size() );
+    offsets.reserve( allKeys.size() + 1 );
+    postings.reserve( m_postings.size() + m_nbDeltaPostings );
+    auto append = [&newSlots, &postings, invalidSlot]( uint32_t slot ) {
+        if ( newSlots[slot] != invalidSlot )
+            postings.push_back( newSlots[slot] );
+    };
+    auto baseIdx = 0u;
+    for ( auto k : allKeys )
+    {
+        // Base postings come first, since the delta only contains newer slots
+        if ( baseIdx < m_keys.size() && m_keys[baseIdx] == k )
+        {
+            for ( auto i = m_offsets[baseIdx]; i < m_offsets[baseIdx + 1]; ++i )
+                append( m_postings[i] );
+            ++baseIdx;
+        }
+        auto dIt = m_delta.find( k );
+        if ( dIt != end( m_delta ) )
+        {
+            for ( auto slot : dIt->second )
+                append( slot );
+        }
+        if ( postings.size() == offsets.back() )
+            continue;
+        keys.push_back( k );
+        offsets.push_back( static_cast<uint32_t>( postings.size() ) );
+    }
+
+    m_ids = std::move( ids );
+    m_nbTrigrams = std::move( nbTrigrams );
+    m_nbRemoved = 0;
+    m_keys = std::move( keys );
+    m_offsets = std::move( offsets );
+    m_postings = std::move( postings );
+    m_postings.shrink_to_fit();
+    m_delta.clear();
+    m_nbDeltaPostings = 0;
+    m_hits.assign( m_ids.size(), 0 );
+}
+
+void TrigramIndex::maybeCompact()
+{
+    if ( ( m_nbDeltaPostings > MinDeltaPostings &&
+           m_nbDeltaPostings > m_postings.size() / 4 ) ||
+         ( m_nbRemoved > MinRemovedEntries && m_nbRemoved > m_ids.size() / 4 ) )
+        compact();
+}
+
+std::vector<uint32_t> TrigramIndex::trigrams( const std::string& value )
+{
+    // Fold the value to lowercase words separated by a single space
+    std::string folded;
+    folded.reserve( value.size() + 1 );
+    for ( auto i = 0u; i < value.size(); ++i )
+    {
+        auto c = static_cast<unsigned char>( value[i] );
+        char res;
+        if ( c < 0x80 )
+            res = isalnum( c ) != 0 ? static_cast<char>( tolower( c ) ) : ' ';
+        else if ( c == 0xC3 && i + 1 < value.size() &&
+                  ( static_cast<unsigned char>( value[i + 1] ) & 0xC0 ) == 0x80 )
+        {
+            res = Latin1Letters[static_cast<unsigned char>( value[i + 1] ) - 0x80];
+            ++i;
+        }
+        else
+            res = static_cast<char>( c );
+        if ( res == ' ' && ( folded.empty() == true || folded.back() == ' ' ) )
+            continue;
+        folded += res;
+    }
+    if ( folded.empty() == false && folded.back() != ' ' )
+        folded += ' ';
+
+    std::vector<uint32_t> res;
+    res.reserve( folded.size() * 2 );
+    auto pack = []( unsigned char a, unsigned char b, unsigned char c ) {
+        return static_cast<uint32_t>( a ) << 16 | static_cast<uint32_t>( b ) << 8 | c;
+    };
+    auto wordStart = 0u;
+    for ( auto i = 0u; i < folded.size(); ++i )
+    {
+        if ( folded[i] != ' ' )
+            continue;
+        // Each word is padded as "  word "
+        const auto* w = reinterpret_cast<const unsigned char*>( folded.data() ) + wordStart;
+        auto len = i - wordStart;
+        res.push_back( pack( ' ', ' ', w[0] ) );
+        if ( len > 1 )
+            res.push_back( pack( ' ', w[0], w[1] ) );
+        for ( auto j = 0u; j + 2 < len; ++j )
+            res.push_back( pack( w[j], w[j + 1], w[j + 2] ) );
+        if ( len > 1 )
+            res.push_back( pack( w[len - 2], w[len - 1], ' ' ) );
+        else
+            res.push_back( pack( ' ', w[0], ' ' ) );
+        wordStart = i + 1;
+    }
+    std::sort( begin( res ), end( res ) );
+    res.erase( std::unique( begin( res ), end( res ) ), end( res ) );
+    return res;
+}
+
+}
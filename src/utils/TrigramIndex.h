@@ -0,0 +1,118 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace medialibrary
+{
+
+/**
+ * @brief TrigramIndex is an in memory index, matching approximative patterns
+ *        against a set of strings, based on the trigrams they share.
+ *
+ * Entries are referred to by their slot, a dense uint32_t index, so that
+ * posting lists & the scoring scratch buffer stay small and contiguous.
+ * Most postings live in a single array, sorted by trigram (the base segment)
+ * while entries added since the last compaction are appended to per trigram
+ * vectors (the delta segment). Removed entries are only flagged, and get
+ * dropped from the postings by the next compaction, which is triggered once
+ * the delta segment or the removed entries grow too large.
+ *
+ * This class isn't thread safe.
+ */
+class TrigramIndex
+{
+public:
+    struct Match
+    {
+        int64_t id;
+        // The fraction of the pattern trigrams found in the entry, in [0;1]
+        float similarity;
+    };
+
+    TrigramIndex();
+
+    /**
+     * @brief insert Inserts or replaces the entry for the provided id
+     */
+    void insert( int64_t id, const std::string& value );
+    void remove( int64_t id );
+    void clear();
+    size_t size() const;
+
+    /**
+     * @brief search Returns the entries sharing at least a minSimilarity
+     *               fraction of the pattern's trigrams, best match first.
+     * @param maxResults The maximum number of matches, 0 for no limit
+     */
+    std::vector<Match> search( const std::string& pattern, float minSimilarity,
+                               uint32_t maxResults );
+
+    /**
+     * @brief compact Merges the delta segment into the base one, and drops
+     *                the removed entries.
+     * This is automatically called when needed, but can be invoked after a
+     * bulk insertion to avoid keeping a large delta segment.
+     */
+    void compact();
+
+    /**
+     * @brief trigrams Returns the sorted & unique trigrams of a value
+     *
+     * Values are case folded, latin-1 letters are stripped from their
+     * diacritics, and each word is padded with 2 leading & 1 trailing spaces
+     * so that words beginning get more weight, like postgres' pg_trgm does.
+     */
+    static std::vector<uint32_t> trigrams( const std::string& value );
+
+private:
+    void maybeCompact();
+
+private:
+    // Indexed by slot
+    std::vector<int64_t> m_ids;
+    // 0 for a removed entry
+    std::vector<uint16_t> m_nbTrigrams;
+    std::unordered_map<int64_t, uint32_t> m_slots;
+    size_t m_nbRemoved;
+
+    // Base segment: the postings of m_keys[i] are
+    // m_postings[m_offsets[i]] to m_postings[m_offsets[i + 1]]
+    std::vector<uint32_t> m_keys;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_postings;
+
+    // Delta segment, only containing slots higher than the base segment ones
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_delta;
+    size_t m_nbDeltaPostings;
+
+    // Scoring scratch buffer, indexed by slot & always reset to 0 after use
+    std::vector<uint16_t> m_hits;
+};
+
+}
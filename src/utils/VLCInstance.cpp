@@ -28,6 +28,8 @@
 #include "logging/Logger.h"
 #include "vlcpp/vlc.hpp"
 
+#include <string>
+
 namespace
 {
 // Define this in the .cpp file to avoid including libvlcpp from the header.
@@ -35,9 +37,20 @@ struct Init
 {
     Init()
     {
+#if LIBVLC_VERSION_INT >= LIBVLC_VERSION(4, 0, 0, 0)
+        const auto preparserThreads = "--preparse-threads=" +
+                std::to_string( medialibrary::VLCInstance::NbPreparserThreads );
         const char* args[] = {
             "--no-lua",
+            preparserThreads.c_str(),
         };
+#else
+        // Older libvlc versions only have a single preparser thread, and
+        // would reject the option
+        const char* args[] = {
+            "--no-lua",
+        };
+#endif
         instance = VLC::Instance( sizeof(args) / sizeof(args[0]), args );
         // Do not take the string by reference. libvlcpp is constructing the std::string
         // as it calls the log callback, so the string we receive will be move constructed
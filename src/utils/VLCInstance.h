@@ -34,6 +34,10 @@ class VLCInstance
 {
 public:
     static VLC::Instance& get();
+
+    /// The maximum number of media libvlc preparses at once. Only used with
+    /// libvlc 4 and later, the older versions having a single preparser thread
+    static const unsigned int NbPreparserThreads = 8;
 };
 
 }
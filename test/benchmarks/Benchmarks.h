@@ -1,7 +1,7 @@
 /*****************************************************************************
  * Media Library
  *****************************************************************************
- * Copyright (C) 2015 Hugo Beauzée-Luyssen, Videolabs
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
  *
  * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
  *
@@ -20,21 +20,22 @@
  * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
  *****************************************************************************/
 
-#if HAVE_CONFIG_H
-# include "config.h"
-#endif
+#pragma once
 
-#include "SqliteTools.h"
+#include <cstdint>
+#include <string>
+#include <vector>
 
-namespace medialibrary
+namespace bench
 {
 
-namespace sqlite
-{
-std::unordered_map<Connection::Handle,
-                    std::unordered_map<std::string, Statement::CachedStmtPtr>> Statement::StatementsCache;
+// Prints the minimum, median, 90th & 99th percentiles, and maximum of the
+// provided samples, expressed in microseconds
+void printPercentiles( const std::string& name, std::vector<int64_t> samples );
 
-compat::Mutex Statement::StatementsCacheLock;
-}
+int readerLatency( int argc, char** argv );
+int hydration( int argc, char** argv );
+int fuzzySearch( int argc, char** argv );
+int downscale( int argc, char** argv );
 
 }
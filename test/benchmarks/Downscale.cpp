@@ -0,0 +1,114 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include "utils/Downscaler.h"
+
+namespace bench
+{
+
+namespace
+{
+
+const uint32_t Width = 320;
+const uint32_t Height = 200;
+
+template <typename F>
+std::vector<int64_t> measure( int nbIterations, F&& f )
+{
+    std::vector<int64_t> samples;
+    samples.reserve( nbIterations );
+    for ( auto i = 0; i < nbIterations; ++i )
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto duration = std::chrono::steady_clock::now() - start;
+        samples.push_back( std::chrono::duration_cast<std::chrono::microseconds>( duration ).count() );
+    }
+    return samples;
+}
+
+}
+
+/*
+ * Measures the time needed to turn a decoded frame into the 320x200 RGB
+ * picture handed to the JPEG compressor.
+ * The previous path had libvlc scale frames down to roughly the thumbnail
+ * size, and only cropped them. The downscaler is measured with the scalar &
+ * vectorized implementations, for frames up to 4 times larger.
+ * Usage: downscale [nbIterations]
+ */
+int downscale( int argc, char** argv )
+{
+    auto nbIterations = argc > 1 ? atoi( argv[1] ) : 1000;
+
+    std::mt19937 rng( 42 );
+    std::vector<uint8_t> output( Width * Height * 3 );
+
+    {
+        // A slightly taller RV24 frame, cropped one row at a time
+        const auto inputHeight = Height + 20;
+        const auto stride = Width * 3;
+        std::vector<uint8_t> frame( stride * inputHeight );
+        for ( auto& b : frame )
+            b = static_cast<uint8_t>( rng() );
+        auto samples = measure( nbIterations, [&frame, &output, stride]() {
+            for ( auto y = 0u; y < Height; ++y )
+                memcpy( &output[y * stride], &frame[( y + 10 ) * stride], stride );
+        });
+        printPercentiles( "Crop only (1x, scaled by libvlc)", std::move( samples ) );
+    }
+
+    medialibrary::Downscaler scalar( false );
+    medialibrary::Downscaler simd;
+    for ( auto factor = 1u; factor <= 4; factor *= 2 )
+    {
+        const auto pitch = Width * factor * 4;
+        std::vector<uint8_t> frame( pitch * ( Height + 20 ) * factor );
+        for ( auto& b : frame )
+            b = static_cast<uint8_t>( rng() );
+        for ( auto d : { &scalar, &simd } )
+        {
+            auto samples = measure( nbIterations, [d, &frame, &output, pitch, factor]() {
+                d->process( frame.data(), pitch, factor, 0, 10, output.data(),
+                            Width, Height, medialibrary::Downscaler::Format::RGB24 );
+            });
+            printPercentiles( std::string( d == &simd ? "SIMD" : "Scalar" ) +
+                              " downscale (" + std::to_string( factor ) + "x)",
+                              std::move( samples ) );
+        }
+    }
+    return 0;
+}
+
+}
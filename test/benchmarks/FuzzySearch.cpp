@@ -0,0 +1,122 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "utils/TrigramIndex.h"
+
+namespace bench
+{
+
+namespace
+{
+
+const char* const Syllables[] = {
+    "ba", "be", "bo", "ca", "ce", "co", "da", "de", "do", "fa", "fe", "fi",
+    "ga", "go", "ha", "he", "ja", "ka", "ki", "la", "le", "li", "lo", "ma",
+    "me", "mi", "mo", "na", "ne", "no", "pa", "pe", "pi", "ra", "re", "ri",
+    "ro", "sa", "se", "so", "ta", "te", "ti", "to", "va", "ve", "za", "tle",
+    "st", "ck", "ng", "th", "er", "on", "an", "in",
+};
+
+}
+
+/*
+ * Measures the latency of typo tolerant searches over a trigram index filled
+ * with pseudo random titles, each query being an indexed title with two
+ * swapped letters.
+ * Usage: fuzzy_search [nbEntries] [nbQueries]
+ */
+int fuzzySearch( int argc, char** argv )
+{
+    auto nbEntries = argc > 1 ? atoi( argv[1] ) : 500000;
+    auto nbQueries = argc > 2 ? atoi( argv[2] ) : 1000;
+
+    std::mt19937 rng( 42 );
+    auto randomInt = [&rng]( int min, int max ) {
+        return std::uniform_int_distribution<int>( min, max )( rng );
+    };
+    std::vector<std::string> words( 20000 );
+    for ( auto& w : words )
+    {
+        for ( auto i = randomInt( 2, 4 ); i > 0; --i )
+            w += Syllables[randomInt( 0, sizeof( Syllables ) / sizeof( Syllables[0] ) - 1 )];
+    }
+    std::vector<std::string> titles( nbEntries );
+    for ( auto& t : titles )
+    {
+        for ( auto i = randomInt( 1, 5 ); i > 0; --i )
+        {
+            if ( t.empty() == false )
+                t += ' ';
+            t += words[randomInt( 0, words.size() - 1 )];
+        }
+    }
+
+    medialibrary::TrigramIndex idx;
+    auto start = std::chrono::steady_clock::now();
+    for ( auto i = 0; i < nbEntries; ++i )
+        idx.insert( i, titles[i] );
+    idx.compact();
+    auto duration = std::chrono::steady_clock::now() - start;
+    std::cout << "Indexed " << nbEntries << " entries in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>( duration ).count()
+              << "ms" << std::endl;
+
+    std::vector<int64_t> samples;
+    samples.reserve( nbQueries );
+    auto nbFound = 0;
+    for ( auto i = 0; i < nbQueries; ++i )
+    {
+        auto id = randomInt( 0, nbEntries - 1 );
+        auto pattern = titles[id];
+        auto pos = randomInt( 0, pattern.size() - 2 );
+        std::swap( pattern[pos], pattern[pos + 1] );
+        start = std::chrono::steady_clock::now();
+        auto res = idx.search( pattern, 0.4f, 10 );
+        duration = std::chrono::steady_clock::now() - start;
+        samples.push_back( std::chrono::duration_cast<std::chrono::microseconds>( duration ).count() );
+        for ( const auto& m : res )
+        {
+            if ( m.id == id )
+            {
+                ++nbFound;
+                break;
+            }
+        }
+    }
+    printPercentiles( "Fuzzy search", std::move( samples ) );
+    std::cout << "Original entry found in the top 10 for " << nbFound << "/"
+              << nbQueries << " queries" << std::endl;
+    return 0;
+}
+
+}
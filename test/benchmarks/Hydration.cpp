@@ -0,0 +1,108 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+#include "common/MediaLibraryTester.h"
+#include "compat/Thread.h"
+#include "database/SqliteTools.h"
+#include "Media.h"
+#include "mocks/FileSystem.h"
+#include "mocks/MockDeviceLister.h"
+#include "mocks/NoopCallback.h"
+
+namespace bench
+{
+
+/*
+ * Measures the time needed to hydrate all the media from an empty cache,
+ * with the records being split across an increasing number of threads.
+ * Usage: hydration [nbMedia] [maxThreads]
+ */
+int hydration( int argc, char** argv )
+{
+    auto nbMedia = argc > 1 ? atoi( argv[1] ) : 100000;
+    auto maxThreads = argc > 2 ? atoi( argv[2] ) : 8;
+
+    unlink( "bench.db" );
+    unlink( "bench.db-wal" );
+    unlink( "bench.db-shm" );
+
+    mock::NoopCallback cb;
+    MediaLibraryWithoutParser ml;
+    ml.setFsFactory( std::make_shared<mock::FileSystemFactory>() );
+    ml.setDeviceLister( std::make_shared<mock::MockDeviceLister>() );
+    ml.setVerbosity( LogLevel::Error );
+    if ( ml.initialize( "bench.db", "/tmp", &cb ) != InitializeResult::Success )
+    {
+        std::cerr << "Failed to initialize the media library" << std::endl;
+        return 1;
+    }
+    // Only measure the hydration, not the evictions
+    ml.setMaxCachedEntities( nbMedia );
+    {
+        std::vector<std::string> fileNames;
+        fileNames.reserve( nbMedia );
+        for ( auto i = 0; i < nbMedia; ++i )
+            fileNames.push_back( "media" + std::to_string( i ) + ".mkv" );
+        if ( Media::createBatch( &ml, IMedia::Type::Unknown, fileNames ).size() !=
+             fileNames.size() )
+        {
+            std::cerr << "Failed to create the media" << std::endl;
+            return 1;
+        }
+    }
+
+    static const std::string req = "SELECT * FROM " + policy::MediaTable::Name +
+            " WHERE id_media % ? = ?";
+    for ( auto nbThreads = 1; nbThreads <= maxThreads; nbThreads *= 2 )
+    {
+        Media::clear();
+        std::vector<compat::Thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for ( auto i = 0; i < nbThreads; ++i )
+        {
+            threads.emplace_back( [&ml, nbThreads, i]() {
+                Media::fetchAll<IMedia>( &ml, req, nbThreads, i );
+            });
+        }
+        for ( auto& t : threads )
+            t.join();
+        auto duration = std::chrono::steady_clock::now() - start;
+        std::cout << "Hydrated " << nbMedia << " media with " << nbThreads << " thread(s) in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>( duration ).count()
+                  << "ms" << std::endl;
+    }
+    ml.setMaxCachedEntities( cachepolicy::Bounded<Media>::DefaultMaxSize );
+    return 0;
+}
+
+}
@@ -0,0 +1,142 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Benchmarks.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+#include "common/MediaLibraryTester.h"
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
+#include "mocks/FileSystem.h"
+#include "mocks/MockDeviceLister.h"
+#include "mocks/NoopCallback.h"
+
+namespace
+{
+
+class DiscoveryCb : public mock::NoopCallback
+{
+public:
+    DiscoveryCb() : m_done( false ) {}
+
+    virtual void onDiscoveryCompleted( const std::string& ) override
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        m_done = true;
+        m_cond.notify_all();
+    }
+
+    bool isDone()
+    {
+        std::lock_guard<compat::Mutex> lock( m_mutex );
+        return m_done;
+    }
+
+    void wait()
+    {
+        std::unique_lock<compat::Mutex> lock( m_mutex );
+        m_cond.wait( lock, [this]() { return m_done; } );
+    }
+
+private:
+    compat::Mutex m_mutex;
+    compat::ConditionVariable m_cond;
+    bool m_done;
+};
+
+}
+
+namespace bench
+{
+
+/*
+ * Measures the latency of a simple listing request, run from a "UI" thread,
+ * while the discoverer inserts files in the database.
+ * Usage: reader_latency [nbFolders] [nbFilesPerFolder]
+ */
+int readerLatency( int argc, char** argv )
+{
+    auto nbFolders = argc > 1 ? atoi( argv[1] ) : 20;
+    auto nbFiles = argc > 2 ? atoi( argv[2] ) : 500;
+
+    unlink( "bench.db" );
+    unlink( "bench.db-wal" );
+    unlink( "bench.db-shm" );
+
+    auto fsFactory = std::make_shared<mock::FileSystemFactory>();
+    for ( auto i = 0; i < nbFolders; ++i )
+    {
+        auto folder = mock::FileSystemFactory::Root + "folder" + std::to_string( i ) + '/';
+        fsFactory->addFolder( folder );
+        for ( auto j = 0; j < nbFiles; ++j )
+            fsFactory->addFile( folder + "file" + std::to_string( j ) + ".mkv" );
+    }
+
+    DiscoveryCb cb;
+    MediaLibraryWithoutParser ml;
+    ml.setFsFactory( fsFactory );
+    ml.setDeviceLister( std::make_shared<mock::MockDeviceLister>() );
+    ml.setVerbosity( LogLevel::Error );
+    if ( ml.initialize( "bench.db", "/tmp", &cb ) != InitializeResult::Success ||
+         ml.start() == false )
+    {
+        std::cerr << "Failed to initialize the media library" << std::endl;
+        return 1;
+    }
+    std::cout << "WAL journal mode: "
+              << ( ml.getConn()->isWalEnabled() ? "enabled" : "disabled" ) << std::endl;
+
+    std::vector<int64_t> samples;
+    auto start = std::chrono::steady_clock::now();
+    ml.discover( mock::FileSystemFactory::Root );
+    compat::Thread reader( [&ml, &cb, &samples]() {
+        while ( cb.isDone() == false )
+        {
+            auto chrono = std::chrono::steady_clock::now();
+            ml.files();
+            auto duration = std::chrono::steady_clock::now() - chrono;
+            samples.push_back( std::chrono::duration_cast<std::chrono::microseconds>(
+                                   duration ).count() );
+            compat::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+        }
+    });
+    cb.wait();
+    auto discoveryDuration = std::chrono::steady_clock::now() - start;
+    reader.join();
+
+    std::cout << "Discovered " << ml.files().size() << " files in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(
+                     discoveryDuration ).count() << "ms" << std::endl;
+    printPercentiles( "Listing latency during discovery", std::move( samples ) );
+    return 0;
+}
+
+}
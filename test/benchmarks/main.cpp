@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2017 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace bench
+{
+
+void printPercentiles( const std::string& name, std::vector<int64_t> samples )
+{
+    if ( samples.empty() == true )
+    {
+        std::cout << name << ": no samples" << std::endl;
+        return;
+    }
+    std::sort( begin( samples ), end( samples ) );
+    auto percentile = [&samples]( unsigned int p ) {
+        return samples[( samples.size() - 1 ) * p / 100];
+    };
+    std::cout << name << " (" << samples.size() << " samples, us): "
+              << "min " << samples.front()
+              << " p50 " << percentile( 50 )
+              << " p90 " << percentile( 90 )
+              << " p99 " << percentile( 99 )
+              << " max " << samples.back() << std::endl;
+}
+
+}
+
+static const struct
+{
+    const char* name;
+    int (*run)( int argc, char** argv );
+} Benchmarks[] = {
+    { "reader_latency", &bench::readerLatency },
+    { "hydration", &bench::hydration },
+    { "fuzzy_search", &bench::fuzzySearch },
+    { "downscale", &bench::downscale },
+};
+
+// Usage: benchmarks [name [benchmark arguments...]]
+// Runs all benchmarks with their default parameters when no name is provided
+int main( int argc, char** argv )
+{
+    auto nbRun = 0u;
+    for ( const auto& b : Benchmarks )
+    {
+        if ( argc > 1 && strcmp( argv[1], b.name ) != 0 )
+            continue;
+        std::cout << "Running " << b.name << std::endl;
+        auto res = argc > 1 ? b.run( argc - 1, argv + 1 ) : b.run( 1, argv );
+        if ( res != 0 )
+            return res;
+        ++nbRun;
+    }
+    if ( nbRun == 0 )
+    {
+        std::cerr << "Unknown benchmark " << argv[1] << ". Available benchmarks:" << std::endl;
+        for ( const auto& b : Benchmarks )
+            std::cerr << "\t" << b.name << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -409,6 +409,43 @@ TEST_F( Albums, Sort )
     ASSERT_EQ( a1->id(), albums[2]->id() );
 }
 
+TEST_F( Albums, Paginate )
+{
+    auto a1 = ml->createAlbum( "A" );
+    a1->setReleaseYear( 1000, false );
+    auto a2 = ml->createAlbum( "B" );
+    a2->setReleaseYear( 2000, false );
+    auto a3 = ml->createAlbum( "C" );
+    a3->setReleaseYear( 1000, false );
+
+    auto page = ml->albums( 2, "", SortingCriteria::ReleaseDate, false );
+    ASSERT_EQ( 2u, page.items.size() );
+    ASSERT_EQ( a1->id(), page.items[0]->id() );
+    ASSERT_EQ( a3->id(), page.items[1]->id() );
+    page = ml->albums( 2, page.next, SortingCriteria::ReleaseDate, false );
+    ASSERT_EQ( 1u, page.items.size() );
+    ASSERT_EQ( a2->id(), page.items[0]->id() );
+    ASSERT_TRUE( page.next.empty() );
+
+    // We do not invert the lexical order when sorting by DESC release date:
+    page = ml->albums( 2, "", SortingCriteria::ReleaseDate, true );
+    ASSERT_EQ( 2u, page.items.size() );
+    ASSERT_EQ( a2->id(), page.items[0]->id() );
+    ASSERT_EQ( a1->id(), page.items[1]->id() );
+    page = ml->albums( 2, page.next, SortingCriteria::ReleaseDate, true );
+    ASSERT_EQ( 1u, page.items.size() );
+    ASSERT_EQ( a3->id(), page.items[0]->id() );
+
+    page = ml->albums( 1, "", SortingCriteria::Default, true );
+    ASSERT_EQ( 1u, page.items.size() );
+    ASSERT_EQ( a3->id(), page.items[0]->id() );
+    page = ml->albums( 5, page.next, SortingCriteria::Default, true );
+    ASSERT_EQ( 2u, page.items.size() );
+    ASSERT_EQ( a2->id(), page.items[0]->id() );
+    ASSERT_EQ( a1->id(), page.items[1]->id() );
+    ASSERT_TRUE( page.next.empty() );
+}
+
 TEST_F( Albums, SortByPlayCount )
 {
     auto a1 = ml->createAlbum( "North" );
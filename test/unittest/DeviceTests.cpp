@@ -50,6 +50,8 @@ protected:
     virtual void SetUp() override
     {
         unlink( "test.db" );
+        unlink( "test.db-wal" );
+        unlink( "test.db-shm" );
         fsMock.reset( new mock::FileSystemFactory );
         cbMock.reset( new mock::WaitForDiscoveryComplete );
         fsMock->addFolder( "file:///a/mnt/" );
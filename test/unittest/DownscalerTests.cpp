@@ -0,0 +1,112 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <random>
+
+#include "utils/Downscaler.h"
+
+using namespace medialibrary;
+
+namespace
+{
+
+std::vector<uint8_t> randomPicture( uint32_t pitch, uint32_t height )
+{
+    std::mt19937 rng( 42 );
+    std::vector<uint8_t> pic( pitch * height );
+    for ( auto& b : pic )
+        b = static_cast<uint8_t>( rng() );
+    return pic;
+}
+
+void setPixel( std::vector<uint8_t>& pic, uint32_t pitch, uint32_t x, uint32_t y,
+               uint8_t r, uint8_t g, uint8_t b )
+{
+    uint32_t px = r << 16 | g << 8 | b;
+    memcpy( &pic[y * pitch + x * 4], &px, 4 );
+}
+
+}
+
+TEST( Downscalers, Average )
+{
+    // A 4x2 picture, downscaled by 2
+    const uint32_t pitch = 4 * 4;
+    std::vector<uint8_t> pic( pitch * 2 );
+    setPixel( pic, pitch, 0, 0, 0, 10, 255 );
+    setPixel( pic, pitch, 1, 0, 0, 20, 255 );
+    setPixel( pic, pitch, 0, 1, 100, 30, 255 );
+    setPixel( pic, pitch, 1, 1, 100, 41, 255 );
+    setPixel( pic, pitch, 2, 0, 1, 2, 3 );
+    setPixel( pic, pitch, 3, 0, 1, 2, 3 );
+    setPixel( pic, pitch, 2, 1, 1, 2, 3 );
+    setPixel( pic, pitch, 3, 1, 1, 2, 3 );
+
+    Downscaler downscaler;
+    uint8_t rgb[6];
+    downscaler.process( pic.data(), pitch, 2, 0, 0, rgb, 2, 1, Downscaler::Format::RGB24 );
+    ASSERT_EQ( 50, rgb[0] );
+    // (10 + 20 + 30 + 41) / 4, rounded
+    ASSERT_EQ( 25, rgb[1] );
+    ASSERT_EQ( 255, rgb[2] );
+    ASSERT_EQ( 1, rgb[3] );
+    ASSERT_EQ( 2, rgb[4] );
+    ASSERT_EQ( 3, rgb[5] );
+
+    // Crop the second pixel only, keeping the input layout
+    uint32_t rv32;
+    downscaler.process( pic.data(), pitch, 2, 1, 0, reinterpret_cast<uint8_t*>( &rv32 ),
+                        1, 1, Downscaler::Format::RV32 );
+    ASSERT_EQ( 0xFF010203u, rv32 );
+}
+
+TEST( Downscalers, SimdMatchesScalar )
+{
+    Downscaler simd;
+    Downscaler scalar( false );
+    // Odd sizes, so that the vectorized loops have remainders to handle
+    const uint32_t width = 37;
+    const uint32_t height = 11;
+    for ( auto factor = 1u; factor <= 5; ++factor )
+    {
+        const auto pitch = ( width + 3 ) * factor * 4 + 12;
+        auto pic = randomPicture( pitch, ( height + 2 ) * factor );
+        for ( auto format : { Downscaler::Format::RGB24, Downscaler::Format::RV32 } )
+        {
+            auto size = width * height * Downscaler::bytesPerPixel( format );
+            std::vector<uint8_t> expected( size );
+            std::vector<uint8_t> res( size );
+            scalar.process( pic.data(), pitch, factor, 3, 2, expected.data(),
+                            width, height, format );
+            simd.process( pic.data(), pitch, factor, 3, 2, res.data(),
+                          width, height, format );
+            ASSERT_EQ( expected, res );
+        }
+    }
+}
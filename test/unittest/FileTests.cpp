@@ -28,6 +28,7 @@
 
 #include "Media.h"
 #include "File.h"
+#include "mocks/FileSystem.h"
 
 class Files : public Tests
 {
@@ -75,3 +76,61 @@ TEST_F( Files, Media )
     f = std::static_pointer_cast<File>( files[0] );
     ASSERT_EQ( m->id(), f->media()->id() );
 }
+
+TEST_F( Files, Cursor )
+{
+    ml->addFile( "media2.mkv" );
+    ml->addFile( "media3.mkv" );
+
+    const std::string req = "SELECT * FROM " + policy::FileTable::Name + " WHERE id_file >= ?";
+    auto nbFiles = 0u;
+    for ( const auto& file : File::fetchCursor<File>( ml.get(), req, f->id() ) )
+    {
+        ASSERT_NE( nullptr, file );
+        ++nbFiles;
+    }
+    ASSERT_EQ( 3u, nbFiles );
+
+    // Stopping early must release the read context, otherwise the following
+    // insertion would block forever
+    {
+        auto cursor = File::fetchCursor<File>( ml.get(), req, f->id() );
+        auto it = cursor.begin();
+        ASSERT_NE( cursor.end(), it );
+        ASSERT_EQ( f->id(), (*it)->id() );
+    }
+    auto m4 = ml->addFile( "media4.mkv" );
+    ASSERT_NE( nullptr, m4 );
+
+    auto cursor = File::fetchCursor<File>( ml.get(), req, m4->files()[0]->id() );
+    auto it = cursor.begin();
+    ASSERT_NE( cursor.end(), it );
+    ++it;
+    ASSERT_EQ( cursor.end(), it );
+}
+
+TEST_F( Files, CreateBatch )
+{
+    std::vector<std::string> fileNames{ "batch1.mkv", "batch2.mkv", "batch3.mkv" };
+    auto medias = Media::createBatch( ml.get(), IMedia::Type::Unknown, fileNames );
+    ASSERT_EQ( 3u, medias.size() );
+
+    std::vector<int64_t> mediaIds;
+    std::vector<std::shared_ptr<fs::IFile>> filesFs;
+    for ( auto i = 0u; i < medias.size(); ++i )
+    {
+        mediaIds.push_back( medias[i]->id() );
+        filesFs.push_back( std::make_shared<mock::NoopFile>( fileNames[i] ) );
+    }
+    auto files = File::createBatch( ml.get(), mediaIds, File::Type::Main, filesFs, 0, false );
+    ASSERT_EQ( 3u, files.size() );
+    for ( auto i = 0u; i < files.size(); ++i )
+    {
+        ASSERT_NE( f->id(), files[i]->id() );
+        ASSERT_EQ( fileNames[i], files[i]->mrl() );
+        ASSERT_EQ( medias[i]->id(), files[i]->media()->id() );
+        auto mediaFiles = medias[i]->files();
+        ASSERT_EQ( 1u, mediaFiles.size() );
+        ASSERT_EQ( files[i], mediaFiles[0] );
+    }
+}
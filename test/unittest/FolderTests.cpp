@@ -47,6 +47,8 @@ public:
     virtual void SetUp() override
     {
         unlink("test.db");
+        unlink("test.db-wal");
+        unlink("test.db-shm");
         fsMock.reset( new mock::FileSystemFactory );
         cbMock.reset( new mock::WaitForDiscoveryComplete );
         Reload();
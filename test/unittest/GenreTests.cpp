@@ -201,6 +201,23 @@ TEST_F( Genres, Sort )
     ASSERT_EQ( g2->id(), genres[0]->id() );
 }
 
+TEST_F( Genres, Paginate )
+{
+    auto g2 = ml->createGenre( "Genre 2" );
+    auto g3 = ml->createGenre( "genre 3" );
+
+    auto page = ml->genres( 2, "", SortingCriteria::Default, false );
+    ASSERT_EQ( 2u, page.items.size() );
+    ASSERT_EQ( g->id(), page.items[0]->id() );
+    ASSERT_EQ( g2->id(), page.items[1]->id() );
+    ASSERT_FALSE( page.next.empty() );
+
+    page = ml->genres( 2, page.next, SortingCriteria::Default, false );
+    ASSERT_EQ( 1u, page.items.size() );
+    ASSERT_EQ( g3->id(), page.items[0]->id() );
+    ASSERT_TRUE( page.next.empty() );
+}
+
 TEST_F( Genres, NbTracks )
 {
     ASSERT_EQ( 0u, g->nbTracks() );
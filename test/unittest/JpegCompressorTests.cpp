@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_JPEG
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "metadata_services/vlc/imagecompressors/JpegCompressor.h"
+
+using namespace medialibrary;
+
+namespace
+{
+
+std::string readFile( const std::string& path )
+{
+    std::ifstream in( path, std::ios::binary );
+    return std::string( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+}
+
+}
+
+TEST( JpegCompressors, Compress )
+{
+    const std::string path = "thumbnail_test.jpg";
+    std::vector<uint8_t> picture( 64 * 48 * 3 );
+    for ( auto i = 0u; i < picture.size(); ++i )
+        picture[i] = static_cast<uint8_t>( i * 7 );
+
+    JpegCompressor compressor;
+    // Crop the center of the picture
+    ASSERT_TRUE( compressor.compress( picture.data(), path, 64, 48, 32, 24, 16, 12 ) );
+    auto first = readFile( path );
+    ASSERT_LT( 4u, first.size() );
+    ASSERT_EQ( "\xFF\xD8", first.substr( 0, 2 ) );
+    ASSERT_EQ( "\xFF\xD9", first.substr( first.size() - 2 ) );
+    // The temporary file must have been moved in place
+    ASSERT_EQ( nullptr, fopen( ( path + ".tmp" ).c_str(), "rb" ) );
+
+    // An existing thumbnail gets replaced
+    ASSERT_TRUE( compressor.compress( picture.data(), path, 64, 48, 64, 48, 0, 0 ) );
+    auto second = readFile( path );
+    ASSERT_NE( first, second );
+    ASSERT_EQ( "\xFF\xD9", second.substr( second.size() - 2 ) );
+    std::remove( path.c_str() );
+
+    // Failing to write the thumbnail doesn't leave anything behind
+    ASSERT_FALSE( compressor.compress( picture.data(), "missing/folder/thumbnail.jpg",
+                                       64, 48, 64, 48, 0, 0 ) );
+}
+
+#endif
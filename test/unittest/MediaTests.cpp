@@ -26,6 +26,8 @@
 
 #include "Tests.h"
 
+#include <set>
+
 #include "medialibrary/IMediaLibrary.h"
 #include "File.h"
 #include "Media.h"
@@ -34,6 +36,8 @@
 #include "AlbumTrack.h"
 #include "mocks/FileSystem.h"
 #include "mocks/DiscovererCbMock.h"
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
 #include "compat/Thread.h"
 
 class Medias : public Tests
@@ -78,6 +82,78 @@ TEST_F( Medias, Fetch )
     ASSERT_EQ( f->id(), f2->id() );
 }
 
+TEST_F( Medias, FetchMany )
+{
+    auto m1 = ml->addMedia( "media1.mkv" );
+    auto m2 = ml->addMedia( "media2.mkv" );
+    auto m3 = ml->addMedia( "media3.mkv" );
+
+    // Cached media are returned as is, in the requested order
+    auto media = ml->media( std::vector<int64_t>{ m3->id(), 9999, m1->id(), m3->id() } );
+    ASSERT_EQ( 3u, media.size() );
+    ASSERT_EQ( m3, media[0] );
+    ASSERT_EQ( m1, media[1] );
+    ASSERT_EQ( m3, media[2] );
+
+    Reload();
+
+    media = ml->media( std::vector<int64_t>{ m2->id(), m1->id() } );
+    ASSERT_EQ( 2u, media.size() );
+    ASSERT_EQ( m2->id(), media[0]->id() );
+    ASSERT_EQ( m1->id(), media[1]->id() );
+    // Fetched media must have been cached
+    ASSERT_EQ( media[0], ml->media( m2->id() ) );
+
+    ASSERT_EQ( 0u, ml->media( std::vector<int64_t>{} ).size() );
+}
+
+TEST_F( Medias, FetchManyChunks )
+{
+    std::vector<std::string> fileNames;
+    for ( auto i = 0u; i < 1500; ++i )
+        fileNames.push_back( "media" + std::to_string( i ) + ".mkv" );
+    auto created = Media::createBatch( ml.get(), IMedia::Type::Unknown, fileNames );
+    ASSERT_EQ( fileNames.size(), created.size() );
+    std::vector<int64_t> ids;
+    for ( auto it = created.rbegin(); it != created.rend(); ++it )
+        ids.push_back( (*it)->id() );
+    created.clear();
+
+    Reload();
+
+    auto media = ml->media( ids );
+    ASSERT_EQ( ids.size(), media.size() );
+    for ( auto i = 0u; i < ids.size(); ++i )
+        ASSERT_EQ( ids[i], media[i]->id() );
+}
+
+TEST_F( Medias, CreateBatch )
+{
+    std::vector<std::string> fileNames;
+    // Ensure we go beyond the number of variables allowed in a single statement
+    for ( auto i = 0u; i < 1000; ++i )
+        fileNames.push_back( "media" + std::to_string( i ) + ".mkv" );
+    auto medias = Media::createBatch( ml.get(), IMedia::Type::Unknown, fileNames );
+    ASSERT_EQ( fileNames.size(), medias.size() );
+    for ( auto i = 0u; i < medias.size(); ++i )
+    {
+        ASSERT_NE( 0, medias[i]->id() );
+        if ( i > 0 )
+        {
+            ASSERT_EQ( medias[i - 1]->id() + 1, medias[i]->id() );
+        }
+        ASSERT_EQ( fileNames[i], medias[i]->title() );
+        // The media should have been cached
+        ASSERT_EQ( medias[i], ml->media( medias[i]->id() ) );
+    }
+
+    Reload();
+
+    auto m = ml->media( medias.back()->id() );
+    ASSERT_NE( nullptr, m );
+    ASSERT_EQ( fileNames.back(), m->title() );
+}
+
 TEST_F( Medias, Duration )
 {
     auto f = std::static_pointer_cast<Media>( ml->addMedia( "media.avi" ) );
@@ -173,6 +249,168 @@ TEST_F( Medias, Search )
     ASSERT_EQ( 0u, media.size() );
 }
 
+TEST_F( Medias, SearchBlankPattern )
+{
+    ml->addMedia( "track.mp3" );
+    ml->createAlbum( "album" );
+    // Neither blank patterns nor short words make a valid search
+    for ( const auto pattern : { "   ", " \t\n ", "a b", "tr ac" } )
+    {
+        ASSERT_EQ( 0u, ml->searchMedia( pattern ).others.size() );
+        ASSERT_EQ( 0u, ml->searchAlbums( pattern ).size() );
+        ASSERT_EQ( 0u, ml->searchArtists( pattern ).size() );
+        ASSERT_EQ( 0u, ml->searchGenre( pattern ).size() );
+        ASSERT_EQ( 0u, ml->searchPlaylists( pattern ).size() );
+        ASSERT_EQ( 0u, ml->search( pattern ).media.others.size() );
+        ASSERT_EQ( 0u, ml->createMediaSearchSession()->searchMedia( pattern ).others.size() );
+    }
+    ASSERT_EQ( 1u, ml->searchMedia( "  tra " ).others.size() );
+}
+
+TEST_F( Medias, SearchDiacriticsAndQuotes )
+{
+    auto m = std::static_pointer_cast<Media>( ml->addMedia( "media.mp3" ) );
+    m->setTitleBuffered( "Sigur Rós \"Hoppípolla\"" );
+    m->save();
+
+    auto media = ml->searchMedia( "ros hoppi" ).others;
+    ASSERT_EQ( 1u, media.size() );
+
+    media = ml->searchMedia( "\"hopp" ).others;
+    ASSERT_EQ( 1u, media.size() );
+
+    // FTS5 operators must be treated as plain words
+    media = ml->searchMedia( "sigur OR" ).others;
+    ASSERT_EQ( 0u, media.size() );
+}
+
+TEST_F( Medias, SearchAllRanked )
+{
+    for ( auto i = 0u; i < 5u; ++i )
+        ml->addMedia( "otters " + std::to_string( i ) + ".mkv" );
+    auto best = std::static_pointer_cast<Media>( ml->addMedia( "best.mkv" ) );
+    best->setTitleBuffered( "otters otters otters" );
+    best->save();
+    auto a = ml->createAlbum( "otters album" );
+
+    auto res = ml->search( "otters", 3 );
+    ASSERT_EQ( 3u, res.media.others.size() );
+    ASSERT_EQ( best->id(), res.media.others[0]->id() );
+    ASSERT_EQ( 1u, res.albums.size() );
+    ASSERT_EQ( a->id(), res.albums[0]->id() );
+
+    res = ml->search( "otters", 0 );
+    ASSERT_EQ( 6u, res.media.others.size() );
+    ASSERT_EQ( 0u, res.media.tracks.size() );
+
+    res = ml->search( "ot", 3 );
+    ASSERT_EQ( 0u, res.media.others.size() );
+}
+
+TEST_F( Medias, SearchSession )
+{
+    for ( auto i = 1u; i <= 10u; ++i )
+        ml->addMedia( "track " + std::to_string( i ) + ".mp3" );
+    auto session = ml->createMediaSearchSession();
+    auto media = session->searchMedia( "tra" ).others;
+    ASSERT_EQ( 10u, media.size() );
+
+    // Refining the pattern only considers the previous results
+    ml->addMedia( "track 11.mp3" );
+    media = session->searchMedia( "track 1" ).others;
+    ASSERT_EQ( 2u, media.size() );
+    media = session->searchMedia( "track 10" ).others;
+    ASSERT_EQ( 1u, media.size() );
+
+    // Any other pattern looks up the whole index again
+    media = session->searchMedia( "track 1" ).others;
+    ASSERT_EQ( 3u, media.size() );
+    media = session->searchMedia( "grouik" ).others;
+    ASSERT_EQ( 0u, media.size() );
+    media = session->searchMedia( "track" ).others;
+    ASSERT_EQ( 11u, media.size() );
+}
+
+TEST_F( Medias, FuzzySearch )
+{
+    auto m = std::static_pointer_cast<Media>( ml->addMedia( "media.mkv" ) );
+    m->setTitleBuffered( "The Beatles - Help" );
+    m->save();
+    ml->addMedia( "otters.mkv" );
+
+    auto res = ml->fuzzySearch( "beatels", 0 );
+    ASSERT_EQ( 1u, res.media.others.size() );
+    ASSERT_EQ( m->id(), res.media.others[0]->id() );
+
+    // The index is kept up to date once loaded
+    auto m2 = ml->addMedia( "beatles.mkv" );
+    m->setTitleBuffered( "Help" );
+    m->save();
+    res = ml->fuzzySearch( "beatels", 0 );
+    ASSERT_EQ( 1u, res.media.others.size() );
+    ASSERT_EQ( m2->id(), res.media.others[0]->id() );
+
+    Media::destroy( ml.get(), m2->id() );
+    res = ml->fuzzySearch( "beatels", 0 );
+    ASSERT_EQ( 0u, res.media.others.size() );
+}
+
+TEST_F( Medias, FuzzySearchDuringTransaction )
+{
+    auto conn = ml->getConn();
+    // Without WAL, the search would wait for the transaction to be committed
+    if ( conn->isWalEnabled() == false )
+        return;
+    auto m = std::static_pointer_cast<Media>( ml->addMedia( "media.mkv" ) );
+    m->setTitleBuffered( "The Beatles - Help" );
+    m->save();
+
+    // The index gets loaded while the media is being renamed
+    compat::Thread writer( [&conn, &m]() {
+        auto t = conn->newTransaction();
+        m->setTitle( "Yellow Submarine" );
+        compat::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+        t->commit();
+    });
+    compat::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    ml->fuzzySearch( "beatels", 0 );
+    writer.join();
+    auto res = ml->fuzzySearch( "submarnie", 0 );
+    ASSERT_EQ( 1u, res.media.others.size() );
+
+    // The index is refreshed while the media is being renamed
+    compat::Mutex mutex;
+    compat::ConditionVariable cond;
+    auto renamed = false;
+    auto searched = false;
+    compat::Thread writer2( [&]() {
+        auto t = conn->newTransaction();
+        m->setTitle( "Abbey Road" );
+        std::unique_lock<compat::Mutex> l( mutex );
+        renamed = true;
+        cond.notify_all();
+        cond.wait( l, [&searched]() { return searched; } );
+        t->commit();
+    });
+    {
+        std::unique_lock<compat::Mutex> l( mutex );
+        cond.wait( l, [&renamed]() { return renamed; } );
+    }
+    auto nbOutdated = ml->fuzzySearch( "submarnie", 0 ).media.others.size();
+    {
+        std::lock_guard<compat::Mutex> l( mutex );
+        searched = true;
+        cond.notify_all();
+    }
+    writer2.join();
+    // The search still sees the committed title
+    ASSERT_EQ( 1u, nbOutdated );
+    res = ml->fuzzySearch( "abey road", 0 );
+    ASSERT_EQ( 1u, res.media.others.size() );
+    res = ml->fuzzySearch( "submarnie", 0 );
+    ASSERT_EQ( 0u, res.media.others.size() );
+}
+
 TEST_F( Medias, SearchAfterEdit )
 {
     auto m = std::static_pointer_cast<Media>( ml->addMedia( "media.mp3" ) );
@@ -376,6 +614,84 @@ TEST_F( Medias, SortByAlpha )
     ASSERT_EQ( m1->id(), media[2]->id() );
 }
 
+TEST_F( Medias, Paginate )
+{
+    // Use duplicated titles to ensure the pagination doesn't skip or repeat
+    // media sharing the same sorting key
+    const char* titles[] = { "B", "a", "C", "b", "A", "c", "B" };
+    for ( auto i = 0u; i < sizeof( titles ) / sizeof( titles[0] ); ++i )
+    {
+        auto m = std::static_pointer_cast<Media>( ml->addMedia( "media" + std::to_string( i ) + ".mp3" ) );
+        m->setTitleBuffered( titles[i] );
+        m->setType( Media::Type::Audio );
+        m->save();
+    }
+
+    for ( auto desc : { false, true } )
+    {
+        auto all = ml->audioFiles( SortingCriteria::Alpha, desc );
+        ASSERT_EQ( 7u, all.size() );
+        std::vector<MediaPtr> paginated;
+        std::string after;
+        auto nbPages = 0u;
+        do
+        {
+            auto page = ml->audioFiles( 3, after, SortingCriteria::Alpha, desc );
+            ASSERT_GE( 3u, page.items.size() );
+            paginated.insert( end( paginated ), begin( page.items ), end( page.items ) );
+            after = page.next;
+            ++nbPages;
+        } while ( after.empty() == false );
+        ASSERT_EQ( 3u, nbPages );
+        ASSERT_EQ( all.size(), paginated.size() );
+        for ( auto i = 0u; i < all.size(); ++i )
+            ASSERT_EQ( strcasecmp( all[i]->title().c_str(), paginated[i]->title().c_str() ), 0 );
+        std::sort( begin( paginated ), end( paginated ), []( const MediaPtr& l, const MediaPtr& r ) {
+            return l->id() < r->id();
+        });
+        auto last = std::unique( begin( paginated ), end( paginated ), []( const MediaPtr& l, const MediaPtr& r ) {
+            return l->id() == r->id();
+        });
+        ASSERT_EQ( end( paginated ), last );
+    }
+
+    // The key of a listing can't be used to resume a differently sorted listing
+    auto page = ml->audioFiles( 3, "", SortingCriteria::Alpha, false );
+    ASSERT_FALSE( page.next.empty() );
+    auto invalid = ml->audioFiles( 3, page.next, SortingCriteria::Duration, false );
+    ASSERT_EQ( 0u, invalid.items.size() );
+    invalid = ml->audioFiles( 3, "not a key", SortingCriteria::Alpha, false );
+    ASSERT_EQ( 0u, invalid.items.size() );
+}
+
+TEST_F( Medias, PaginateByPlayCount )
+{
+    auto m1 = std::static_pointer_cast<Media>( ml->addMedia( "media1.mp3" ) );
+    m1->setType( Media::Type::Audio );
+    m1->increasePlayCount();
+    m1->increasePlayCount();
+    m1->save();
+    auto m2 = std::static_pointer_cast<Media>( ml->addMedia( "media2.mp3" ) );
+    m2->setType( Media::Type::Audio );
+    m2->save();
+    auto m3 = std::static_pointer_cast<Media>( ml->addMedia( "media3.mp3" ) );
+    m3->setType( Media::Type::Audio );
+    m3->increasePlayCount();
+    m3->save();
+
+    // Most played first by default
+    auto page = ml->audioFiles( 2, "", SortingCriteria::PlayCount, false );
+    ASSERT_EQ( 2u, page.items.size() );
+    ASSERT_EQ( m1->id(), page.items[0]->id() );
+    ASSERT_EQ( m3->id(), page.items[1]->id() );
+    ASSERT_FALSE( page.next.empty() );
+
+    page = ml->audioFiles( 2, page.next, SortingCriteria::PlayCount, false );
+    ASSERT_EQ( 1u, page.items.size() );
+    ASSERT_EQ( m2->id(), page.items[0]->id() );
+    ASSERT_TRUE( page.next.empty() );
+}
+
 TEST_F( Medias, SortByLastModifDate )
 {
     auto file1 = std::make_shared<mock::NoopFile>( "media.mkv" );
@@ -426,6 +742,53 @@ TEST_F( Medias, SortByFileSize )
     ASSERT_EQ( m1->id(), media[0]->id() );
 }
 
+TEST_F( Medias, PaginateWithExternalFiles )
+{
+    // The external files don't have a size nor a modification date
+    for ( auto i = 0u; i < 3; ++i )
+    {
+        auto m = std::static_pointer_cast<Media>(
+                    ml->addMedia( "external" + std::to_string( i ) + ".mkv" ) );
+        m->setType( Media::Type::Video );
+        m->save();
+        auto file = std::make_shared<mock::NoopFile>( "media" + std::to_string( i ) + ".mkv" );
+        file->setSize( 100 * ( i + 1 ) );
+        file->setLastModificationDate( 100 * ( 3 - i ) );
+        m = ml->addFile( file );
+        m->setType( Media::Type::Video );
+        m->save();
+    }
+
+    for ( auto sort : { SortingCriteria::FileSize, SortingCriteria::LastModificationDate } )
+    {
+        for ( auto desc : { false, true } )
+        {
+            auto all = ml->videoFiles( sort, desc );
+            ASSERT_EQ( 6u, all.size() );
+            std::vector<MediaPtr> paginated;
+            std::string after;
+            do
+            {
+                auto page = ml->videoFiles( 2, after, sort, desc );
+                paginated.insert( end( paginated ), begin( page.items ), end( page.items ) );
+                after = page.next;
+            } while ( after.empty() == false && paginated.size() <= all.size() );
+            ASSERT_EQ( all.size(), paginated.size() );
+            std::set<int64_t> ids;
+            for ( const auto& m : paginated )
+                ids.insert( m->id() );
+            ASSERT_EQ( all.size(), ids.size() );
+            // The external files come first in ascending order
+            auto externalIdx = desc == true ? 3u : 0u;
+            for ( auto i = externalIdx; i < externalIdx + 3; ++i )
+            {
+                ASSERT_EQ( 0u, paginated[i]->files()[0]->size() );
+                ASSERT_EQ( 0u, all[i]->files()[0]->size() );
+            }
+        }
+    }
+}
+
 TEST_F( Medias, SetType )
 {
     auto m1 = std::static_pointer_cast<Media>( ml->addMedia( "media1.mp3" ) );
@@ -545,6 +908,8 @@ protected:
     virtual void SetUp() override
     {
         unlink( "test.db" );
+        unlink( "test.db-wal" );
+        unlink( "test.db-shm" );
         fsMock.reset( new mock::FileSystemFactory );
         cbMock.reset( new mock::WaitForDiscoveryComplete );
         fsMock->addFolder( "file:///a/mnt/" );
@@ -603,3 +968,47 @@ TEST_F( FetchMedia, FetchRemovableUnplugged )
     auto m = ml->media( RemovableDeviceMountpoint + "removablefile.mp3" );
     ASSERT_EQ( nullptr, m );
 }
+
+class MediaCache : public Tests
+{
+protected:
+    virtual void TearDown() override
+    {
+        ml->setMaxCachedEntities( cachepolicy::Bounded<Media>::DefaultMaxSize );
+        Tests::TearDown();
+    }
+};
+
+TEST_F( MediaCache, Eviction )
+{
+    // Keep a single media per cache stripe
+    ml->setMaxCachedEntities( cachepolicy::NbStripes );
+    auto m1 = ml->addMedia( "media1.mkv" );
+    std::weak_ptr<IMedia> weak1 = m1;
+    auto id1 = m1->id();
+    m1.reset();
+    // Still cached, since it's the most recently used media of its stripe
+    ASSERT_FALSE( weak1.expired() );
+
+    for ( auto i = 0u; i < cachepolicy::NbStripes; ++i )
+        ml->addMedia( "media" + std::to_string( i + 2 ) + ".mkv" );
+    // media1 got evicted, and isn't held by anyone anymore
+    ASSERT_TRUE( weak1.expired() );
+    auto m = ml->media( id1 );
+    ASSERT_NE( nullptr, m );
+    ASSERT_EQ( id1, m->id() );
+}
+
+TEST_F( MediaCache, HeldEntitiesStayUnique )
+{
+    ml->setMaxCachedEntities( cachepolicy::NbStripes );
+    auto m1 = ml->addMedia( "media1.mkv" );
+    for ( auto i = 0u; i < cachepolicy::NbStripes * 2; ++i )
+        ml->addMedia( "media" + std::to_string( i + 2 ) + ".mkv" );
+    // m1 was evicted, but since we still hold it, no other instance must be
+    // created for it
+    auto m = ml->media( m1->id() );
+    ASSERT_EQ( m1, m );
+    m1->setTitle( "new title" );
+    ASSERT_EQ( "new title", m->title() );
+}
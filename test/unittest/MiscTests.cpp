@@ -24,11 +24,17 @@
 # include "config.h"
 #endif
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 
 #include "Tests.h"
 #include "database/SqliteTools.h"
 #include "database/SqliteConnection.h"
+#include "Media.h"
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "compat/Thread.h"
 
 class Misc : public Tests
 {
@@ -43,6 +49,186 @@ TEST_F( Misc, FileExtensions )
     }
 }
 
+TEST_F( Misc, ThreadContexts )
+{
+    auto conn = ml->getConn();
+    auto& ctx = conn->threadContext();
+    ASSERT_EQ( &ctx, &conn->threadContext() );
+    ASSERT_EQ( ctx.handle.get(), conn->handle() );
+
+    static const std::string req = "SELECT COUNT(*) FROM Settings";
+    auto count = [conn]() {
+        sqlite::Statement stmt( conn, req );
+        stmt.execute();
+        auto row = stmt.row();
+        uint32_t res;
+        row >> res;
+        return res;
+    };
+    ASSERT_EQ( 1u, count() );
+    ASSERT_EQ( 1u, ctx.statements.count( req ) );
+
+    // Each thread gets its own connection & statements, which are released
+    // when the thread terminates
+    for ( auto i = 0u; i < 2; ++i )
+    {
+        sqlite::Connection::ThreadContext* threadCtx = nullptr;
+        uint32_t res = 0;
+        compat::Thread t( [conn, &threadCtx, &res, &count]() {
+            threadCtx = &conn->threadContext();
+            res = count();
+        });
+        t.join();
+        ASSERT_NE( &ctx, threadCtx );
+        ASSERT_EQ( 1u, res );
+    }
+    ASSERT_EQ( &ctx, &conn->threadContext() );
+    ASSERT_EQ( 1u, count() );
+}
+
+TEST_F( Misc, ConcurrentReads )
+{
+    auto conn = ml->getConn();
+    if ( conn->isWalEnabled() == false )
+        return;
+    ml->addFile( "media.mkv" );
+
+    std::atomic_bool readDone( false );
+    size_t nbFiles = 0;
+    auto t = conn->newTransaction();
+    ml->addFile( "media2.mkv" );
+    // The reader must not wait for the transaction to complete, and must not
+    // see its uncommitted changes
+    compat::Thread reader( [this, &readDone, &nbFiles]() {
+        nbFiles = ml->files().size();
+        readDone = true;
+    });
+    for ( auto i = 0u; i < 500 && readDone == false; ++i )
+        compat::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    bool doneBeforeCommit = readDone;
+    t->commit();
+    reader.join();
+    ASSERT_TRUE( doneBeforeCommit );
+    ASSERT_EQ( 1u, nbFiles );
+    ASSERT_EQ( 2u, ml->files().size() );
+}
+
+TEST_F( Misc, StaleSnapshotNotCached )
+{
+    auto conn = ml->getConn();
+    if ( conn->isWalEnabled() == false )
+        return;
+    auto m1 = ml->addMedia( "media1.mkv" );
+    auto m2 = ml->addMedia( "media2.mkv" );
+    auto title = m2->title();
+    Media::clear();
+
+    // The cursor reads from a snapshot taken before the update, and mustn't
+    // cache the outdated record once the update has evicted it
+    {
+        auto cursor = Media::fetchCursor<IMedia>( ml.get(), "SELECT * FROM " +
+                        policy::MediaTable::Name + " ORDER BY id_media" );
+        auto it = cursor.begin();
+        ASSERT_EQ( m1->id(), (*it)->id() );
+        compat::Thread writer( [&m2]() {
+            m2->setTitle( "updated title" );
+        });
+        writer.join();
+        ++it;
+        ASSERT_EQ( m2->id(), (*it)->id() );
+        ASSERT_EQ( title, (*it)->title() );
+    }
+    ASSERT_EQ( "updated title", ml->media( m2->id() )->title() );
+
+    // Same goes for the reads running while the update isn't committed yet
+    Media::clear();
+    compat::Mutex mutex;
+    compat::ConditionVariable cond;
+    auto updated = false;
+    auto read = false;
+    compat::Thread writer( [&]() {
+        auto t = conn->newTransaction();
+        m1->setTitle( "updated title" );
+        std::unique_lock<compat::Mutex> l( mutex );
+        updated = true;
+        cond.notify_all();
+        cond.wait( l, [&read]() { return read; } );
+        t->commit();
+    });
+    {
+        std::unique_lock<compat::Mutex> l( mutex );
+        cond.wait( l, [&updated]() { return updated; } );
+    }
+    auto title1 = ml->media( m1->id() )->title();
+    {
+        std::lock_guard<compat::Mutex> l( mutex );
+        read = true;
+        cond.notify_all();
+    }
+    writer.join();
+    ASSERT_EQ( "media1.mkv", title1 );
+    ASSERT_EQ( "updated title", ml->media( m1->id() )->title() );
+}
+
+TEST_F( Misc, ConcurrentDeletionsAndFetches )
+{
+    auto conn = ml->getConn();
+    if ( conn->isWalEnabled() == false )
+        return;
+
+    std::atomic<int64_t> mediaId( 0 );
+    std::atomic_bool done( false );
+    compat::Thread reader( [this, &mediaId, &done]() {
+        while ( done == false )
+            Media::fetch( ml.get(), mediaId.load() );
+    });
+    auto nbStale = 0u;
+    for ( auto i = 0u; i < 200; ++i )
+    {
+        auto m = ml->addMedia( "media" + std::to_string( i ) + ".mkv" );
+        mediaId = m->id();
+        compat::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+        Media::destroy( ml.get(), m->id() );
+        // Fetching by ids returns the cached instances without querying the
+        // database, so a deleted record cached again by the reader would
+        // be returned
+        nbStale += ml->media( std::vector<int64_t>{ m->id() } ).size();
+    }
+    done = true;
+    reader.join();
+    ASSERT_EQ( 0u, nbStale );
+}
+
+TEST_F( Misc, NestedTransactions )
+{
+    auto conn = ml->getConn();
+    int64_t rolledBackId;
+    {
+        auto t = conn->newTransaction();
+        ml->addFile( "media.mkv" );
+        {
+            auto nested = conn->newTransaction();
+            rolledBackId = ml->addFile( "media2.mkv" )->id();
+        }
+        ASSERT_TRUE( sqlite::Transaction::transactionInProgress() );
+        t->commit();
+    }
+    ASSERT_FALSE( sqlite::Transaction::transactionInProgress() );
+    ASSERT_EQ( 1u, ml->files().size() );
+    ASSERT_EQ( nullptr, ml->media( rolledBackId ) );
+
+    {
+        auto t = conn->newTransaction();
+        {
+            auto nested = conn->newTransaction();
+            rolledBackId = ml->addFile( "media3.mkv" )->id();
+            nested->commit();
+        }
+    }
+    ASSERT_EQ( 1u, ml->files().size() );
+    ASSERT_EQ( nullptr, ml->media( rolledBackId ) );
+}
+
 class DbModel : public testing::Test
 {
 protected:
@@ -53,6 +239,8 @@ public:
     virtual void SetUp() override
     {
         unlink("test.db");
+        unlink("test.db-wal");
+        unlink("test.db-shm");
         ml.reset( new MediaLibraryWithoutBackground );
         cbMock.reset( new mock::NoopCallback );
     }
@@ -85,8 +273,6 @@ public:
                 row >> dbVersion;
                 ASSERT_NE( dbVersion, Settings::DbModelVersion );
             }
-            // Keep address sanitizer/memleak detection happy
-            medialibrary::sqlite::Statement::FlushStatementCache();
         }
     }
 
@@ -104,7 +290,6 @@ public:
             row >> dbVersion;
             ASSERT_EQ( dbVersion, Settings::DbModelVersion );
         }
-        medialibrary::sqlite::Statement::FlushStatementCache();
     }
 };
 
@@ -142,3 +327,33 @@ TEST_F ( DbModel, Upgrade6to8 )
     auto media = ml->media( 1 );
     ASSERT_EQ( media, nullptr );
 }
+
+TEST_F( Misc, QueryStats )
+{
+    for ( auto i = 0u; i < 3; ++i )
+        ml->addMedia( "media" + std::to_string( i ) + ".mkv" );
+    ml->resetQueryStats();
+    ASSERT_EQ( 0u, ml->queryStats().size() );
+
+    static const std::string req = "SELECT * FROM " + policy::MediaTable::Name;
+    for ( auto i = 0u; i < 5; ++i )
+    {
+        auto media = Media::fetchAll<IMedia>( ml.get(), req );
+        ASSERT_EQ( 3u, media.size() );
+    }
+    auto stats = ml->queryStats();
+    auto it = std::find_if( begin( stats ), end( stats ), []( const QueryStats& s ) {
+        return s.request == req;
+    });
+    ASSERT_NE( end( stats ), it );
+    ASSERT_EQ( 5u, it->nbExecutions );
+    ASSERT_EQ( 15u, it->nbRows );
+    ASSERT_LE( it->maxDuration, it->totalDuration );
+    auto nbBucketed = 0u;
+    for ( auto l : it->latencies )
+        nbBucketed += l;
+    ASSERT_EQ( 5u, nbBucketed );
+
+    ml->resetQueryStats();
+    ASSERT_EQ( 0u, ml->queryStats().size() );
+}
@@ -0,0 +1,530 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Tests.h"
+
+#include <numeric>
+#include <set>
+#include <thread>
+
+#include "Media.h"
+#include "File.h"
+#include "Folder.h"
+#include "Device.h"
+#include "mocks/FileSystem.h"
+#include "compat/ConditionVariable.h"
+#include "compat/Mutex.h"
+#include "database/SqliteTools.h"
+#include "parser/Parser.h"
+#include "parser/ParserService.h"
+
+namespace
+{
+
+// Records the order in which the tasks are run, and completes them right away
+class RecordingService : public ParserService
+{
+public:
+    RecordingService( std::vector<int64_t>& order, compat::Mutex& lock,
+                      compat::ConditionVariable& cond )
+        : m_order( order ), m_lock( lock ), m_cond( cond )
+    {
+    }
+
+    virtual uint8_t nbThreads() const override { return 1; }
+
+protected:
+    virtual parser::Task::Status run( parser::Task& task ) override
+    {
+        task.markStepCompleted( parser::Task::ParserStep::Completed );
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        m_order.push_back( task.media->id() );
+        m_cond.notify_all();
+        return parser::Task::Status::Success;
+    }
+    virtual const char* name() const override { return "Recording"; }
+    virtual bool isCompleted( const parser::Task& ) const override { return false; }
+
+private:
+    std::vector<int64_t>& m_order;
+    compat::Mutex& m_lock;
+    compat::ConditionVariable& m_cond;
+};
+
+// Creates the tasks media & files in bulk, and makes the first batch commit
+// fail after its first task ran for longer than a batch is allowed to
+class FailingBatchService : public ParserService
+{
+public:
+    FailingBatchService( std::vector<int64_t>& order, compat::Mutex& lock,
+                         compat::ConditionVariable& cond )
+        : m_order( order ), m_lock( lock ), m_cond( cond ), m_failed( false )
+    {
+    }
+
+    virtual uint8_t nbThreads() const override { return 1; }
+
+protected:
+    virtual uint32_t maxBatchSize() const override { return 10; }
+    virtual void prepareBatch( std::vector<parser::Task*>& tasks ) override
+    {
+        for ( auto t : tasks )
+            create( *t );
+    }
+    virtual parser::Task::Status run( parser::Task& task ) override
+    {
+        if ( task.file == nullptr )
+            create( task );
+        if ( m_failed == false )
+        {
+            m_failed = true;
+            // Deferred foreign keys are only checked when committing
+            sqlite::Tools::executeRequest( m_ml->getConn(), "PRAGMA defer_foreign_keys = 1" );
+            sqlite::Tools::executeRequest( m_ml->getConn(),
+                                           "INSERT INTO LabelFileRelation VALUES(12345, 12345)" );
+            std::this_thread::sleep_for( std::chrono::milliseconds( 300 ) );
+        }
+        task.markStepCompleted( parser::Task::ParserStep::Completed );
+        task.mediaCreated = true;
+        std::lock_guard<compat::Mutex> lock( m_lock );
+        m_order.push_back( task.media->id() );
+        m_cond.notify_all();
+        return parser::Task::Status::Success;
+    }
+    virtual const char* name() const override { return "FailingBatch"; }
+    virtual bool isCompleted( const parser::Task& ) const override { return false; }
+
+private:
+    void create( parser::Task& task )
+    {
+        task.media = m_ml->MediaLibrary::addFile( task.fileFs, task.parentFolder,
+                                                   task.parentFolderFs );
+        task.file = std::static_pointer_cast<File>( task.media->files()[0] );
+    }
+
+private:
+    std::vector<int64_t>& m_order;
+    compat::Mutex& m_lock;
+    compat::ConditionVariable& m_cond;
+    bool m_failed;
+};
+
+// Fetches the parser statistics from the idle state change callback
+class StatsCallback : public mock::NoopCallback
+{
+public:
+    StatsCallback() : parser( nullptr ) {}
+
+    virtual void onBackgroundTasksIdleChanged( bool idle ) override
+    {
+        if ( parser == nullptr )
+            return;
+        auto stats = parser.load()->stats();
+        std::lock_guard<compat::Mutex> l( lock );
+        idleStates.push_back( idle );
+        pendingTasks.push_back( stats.nbPendingTasks );
+        cond.notify_all();
+    }
+
+    std::atomic<Parser*> parser;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+    std::vector<bool> idleStates;
+    std::vector<uint32_t> pendingTasks;
+};
+
+// Records the created media notifications
+class CreationCallback : public mock::NoopCallback
+{
+public:
+    virtual void onMediaAdded( std::vector<MediaPtr> media ) override
+    {
+        std::lock_guard<compat::Mutex> l( lock );
+        for ( const auto& m : media )
+            added.push_back( m->id() );
+        cond.notify_all();
+    }
+
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+    std::vector<int64_t> added;
+};
+
+}
+
+class Parsers : public Tests
+{
+protected:
+    virtual void InstantiateMediaLibrary() override
+    {
+        ml.reset( new MediaLibraryWithoutBackground );
+    }
+};
+
+TEST_F( Parsers, Prioritize )
+{
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new RecordingService( order, lock, cond ) ) );
+    parser.pause();
+    parser.start();
+
+    std::vector<std::shared_ptr<Media>> media;
+    std::vector<std::shared_ptr<File>> files;
+    for ( auto i = 0u; i < 5; ++i )
+    {
+        auto m = std::static_pointer_cast<Media>(
+                    ml->addMedia( "media" + std::to_string( i ) + ".mkv" ) );
+        auto f = std::static_pointer_cast<File>( m->files()[0] );
+        parser.parse( f, m, f->mrl() );
+        media.push_back( m );
+        files.push_back( f );
+    }
+    // An empty mrl doesn't match every task
+    parser.prioritize( std::string{} );
+    parser.prioritize( media[3]->id() );
+    parser.prioritize( files[1]->mrl() );
+    parser.resume();
+
+    std::unique_lock<compat::Mutex> l( lock );
+    auto res = cond.wait_for( l, std::chrono::seconds( 5 ), [&order]() {
+        return order.size() == 5;
+    });
+    ASSERT_TRUE( res );
+    // Prioritized tasks are run in the order they were prioritized
+    ASSERT_EQ( media[3]->id(), order[0] );
+    ASSERT_EQ( media[1]->id(), order[1] );
+    ASSERT_EQ( media[0]->id(), order[2] );
+    ASSERT_EQ( media[2]->id(), order[3] );
+    ASSERT_EQ( media[4]->id(), order[4] );
+}
+
+TEST_F( Parsers, PrioritizeIfPending )
+{
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new RecordingService( order, lock, cond ) ) );
+    parser.pause();
+    parser.start();
+
+    std::vector<std::shared_ptr<Media>> media;
+    for ( auto i = 0u; i < 4; ++i )
+    {
+        auto m = std::static_pointer_cast<Media>(
+                    ml->addMedia( "media" + std::to_string( i ) + ".mkv" ) );
+        media.push_back( m );
+    }
+    for ( auto i = 0u; i < 3; ++i )
+    {
+        auto f = std::static_pointer_cast<File>( media[i]->files()[0] );
+        parser.parse( f, media[i], f->mrl() );
+    }
+    parser.prioritizeIfPending( media[2]->id() );
+    // The last media doesn't have any task yet, so it's not remembered
+    parser.prioritizeIfPending( media[3]->id() );
+    auto f = std::static_pointer_cast<File>( media[3]->files()[0] );
+    parser.parse( f, media[3], f->mrl() );
+    parser.resume();
+
+    std::unique_lock<compat::Mutex> l( lock );
+    auto res = cond.wait_for( l, std::chrono::seconds( 5 ), [&order]() {
+        return order.size() == 4;
+    });
+    ASSERT_TRUE( res );
+    ASSERT_EQ( media[2]->id(), order[0] );
+    ASSERT_EQ( media[0]->id(), order[1] );
+    ASSERT_EQ( media[1]->id(), order[2] );
+    ASSERT_EQ( media[3]->id(), order[3] );
+}
+
+TEST_F( Parsers, RestoreByChunks )
+{
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    const auto NbFiles = 600u;
+    // Only the files belonging to a folder get restored
+    auto device = ml->addDevice( "{device}", false );
+    mock::NoopDevice deviceFs;
+    auto folder = Folder::create( ml.get(), "file:///media/", 0, *device, deviceFs );
+    auto folderFs = std::make_shared<mock::NoopDirectory>();
+    std::vector<int64_t> expected;
+    for ( auto i = 0u; i < NbFiles; ++i )
+    {
+        auto file = std::make_shared<mock::NoopFile>(
+                    "file:///media/media" + std::to_string( i ) + ".mkv" );
+        expected.push_back( ml->MediaLibrary::addFile( file, folder, folderFs )->id() );
+    }
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new RecordingService( order, lock, cond ) ) );
+    parser.pause();
+    parser.start();
+    // The files which aren't restored yet are accounted for
+    auto stats = parser.stats();
+    ASSERT_EQ( NbFiles, stats.nbPendingTasks );
+    ASSERT_GT( NbFiles, stats.services[0].nbQueuedTasks );
+    // The unparsed files are queued as the previous ones get parsed
+    parser.resume();
+
+    std::unique_lock<compat::Mutex> l( lock );
+    auto res = cond.wait_for( l, std::chrono::seconds( 10 ), [&order, NbFiles]() {
+        return order.size() == NbFiles;
+    });
+    ASSERT_TRUE( res );
+    ASSERT_EQ( expected, order );
+}
+
+TEST_F( Parsers, Backlog )
+{
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new RecordingService( order, lock, cond ) ) );
+    parser.pause();
+    parser.start();
+    parser.setMaxBacklog( 2 );
+
+    for ( auto i = 0u; i < 3; ++i )
+    {
+        auto m = std::static_pointer_cast<Media>(
+                    ml->addMedia( "media" + std::to_string( i ) + ".mkv" ) );
+        auto f = std::static_pointer_cast<File>( m->files()[0] );
+        parser.parse( f, m, f->mrl() );
+    }
+
+    std::atomic_bool released( false );
+    std::thread t( [&parser, &released]() {
+        parser.waitForBacklog();
+        released = true;
+    });
+    std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+    EXPECT_FALSE( released );
+    // Wait for half of the backlog to be parsed
+    parser.resume();
+    t.join();
+    ASSERT_TRUE( released );
+    std::lock_guard<compat::Mutex> l( lock );
+    ASSERT_LE( 2u, order.size() );
+}
+
+TEST_F( Parsers, Stats )
+{
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new RecordingService( order, lock, cond ) ) );
+    parser.pause();
+    parser.start();
+
+    for ( auto i = 0u; i < 5; ++i )
+    {
+        auto m = std::static_pointer_cast<Media>(
+                    ml->addMedia( "media" + std::to_string( i ) + ".mkv" ) );
+        auto f = std::static_pointer_cast<File>( m->files()[0] );
+        parser.parse( f, m, f->mrl() );
+    }
+    auto stats = parser.stats();
+    ASSERT_EQ( 1u, stats.services.size() );
+    ASSERT_EQ( "Recording", stats.services[0].name );
+    ASSERT_EQ( 5u, stats.services[0].nbQueuedTasks );
+    ASSERT_EQ( 0u, stats.services[0].nbCompleted );
+    ASSERT_EQ( 5u, stats.nbPendingTasks );
+    ASSERT_NE( 0u, stats.threads.size() );
+
+    parser.resume();
+    {
+        std::unique_lock<compat::Mutex> l( lock );
+        auto res = cond.wait_for( l, std::chrono::seconds( 5 ), [&order]() {
+            return order.size() == 5;
+        });
+        ASSERT_TRUE( res );
+    }
+    // Wait for the tasks to be reported as done
+    parser.stop();
+
+    stats = parser.stats();
+    const auto& s = stats.services[0];
+    ASSERT_EQ( 0u, s.nbQueuedTasks );
+    ASSERT_EQ( 0u, s.nbRunningJobs );
+    ASSERT_EQ( 5u, s.nbCompleted );
+    ASSERT_EQ( 0u, s.nbFailed );
+    ASSERT_EQ( 5u, std::accumulate( begin( s.latencies ), end( s.latencies ), uint64_t{ 0 } ) );
+    ASSERT_EQ( 0u, stats.nbPendingTasks );
+    ASSERT_EQ( 0u, stats.eta );
+
+    parser.resetStats();
+    stats = parser.stats();
+    ASSERT_EQ( 0u, stats.services[0].nbCompleted );
+    ASSERT_EQ( 0u, stats.services[0].totalDuration );
+}
+
+TEST_F( Parsers, StatsFromIdleCallback )
+{
+    auto cb = new StatsCallback;
+    cbMock.reset( cb );
+    Reload();
+
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new RecordingService( order, lock, cond ) ) );
+    parser.start();
+    cb->parser = &parser;
+
+    auto m = std::static_pointer_cast<Media>( ml->addMedia( "media.mkv" ) );
+    auto f = std::static_pointer_cast<File>( m->files()[0] );
+    parser.parse( f, m, f->mrl() );
+
+    std::unique_lock<compat::Mutex> l( cb->lock );
+    auto res = cb->cond.wait_for( l, std::chrono::seconds( 5 ), [cb]() {
+        return cb->idleStates.size() == 2;
+    });
+    ASSERT_TRUE( res );
+    ASSERT_FALSE( cb->idleStates[0] );
+    ASSERT_TRUE( cb->idleStates[1] );
+    ASSERT_EQ( 0u, cb->pendingTasks[1] );
+    cb->parser = nullptr;
+}
+
+TEST_F( Parsers, RolledBackBatchSegment )
+{
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    const auto NbFiles = 5u;
+    auto device = ml->addDevice( "{device}", false );
+    mock::NoopDevice deviceFs;
+    auto folder = Folder::create( ml.get(), "file:///media/", 0, *device, deviceFs );
+    auto folderFs = std::make_shared<mock::NoopDirectory>();
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new FailingBatchService( order, lock, cond ) ) );
+    parser.pause();
+    parser.start();
+    for ( auto i = 0u; i < NbFiles; ++i )
+    {
+        auto file = std::make_shared<mock::NoopFile>(
+                    "file:///media/media" + std::to_string( i ) + ".mkv" );
+        parser.parse( file, folder, folderFs, {} );
+    }
+    parser.resume();
+    {
+        std::unique_lock<compat::Mutex> l( lock );
+        // The first task is run twice, since its batch gets rolled back
+        auto res = cond.wait_for( l, std::chrono::seconds( 5 ), [&order, NbFiles]() {
+            return order.size() == NbFiles + 1;
+        });
+        ASSERT_TRUE( res );
+    }
+    parser.stop();
+
+    // The tasks which didn't run as part of the rolled back batch were
+    // neither lost, nor run against the rolled back media
+    ASSERT_EQ( NbFiles, parser.stats().services[0].nbCompleted );
+    Media::clear();
+    std::set<int64_t> ids( begin( order ) + 1, end( order ) );
+    ASSERT_EQ( NbFiles, ids.size() );
+    for ( auto id : ids )
+        ASSERT_NE( nullptr, ml->media( id ) );
+    ASSERT_EQ( NbFiles, ml->files().size() );
+}
+
+TEST_F( Parsers, RolledBackBatchNotifications )
+{
+    auto cb = new CreationCallback;
+    cbMock.reset( cb );
+    Reload();
+
+    std::vector<int64_t> order;
+    compat::Mutex lock;
+    compat::ConditionVariable cond;
+
+    const auto NbFiles = 5u;
+    auto device = ml->addDevice( "{device}", false );
+    mock::NoopDevice deviceFs;
+    auto folder = Folder::create( ml.get(), "file:///media/", 0, *device, deviceFs );
+    auto folderFs = std::make_shared<mock::NoopDirectory>();
+
+    Parser parser( ml.get() );
+    parser.addService( std::unique_ptr<ParserService>(
+                           new FailingBatchService( order, lock, cond ) ) );
+    parser.pause();
+    parser.start();
+    for ( auto i = 0u; i < NbFiles; ++i )
+    {
+        auto file = std::make_shared<mock::NoopFile>(
+                    "file:///media/media" + std::to_string( i ) + ".mkv" );
+        parser.parse( file, folder, folderFs, {} );
+    }
+    parser.resume();
+    {
+        std::unique_lock<compat::Mutex> l( lock );
+        auto res = cond.wait_for( l, std::chrono::seconds( 5 ), [&order, NbFiles]() {
+            return order.size() == NbFiles + 1;
+        });
+        ASSERT_TRUE( res );
+    }
+    parser.stop();
+
+    std::unique_lock<compat::Mutex> l( cb->lock );
+    auto res = cb->cond.wait_for( l, std::chrono::seconds( 5 ), [cb, NbFiles]() {
+        return cb->added.size() >= NbFiles;
+    });
+    ASSERT_TRUE( res );
+    // The media created by the rolled back batch must not be notified, even
+    // later on
+    res = cb->cond.wait_for( l, std::chrono::milliseconds( 700 ), [cb, NbFiles]() {
+        return cb->added.size() > NbFiles;
+    });
+    ASSERT_FALSE( res );
+    std::set<int64_t> ids( begin( cb->added ), end( cb->added ) );
+    ASSERT_EQ( NbFiles, ids.size() );
+    Media::clear();
+    for ( auto id : ids )
+        ASSERT_NE( nullptr, ml->media( id ) );
+}
@@ -67,6 +67,8 @@ protected:
     virtual void SetUp() override
     {
         unlink( "test.db" );
+        unlink( "test.db-wal" );
+        unlink( "test.db-shm" );
         cbMock.reset( new MockCallback );
         Reload();
     }
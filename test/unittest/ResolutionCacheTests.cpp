@@ -0,0 +1,95 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "Tests.h"
+
+#include "Album.h"
+#include "Artist.h"
+#include "Genre.h"
+#include "metadata_services/ResolutionCache.h"
+
+class ResolutionCaches : public Tests
+{
+};
+
+TEST_F( ResolutionCaches, Genre )
+{
+    auto& cache = ml->getResolutionCache();
+    uint32_t generation;
+    ASSERT_EQ( nullptr, cache.genre( "genre", generation ) );
+    auto g = ml->createGenre( "genre" );
+    cache.insertGenre( g, generation );
+    ASSERT_EQ( g, cache.genre( "genre", generation ) );
+
+    ml->deleteGenre( g->id() );
+    ASSERT_EQ( nullptr, cache.genre( "genre", generation ) );
+}
+
+TEST_F( ResolutionCaches, Artist )
+{
+    auto& cache = ml->getResolutionCache();
+    uint32_t generation;
+    ASSERT_EQ( nullptr, cache.artist( "artist", generation ) );
+    auto a = ml->createArtist( "artist" );
+    cache.insertArtist( a, generation );
+    ASSERT_EQ( a, cache.artist( "artist", generation ) );
+
+    ml->deleteArtist( a->id() );
+    ASSERT_EQ( nullptr, cache.artist( "artist", generation ) );
+}
+
+TEST_F( ResolutionCaches, Albums )
+{
+    auto& cache = ml->getResolutionCache();
+    std::vector<std::shared_ptr<Album>> albums;
+    uint32_t generation;
+    auto a1 = ml->createAlbum( "album" );
+    ASSERT_FALSE( cache.albums( "album", albums, generation ) );
+    cache.insertAlbums( "album", { a1 }, generation );
+    ASSERT_TRUE( cache.albums( "album", albums, generation ) );
+    ASSERT_EQ( 1u, albums.size() );
+
+    // A new album with the same title must be a candidate as well
+    auto a2 = ml->createAlbum( "album" );
+    ASSERT_FALSE( cache.albums( "album", albums, generation ) );
+    cache.insertAlbums( "album", { a1, a2 }, generation );
+
+    ml->deleteAlbum( a1->id() );
+    ASSERT_FALSE( cache.albums( "album", albums, generation ) );
+}
+
+TEST_F( ResolutionCaches, ConcurrentDeletion )
+{
+    auto& cache = ml->getResolutionCache();
+    uint32_t generation;
+    auto g = ml->createGenre( "genre" );
+    ASSERT_EQ( nullptr, cache.genre( "genre", generation ) );
+    // The genre gets deleted while it is being fetched: it must not be cached
+    auto other = ml->createGenre( "other" );
+    ml->deleteGenre( other->id() );
+    cache.insertGenre( g, generation );
+    ASSERT_EQ( nullptr, cache.genre( "genre", generation ) );
+}
@@ -0,0 +1,363 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "metadata_services/native/TagReader.h"
+
+using namespace medialibrary;
+
+namespace
+{
+
+// Helps building the synthetic files used by these tests
+class Bytes
+{
+public:
+    Bytes& str( const std::string& s )
+    {
+        m_buff += s;
+        return *this;
+    }
+    Bytes& u8( uint8_t v )
+    {
+        m_buff += static_cast<char>( v );
+        return *this;
+    }
+    Bytes& be16( uint16_t v )
+    {
+        return u8( v >> 8 ).u8( v & 0xFF );
+    }
+    Bytes& be24( uint32_t v )
+    {
+        return u8( v >> 16 ).be16( v & 0xFFFF );
+    }
+    Bytes& be32( uint32_t v )
+    {
+        return be16( v >> 16 ).be16( v & 0xFFFF );
+    }
+    Bytes& syncSafe32( uint32_t v )
+    {
+        return u8( ( v >> 21 ) & 0x7F ).u8( ( v >> 14 ) & 0x7F ).u8( ( v >> 7 ) & 0x7F ).u8( v & 0x7F );
+    }
+    Bytes& le32( uint32_t v )
+    {
+        return u8( v & 0xFF ).u8( ( v >> 8 ) & 0xFF ).u8( ( v >> 16 ) & 0xFF ).u8( v >> 24 );
+    }
+    Bytes& le64( uint64_t v )
+    {
+        return le32( v & 0xFFFFFFFF ).le32( v >> 32 );
+    }
+    Bytes& zeros( size_t nb )
+    {
+        m_buff.append( nb, '\0' );
+        return *this;
+    }
+    Bytes& bytes( const Bytes& b )
+    {
+        m_buff += b.m_buff;
+        return *this;
+    }
+    // Appends an MP4 atom
+    Bytes& atom( const char* type, const Bytes& payload )
+    {
+        return be32( 8 + payload.size() ).str( type ).bytes( payload );
+    }
+    size_t size() const
+    {
+        return m_buff.size();
+    }
+    const std::string& data() const
+    {
+        return m_buff;
+    }
+
+private:
+    std::string m_buff;
+};
+
+Bytes id3Frame( const char* id, const Bytes& payload )
+{
+    return Bytes{}.str( id ).be32( payload.size() ).be16( 0 ).bytes( payload );
+}
+
+Bytes id3Text( const char* id, const std::string& text )
+{
+    return id3Frame( id, Bytes{}.u8( 3 ).str( text ) );
+}
+
+Bytes vorbisComment( const std::vector<std::string>& comments )
+{
+    Bytes b;
+    b.le32( 6 ).str( "vendor" ).le32( comments.size() );
+    for ( const auto& c : comments )
+        b.le32( c.size() ).str( c );
+    return b;
+}
+
+Bytes oggPage( uint8_t type, uint64_t granule, uint32_t seq, const Bytes& packet )
+{
+    Bytes b;
+    b.str( "OggS" ).u8( 0 ).u8( type ).le64( granule ).le32( 0x1234 ).le32( seq ).le32( 0 );
+    auto nbSegments = packet.size() / 255 + 1;
+    b.u8( nbSegments );
+    for ( auto i = 0u; i < nbSegments - 1; ++i )
+        b.u8( 255 );
+    b.u8( packet.size() % 255 );
+    return b.bytes( packet );
+}
+
+}
+
+class TagReaders : public testing::Test
+{
+protected:
+    std::string write( const std::string& extension, const Bytes& content )
+    {
+        auto path = "tagreader." + extension;
+        std::ofstream out( path, std::ios::binary | std::ios::trunc );
+        out.write( content.data().c_str(), content.size() );
+        m_paths.push_back( path );
+        return path;
+    }
+
+    virtual void TearDown() override
+    {
+        for ( const auto& p : m_paths )
+            std::remove( p.c_str() );
+    }
+
+private:
+    std::vector<std::string> m_paths;
+};
+
+TEST_F( TagReaders, IsSupported )
+{
+    ASSERT_TRUE( TagReader::isSupported( "mp3" ) );
+    ASSERT_TRUE( TagReader::isSupported( "FLAC" ) );
+    ASSERT_TRUE( TagReader::isSupported( "opus" ) );
+    ASSERT_TRUE( TagReader::isSupported( "m4a" ) );
+    ASSERT_FALSE( TagReader::isSupported( "mkv" ) );
+    ASSERT_FALSE( TagReader::isSupported( "" ) );
+}
+
+TEST_F( TagReaders, Mp3 )
+{
+    Bytes frames;
+    frames.bytes( id3Text( "TIT2", "title" ) )
+          .bytes( id3Text( "TPE1", "artist" ) )
+          .bytes( id3Text( "TALB", "album" ) )
+          .bytes( id3Text( "TCON", "(17)" ) )
+          .bytes( id3Text( "TRCK", "3/12" ) )
+          .bytes( id3Text( "TPOS", "1/2" ) )
+          // Latin-1 encoded text
+          .bytes( id3Frame( "TPE2", Bytes{}.u8( 0 ).str( "caf\xE9" ) ) )
+          .bytes( id3Frame( "APIC", Bytes{}.u8( 0 ).str( "image/png" ).u8( 0 )
+                                    .u8( 3 ).str( "cover" ).u8( 0 ).str( "PNGDATA" ) ) );
+    Bytes file;
+    file.str( "ID3" ).u8( 3 ).u8( 0 ).u8( 0 )
+        .syncSafe32( frames.size() + 10 ).bytes( frames ).zeros( 10 );
+    auto artworkOffset = file.size() - 10 - 7;
+    // 100 MPEG-1 layer III frames, 128kbps, 44.1kHz, stereo
+    for ( auto i = 0; i < 100; ++i )
+        file.be32( 0xFFFB9000 ).zeros( 417 - 4 );
+    // An ID3v1 tag, only used to complete the ID3v2 one
+    file.str( "TAG" ).str( std::string( 30, 'x' ) ).zeros( 30 ).zeros( 30 )
+        .str( "2001" ).zeros( 30 ).u8( 0 );
+
+    auto path = write( "mp3", file );
+    auto tags = TagReader::read( path );
+    ASSERT_NE( nullptr, tags );
+    ASSERT_EQ( "title", tags->title );
+    ASSERT_EQ( "artist", tags->artist );
+    ASSERT_EQ( "caf\xC3\xA9", tags->albumArtist );
+    ASSERT_EQ( "album", tags->album );
+    ASSERT_EQ( "Rock", tags->genre );
+    ASSERT_EQ( "2001", tags->date );
+    ASSERT_EQ( 3u, tags->trackNumber );
+    ASSERT_EQ( 1u, tags->discNumber );
+    ASSERT_EQ( 2u, tags->discTotal );
+    ASSERT_EQ( "mpga", tags->codec );
+    ASSERT_EQ( 44100u, tags->sampleRate );
+    ASSERT_EQ( 2u, tags->nbChannels );
+    ASSERT_EQ( 128000u, tags->bitrate );
+    ASSERT_EQ( 41700 * 8 / 128, tags->duration );
+    ASSERT_EQ( artworkOffset, tags->artworkOffset );
+    ASSERT_EQ( 7u, tags->artworkSize );
+    ASSERT_EQ( "image/png", tags->artworkMimeType );
+
+    auto artwork = TagReader::extractArtwork( path, *tags, "tagreader_artwork" );
+    ASSERT_EQ( "tagreader_artwork.png", artwork );
+    std::ifstream in( artwork, std::ios::binary );
+    std::string content( ( std::istreambuf_iterator<char>( in ) ),
+                         std::istreambuf_iterator<char>() );
+    ASSERT_EQ( "PNGDATA", content );
+    std::remove( artwork.c_str() );
+}
+
+TEST_F( TagReaders, Flac )
+{
+    Bytes streamInfo;
+    // Block sizes & frame sizes, then 44.1kHz, 2 channels, 16 bits & 441000 samples
+    streamInfo.be16( 4096 ).be16( 4096 ).be24( 0 ).be24( 0 )
+              .be32( 44100 << 12 | 1 << 9 | 15 << 4 ).be32( 441000 ).zeros( 16 );
+    auto comment = vorbisComment( { "TITLE=title", "artist=artist", "ALBUMARTIST=album artist",
+                                    "TRACKNUMBER=4", "DISCNUMBER=2/3", "GENRE=Jazz" } );
+    Bytes file;
+    file.str( "fLaC" )
+        .u8( 0 ).be24( streamInfo.size() ).bytes( streamInfo )
+        .u8( 0x80 | 4 ).be24( comment.size() ).bytes( comment )
+        .zeros( 1000 );
+
+    auto tags = TagReader::read( write( "flac", file ) );
+    ASSERT_NE( nullptr, tags );
+    ASSERT_EQ( "title", tags->title );
+    ASSERT_EQ( "artist", tags->artist );
+    ASSERT_EQ( "album artist", tags->albumArtist );
+    ASSERT_EQ( "Jazz", tags->genre );
+    ASSERT_EQ( 4u, tags->trackNumber );
+    ASSERT_EQ( 2u, tags->discNumber );
+    ASSERT_EQ( 3u, tags->discTotal );
+    ASSERT_EQ( "flac", tags->codec );
+    ASSERT_EQ( 44100u, tags->sampleRate );
+    ASSERT_EQ( 2u, tags->nbChannels );
+    ASSERT_EQ( 10000, tags->duration );
+    ASSERT_EQ( 0u, tags->artworkSize );
+}
+
+TEST_F( TagReaders, FlacTruncatedPicture )
+{
+    Bytes streamInfo;
+    streamInfo.be16( 4096 ).be16( 4096 ).be24( 0 ).be24( 0 )
+              .be32( 44100 << 12 | 1 << 9 | 15 << 4 ).be32( 441000 ).zeros( 16 );
+    // PICTURE blocks shorter than their fixed fields, or with a MIME type
+    // or description length running past the end of the block
+    auto tooShort = Bytes{}.be32( 3 ).be32( 0xFFFFFFFF ).be16( 0 );
+    auto longMime = Bytes{}.be32( 3 ).be32( 0xFFFFFFF0 ).zeros( 32 );
+    auto longDesc = Bytes{}.be32( 3 ).be32( 0 ).be32( 0xFFFFFFFC ).zeros( 32 );
+    Bytes file;
+    file.str( "fLaC" )
+        .u8( 0 ).be24( streamInfo.size() ).bytes( streamInfo )
+        .u8( 6 ).be24( tooShort.size() ).bytes( tooShort )
+        .u8( 6 ).be24( longMime.size() ).bytes( longMime )
+        .u8( 0x80 | 6 ).be24( longDesc.size() ).bytes( longDesc )
+        .zeros( 1000 );
+
+    auto tags = TagReader::read( write( "flac", file ) );
+    ASSERT_NE( nullptr, tags );
+    ASSERT_EQ( 44100u, tags->sampleRate );
+    ASSERT_EQ( 0u, tags->artworkSize );
+}
+
+TEST_F( TagReaders, Opus )
+{
+    Bytes head;
+    head.str( "OpusHead" ).u8( 1 ).u8( 2 ).u8( 312 & 0xFF ).u8( 312 >> 8 )
+        .le32( 44100 ).zeros( 3 );
+    Bytes tagsPacket;
+    tagsPacket.str( "OpusTags" )
+              .bytes( vorbisComment( { "TITLE=" + std::string( 300, 't' ), "ALBUM=album" } ) );
+    Bytes file;
+    file.bytes( oggPage( 0x02, 0, 0, head ) )
+        .bytes( oggPage( 0, 0, 1, tagsPacket ) )
+        .bytes( oggPage( 0x04, 48000 * 5 + 312, 2, Bytes{}.zeros( 100 ) ) );
+
+    auto tags = TagReader::read( write( "opus", file ) );
+    ASSERT_NE( nullptr, tags );
+    ASSERT_EQ( std::string( 300, 't' ), tags->title );
+    ASSERT_EQ( "album", tags->album );
+    ASSERT_EQ( "opus", tags->codec );
+    ASSERT_EQ( 48000u, tags->sampleRate );
+    ASSERT_EQ( 2u, tags->nbChannels );
+    ASSERT_EQ( 5000, tags->duration );
+}
+
+TEST_F( TagReaders, Mp4 )
+{
+    auto hdlr = []( const char* type ) {
+        return Bytes{}.zeros( 8 ).str( type ).zeros( 12 );
+    };
+    auto item = []( const char* type, uint32_t dataType, const Bytes& value ) {
+        return Bytes{}.atom( type, Bytes{}.atom( "data", Bytes{}.be32( dataType ).be32( 0 ).bytes( value ) ) );
+    };
+    // mp4a sample entry: reserved, data reference index, version, revision, vendor,
+    // 2 channels, 16 bits, compression id, packet size & 48kHz
+    auto mp4a = Bytes{}.zeros( 6 ).be16( 1 ).zeros( 8 ).be16( 2 ).be16( 16 ).zeros( 4 )
+                       .be32( 48000u << 16 );
+    auto stsd = Bytes{}.zeros( 4 ).be32( 1 ).atom( "mp4a", mp4a );
+    auto trak = Bytes{}.atom( "mdia", Bytes{}.atom( "hdlr", hdlr( "soun" ) )
+                                  .atom( "minf", Bytes{}.atom( "stbl", Bytes{}.atom( "stsd", stsd ) ) ) );
+    auto ilst = Bytes{}.bytes( item( "\xA9nam", 1, Bytes{}.str( "title" ) ) )
+                       .bytes( item( "aART", 1, Bytes{}.str( "album artist" ) ) )
+                       .bytes( item( "trkn", 0, Bytes{}.be16( 0 ).be16( 5 ).be16( 10 ).be16( 0 ) ) )
+                       .bytes( item( "gnre", 0, Bytes{}.be16( 10 ) ) )
+                       .bytes( item( "covr", 13, Bytes{}.str( "JPEGDATA" ) ) );
+    auto meta = Bytes{}.zeros( 4 ).atom( "hdlr", hdlr( "mdir" ) ).atom( "ilst", ilst );
+    // mvhd v0: version & flags, creation & modification times, timescale & duration
+    auto mvhd = Bytes{}.zeros( 12 ).be32( 1000 ).be32( 7000 ).zeros( 80 );
+    auto moov = Bytes{}.atom( "mvhd", mvhd ).atom( "trak", trak )
+                       .atom( "udta", Bytes{}.atom( "meta", meta ) );
+    Bytes file;
+    file.atom( "ftyp", Bytes{}.str( "M4A " ).be32( 0 ) )
+        .atom( "moov", moov )
+        .atom( "mdat", Bytes{}.zeros( 7000 ) );
+
+    auto path = write( "m4a", file );
+    auto tags = TagReader::read( path );
+    ASSERT_NE( nullptr, tags );
+    ASSERT_EQ( "title", tags->title );
+    ASSERT_EQ( "album artist", tags->albumArtist );
+    ASSERT_EQ( 5u, tags->trackNumber );
+    ASSERT_EQ( "Metal", tags->genre );
+    ASSERT_EQ( "mp4a", tags->codec );
+    ASSERT_EQ( 48000u, tags->sampleRate );
+    ASSERT_EQ( 2u, tags->nbChannels );
+    ASSERT_EQ( 7000, tags->duration );
+    ASSERT_EQ( 8000u, tags->bitrate );
+    ASSERT_EQ( 8u, tags->artworkSize );
+    ASSERT_EQ( "image/jpeg", tags->artworkMimeType );
+    ASSERT_EQ( file.data().find( "JPEGDATA" ), tags->artworkOffset );
+
+    // Files containing a video track are left for libvlc to handle
+    auto videoTrak = Bytes{}.atom( "mdia", Bytes{}.atom( "hdlr", hdlr( "vide" ) ) );
+    Bytes video;
+    video.atom( "ftyp", Bytes{}.str( "M4A " ).be32( 0 ) )
+         .atom( "moov", Bytes{}.atom( "mvhd", mvhd ).atom( "trak", trak )
+                                .atom( "trak", videoTrak ) );
+    ASSERT_EQ( nullptr, TagReader::read( write( "m4b", video ) ) );
+}
+
+TEST_F( TagReaders, Invalid )
+{
+    ASSERT_EQ( nullptr, TagReader::read( "tagreader.missing.mp3" ) );
+    ASSERT_EQ( nullptr, TagReader::read( write( "mp3", Bytes{}.zeros( 1000 ) ) ) );
+    ASSERT_EQ( nullptr, TagReader::read( write( "flac", Bytes{}.str( "fLaC" ).u8( 0x80 ) ) ) );
+    // Truncated pages
+    ASSERT_EQ( nullptr, TagReader::read( write( "ogg", Bytes{}.str( "OggS" ).zeros( 30 ) ) ) );
+}
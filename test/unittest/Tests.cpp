@@ -35,6 +35,8 @@ class TestEnv : public ::testing::Environment
         {
             // Always clean the DB in case a previous test crashed
             unlink("test.db");
+            unlink("test.db-wal");
+            unlink("test.db-shm");
         }
 };
 
@@ -74,6 +76,8 @@ void Tests::Reload( std::shared_ptr<factory::IFileSystem> fs /*= nullptr*/, IMed
 void Tests::SetUp()
 {
     unlink("test.db");
+    unlink("test.db-wal");
+    unlink("test.db-shm");
     Reload();
 }
 
@@ -0,0 +1,92 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+
+#include "utils/ThreadPool.h"
+
+using namespace medialibrary;
+
+TEST( ThreadPool, RunJobs )
+{
+    std::atomic_uint nbRun( 0 );
+    {
+        ThreadPool pool;
+        // Jobs submitted before the workers start are run as well
+        pool.submit( [&nbRun]() { ++nbRun; } );
+        pool.start( 4 );
+        ASSERT_EQ( 4u, pool.nbWorkers() );
+        for ( auto i = 0u; i < 1000; ++i )
+            pool.submit( [&nbRun]() { ++nbRun; } );
+        // The remaining jobs are run before the pool gets destroyed
+    }
+    ASSERT_EQ( 1001u, nbRun );
+}
+
+TEST( ThreadPool, NestedJobs )
+{
+    std::atomic_uint nbRun( 0 );
+    {
+        ThreadPool pool;
+        pool.start( 3 );
+        for ( auto i = 0u; i < 10; ++i )
+        {
+            pool.submit( [&pool, &nbRun]() {
+                // Those are queued on the current worker, and stolen by idle ones
+                for ( auto j = 0u; j < 100; ++j )
+                    pool.submit( [&nbRun]() { ++nbRun; } );
+                ++nbRun;
+            });
+        }
+    }
+    ASSERT_EQ( 1010u, nbRun );
+}
+
+TEST( ThreadPool, StatsWhileStarting )
+{
+    ThreadPool pool;
+    ASSERT_TRUE( pool.stats().empty() );
+    std::atomic_bool started( false );
+    std::atomic_bool partial( false );
+    std::thread t( [&pool, &started, &partial]() {
+        while ( started == false )
+        {
+            // The workers are never seen while they're being created
+            auto nbWorkers = pool.stats().size();
+            if ( nbWorkers != 0 && nbWorkers != 8 )
+                partial = true;
+            pool.resetStats();
+        }
+    });
+    pool.start( 8 );
+    started = true;
+    t.join();
+    ASSERT_FALSE( partial );
+    ASSERT_EQ( 8u, pool.stats().size() );
+}
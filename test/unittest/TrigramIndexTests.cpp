@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * Media Library
+ *****************************************************************************
+ * Copyright (C) 2018 Hugo Beauzée-Luyssen, Videolabs
+ *
+ * Authors: Hugo Beauzée-Luyssen<hugo@beauzee.fr>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gtest/gtest.h"
+
+#include "utils/TrigramIndex.h"
+
+using namespace medialibrary;
+
+TEST( TrigramIndex, Trigrams )
+{
+    // "  a", " ab", "abc", "bc "
+    ASSERT_EQ( 4u, TrigramIndex::trigrams( "abc" ).size() );
+    ASSERT_EQ( TrigramIndex::trigrams( "abc" ), TrigramIndex::trigrams( "  ABC!" ) );
+    ASSERT_EQ( TrigramIndex::trigrams( "beyonce" ), TrigramIndex::trigrams( "Beyoncé" ) );
+    ASSERT_EQ( 0u, TrigramIndex::trigrams( " - " ).size() );
+}
+
+TEST( TrigramIndex, Search )
+{
+    TrigramIndex idx;
+    idx.insert( 1, "The Beatles" );
+    idx.insert( 2, "Beastie Boys" );
+    idx.insert( 3, "The Beat" );
+    idx.insert( 4, "Otters" );
+
+    auto res = idx.search( "beatlse", 0.4f, 0 );
+    ASSERT_EQ( 2u, res.size() );
+    ASSERT_EQ( 1, res[0].id );
+    ASSERT_EQ( 3, res[1].id );
+
+    res = idx.search( "beatlse", 0.4f, 1 );
+    ASSERT_EQ( 1u, res.size() );
+    ASSERT_EQ( 1, res[0].id );
+
+    res = idx.search( "grouik", 0.4f, 0 );
+    ASSERT_EQ( 0u, res.size() );
+}
+
+TEST( TrigramIndex, Update )
+{
+    TrigramIndex idx;
+    idx.insert( 1, "The Beatles" );
+    idx.insert( 1, "Otters" );
+    ASSERT_EQ( 1u, idx.size() );
+    ASSERT_EQ( 0u, idx.search( "beatles", 0.4f, 0 ).size() );
+    ASSERT_EQ( 1u, idx.search( "otter", 0.4f, 0 ).size() );
+
+    idx.remove( 1 );
+    ASSERT_EQ( 0u, idx.size() );
+    ASSERT_EQ( 0u, idx.search( "otter", 0.4f, 0 ).size() );
+}
+
+TEST( TrigramIndex, Compact )
+{
+    TrigramIndex idx;
+    for ( auto i = 0; i < 1000; ++i )
+        idx.insert( i, "entry " + std::to_string( i ) );
+    idx.compact();
+    for ( auto i = 0; i < 1000; i += 2 )
+        idx.remove( i );
+    idx.insert( 1000, "entry 1000" );
+    idx.compact();
+    ASSERT_EQ( 501u, idx.size() );
+
+    auto res = idx.search( "entry 999", 1.f, 0 );
+    ASSERT_EQ( 1u, res.size() );
+    ASSERT_EQ( 999, res[0].id );
+    res = idx.search( "entry 1000", 1.f, 0 );
+    ASSERT_EQ( 1u, res.size() );
+    ASSERT_EQ( 1000, res[0].id );
+    ASSERT_EQ( 0u, idx.search( "entry 998", 1.f, 0 ).size() );
+}